@@ -0,0 +1,539 @@
+#include "detile.h"
+
+#include "logging.h"
+#include "utility/utility.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <immintrin.h>
+#include <intrin.h>
+#include <thread>
+#include <vector>
+
+LOG_DEFINE_MODULE(Detile);
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+namespace detile {
+namespace {
+constexpr uint32_t MICRO_TILE_SIZE       = 8;
+constexpr uint32_t THICK_SLICES          = 4;
+constexpr uint32_t PIPE_INTERLEAVE_BITS  = 8;
+constexpr uint32_t PIPE_INTERLEAVE_BYTES = 1u << PIPE_INTERLEAVE_BITS;
+constexpr uint32_t MAX_CHUNKS            = 64 * THICK_SLICES * 16 / PIPE_INTERLEAVE_BYTES; // largest micro tile: thick, 128 bit
+
+constexpr uint64_t BYTES_PER_THREAD = 1024 * 1024; // smaller surfaces aren't worth a thread
+constexpr uint32_t MAX_THREADS      = 8;
+
+struct MacroTileParams {
+  uint8_t bankWidth;
+  uint8_t bankHeight;
+  uint8_t macroTileAspect;
+  uint8_t numBanks;
+};
+
+// Indexed by log2(micro tile bytes / 64). A macro tile covers at least the pipe interleave in each pipe and bank.
+constexpr std::array<MacroTileParams, 7> MACRO_TILE_PARAMS = {{
+    {1, 4, 2, 16}, // 8 bit
+    {1, 2, 2, 16}, // 16 bit
+    {1, 1, 2, 16}, // 32 bit: 128x64 macro tiles, the display buffer layout
+    {1, 1, 2, 16},
+    {1, 1, 1, 8},
+    {1, 1, 1, 4},
+    {1, 1, 1, 2},
+}};
+
+constexpr std::array<MacroTileParams, 7> MACRO_TILE_PARAMS_NEO = {{
+    {1, 4, 1, 16},
+    {1, 2, 1, 16},
+    {1, 1, 1, 16}, // 32 bit: 128x128
+    {1, 1, 1, 16},
+    {1, 1, 1, 8},
+    {1, 1, 1, 4},
+    {1, 1, 1, 2},
+}};
+
+struct Layout {
+  uint32_t bytesPerElement = 0;
+  uint32_t thickness       = 1;
+  uint32_t tileBytes       = 0; // micro tile
+  uint32_t tileWidth       = 1; // elements, macro tile (2d) or micro tile (1d)
+  uint32_t tileHeight      = 1;
+  uint32_t numPipes        = 1;
+  uint32_t pipeBits        = 0; // 0 unless 2d
+  uint32_t bankBits        = 0;
+  uint64_t macroTileBytes  = 0; // per pipe and bank
+  uint64_t sliceBytes      = 0; // before the pipe and bank bits are inserted
+};
+
+constexpr bool isThick(ArrayMode mode) {
+  return mode == ArrayMode::tiled1dThick || mode == ArrayMode::tiled2dThick;
+}
+
+constexpr bool is2d(ArrayMode mode) {
+  return mode == ArrayMode::tiled2dThin || mode == ArrayMode::tiled2dThick;
+}
+
+constexpr uint32_t bit(uint32_t value, uint32_t n) {
+  return (value >> n) & 1u;
+}
+
+bool getLayout(Surface const& surface, Layout& layout) {
+  auto const& mode = surface.mode;
+
+  switch (surface.bitsPerElement) {
+    case 8:
+    case 16:
+    case 32:
+    case 64:
+    case 128: break;
+    default: return false;
+  }
+  if (surface.pitch < surface.width || surface.paddedHeight < surface.height) return false;
+
+  layout.bytesPerElement = surface.bitsPerElement / 8;
+  if (mode.arrayMode == ArrayMode::linear) {
+    layout.sliceBytes = (uint64_t)surface.pitch * surface.paddedHeight * layout.bytesPerElement;
+    return true;
+  }
+
+  layout.thickness  = isThick(mode.arrayMode) ? THICK_SLICES : 1;
+  layout.tileBytes  = MICRO_TILE_SIZE * MICRO_TILE_SIZE * layout.thickness * layout.bytesPerElement;
+  layout.tileWidth  = MICRO_TILE_SIZE;
+  layout.tileHeight = MICRO_TILE_SIZE;
+
+  if (is2d(mode.arrayMode)) {
+    if (!std::has_single_bit(mode.numBanks) || mode.numBanks < 2 || mode.numBanks > 16) return false;
+    if (mode.bankWidth == 0 || mode.bankHeight == 0 || !std::has_single_bit(mode.macroTileAspect)) return false;
+
+    layout.numPipes = mode.pipeConfig == PipeConfig::p16_32x32_8x16 ? 16 : 8;
+    layout.pipeBits = std::countr_zero(layout.numPipes);
+    layout.bankBits = std::countr_zero(mode.numBanks);
+
+    layout.tileWidth  = MICRO_TILE_SIZE * mode.bankWidth * layout.numPipes * mode.macroTileAspect;
+    layout.tileHeight = MICRO_TILE_SIZE * mode.bankHeight * mode.numBanks / mode.macroTileAspect;
+    if (layout.tileHeight < MICRO_TILE_SIZE) return false;
+
+    layout.macroTileBytes = (uint64_t)mode.bankWidth * mode.bankHeight * layout.tileBytes;
+  } else {
+    layout.macroTileBytes = layout.tileBytes;
+  }
+
+  if (surface.pitch % layout.tileWidth != 0 || surface.paddedHeight % layout.tileHeight != 0) return false;
+
+  uint64_t const numTiles = (uint64_t)(surface.pitch / layout.tileWidth) * (surface.paddedHeight / layout.tileHeight);
+  layout.sliceBytes       = numTiles * layout.macroTileBytes;
+  return true;
+}
+
+// ### Addressing
+
+/**
+ * @brief Element index inside a micro tile, x,y,z are within the tile
+ *
+ */
+uint32_t getElementIndex(uint32_t x, uint32_t y, uint32_t z, uint32_t bitsPerElement, MicroTileMode mode) {
+  uint32_t const x0 = bit(x, 0), x1 = bit(x, 1), x2 = bit(x, 2);
+  uint32_t const y0 = bit(y, 0), y1 = bit(y, 1), y2 = bit(y, 2);
+  uint32_t const z0 = bit(z, 0), z1 = bit(z, 1);
+
+  switch (mode) {
+    case MicroTileMode::display: {
+      switch (bitsPerElement) {
+        case 8: return x0 | x1 << 1 | x2 << 2 | y1 << 3 | y0 << 4 | y2 << 5;
+        case 16: return x0 | x1 << 1 | x2 << 2 | y0 << 3 | y1 << 4 | y2 << 5;
+        case 32: return x0 | x1 << 1 | y0 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+        case 64: return x0 | y0 << 1 | x1 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+        default: return y0 | x0 << 1 | x1 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+      }
+    }
+    case MicroTileMode::thin: return x0 | y0 << 1 | x1 << 2 | y1 << 3 | x2 << 4 | y2 << 5;
+    case MicroTileMode::thick: {
+      uint32_t const high = x2 << 6 | y2 << 7;
+      switch (bitsPerElement) {
+        case 8:
+        case 16: return high | x0 | y0 << 1 | x1 << 2 | y1 << 3 | z0 << 4 | z1 << 5;
+        case 32: return high | x0 | y0 << 1 | x1 << 2 | z0 << 3 | y1 << 4 | z1 << 5;
+        default: return high | x0 | y0 << 1 | z0 << 2 | x1 << 3 | y1 << 4 | z1 << 5;
+      }
+    }
+  }
+  return 0;
+}
+
+uint32_t getPipe(uint32_t x, uint32_t y, PipeConfig config) {
+  if (config == PipeConfig::p16_32x32_8x16) {
+    return (bit(x, 4) ^ bit(y, 3)) | (bit(x, 3) ^ bit(y, 4)) << 1 | (bit(x, 5) ^ bit(y, 6)) << 2 | (bit(x, 6) ^ bit(y, 5)) << 3;
+  }
+  return (bit(x, 3) ^ bit(y, 3) ^ bit(x, 4)) | (bit(x, 4) ^ bit(y, 4)) << 1 | (bit(x, 5) ^ bit(y, 5)) << 2;
+}
+
+uint32_t getBank(uint32_t x, uint32_t y, TileMode const& mode, uint32_t numPipes) {
+  uint32_t const tx = x / (MICRO_TILE_SIZE * mode.bankWidth * numPipes);
+  uint32_t const ty = y / (MICRO_TILE_SIZE * mode.bankHeight);
+
+  switch (mode.numBanks) {
+    case 16: return (bit(tx, 0) ^ bit(ty, 3)) | (bit(tx, 1) ^ bit(ty, 2) ^ bit(ty, 3)) << 1 | (bit(tx, 2) ^ bit(ty, 1)) << 2 | (bit(tx, 3) ^ bit(ty, 0)) << 3;
+    case 8: return (bit(tx, 0) ^ bit(ty, 2)) | (bit(tx, 1) ^ bit(ty, 1) ^ bit(ty, 2)) << 1 | (bit(tx, 2) ^ bit(ty, 0)) << 2;
+    case 4: return (bit(tx, 0) ^ bit(ty, 1)) | (bit(tx, 1) ^ bit(ty, 0)) << 1;
+    default: return bit(tx, 0) ^ bit(ty, 0);
+  }
+}
+
+/**
+ * @brief A micro tile: offset of its first element before the pipe and bank bits are inserted
+ *
+ */
+struct TileAddress {
+  uint64_t offset = 0;
+  uint32_t pipe   = 0;
+  uint32_t bank   = 0;
+};
+
+TileAddress getTileAddress(Surface const& surface, Layout const& layout, uint32_t x, uint32_t y, uint32_t z) {
+  auto const&    mode        = surface.mode;
+  uint64_t const sliceOffset = (z / layout.thickness) * layout.sliceBytes;
+
+  if (!is2d(mode.arrayMode)) {
+    uint64_t const tileIndex = (uint64_t)(y / MICRO_TILE_SIZE) * (surface.pitch / MICRO_TILE_SIZE) + x / MICRO_TILE_SIZE;
+    return {.offset = sliceOffset + tileIndex * layout.tileBytes};
+  }
+
+  uint64_t const macroTileIndex = (uint64_t)(y / layout.tileHeight) * (surface.pitch / layout.tileWidth) + x / layout.tileWidth;
+  uint32_t const tileIndex = ((y / MICRO_TILE_SIZE) % mode.bankHeight) * mode.bankWidth + ((x / MICRO_TILE_SIZE) / layout.numPipes) % mode.bankWidth;
+
+  // Consecutive slices start on other banks
+  uint32_t const sliceRotation = (mode.numBanks / 2 - 1) * (z / layout.thickness);
+
+  return {
+      .offset = sliceOffset + macroTileIndex * layout.macroTileBytes + tileIndex * layout.tileBytes,
+      .pipe   = getPipe(x, y, mode.pipeConfig),
+      .bank   = (getBank(x, y, mode, layout.numPipes) ^ sliceRotation) & (mode.numBanks - 1u),
+  };
+}
+
+/**
+ * @brief Inserts pipe and bank above the pipe interleave bits
+ *
+ */
+uint64_t getAddress(Layout const& layout, uint64_t offset, uint32_t pipe, uint32_t bank) {
+  uint64_t const high = offset >> PIPE_INTERLEAVE_BITS;
+  return (offset & (PIPE_INTERLEAVE_BYTES - 1)) | (uint64_t)pipe << PIPE_INTERLEAVE_BITS | (uint64_t)bank << (PIPE_INTERLEAVE_BITS + layout.pipeBits) |
+         high << (PIPE_INTERLEAVE_BITS + layout.pipeBits + layout.bankBits);
+}
+
+// ### Kernels
+
+/**
+ * @brief Full 8x8 tile of one 256 byte chunk to linear rows
+ *
+ */
+using tileKernel_t = void (*)(uint8_t const* src, uint8_t* dst, size_t dstPitch);
+
+// display, 32 bit: a row is two runs of 4 elements, 32 bytes apart
+void copyDisplay32Sse2(uint8_t const* src, uint8_t* dst, size_t dstPitch) {
+  for (uint32_t y = 0; y < MICRO_TILE_SIZE; ++y, dst += dstPitch) {
+    auto const s = (__m128i const*)src + ((y & 1u) | (y & 6u) << 1);
+    _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128(s));
+    _mm_storeu_si128((__m128i*)dst + 1, _mm_loadu_si128(s + 2));
+  }
+}
+
+TARGET_AVX2 void copyDisplay32Avx2(uint8_t const* src, uint8_t* dst, size_t dstPitch) {
+  for (uint32_t y = 0; y < MICRO_TILE_SIZE; y += 2, src += 64, dst += 2 * dstPitch) {
+    auto const left  = _mm256_loadu_si256((__m256i const*)src);     // rows y, y+1: elements 0-3
+    auto const right = _mm256_loadu_si256((__m256i const*)src + 1); // elements 4-7
+    _mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(left, right, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + dstPitch), _mm256_permute2x128_si256(left, right, 0x31));
+  }
+}
+
+// thin, 32 bit: pairs of elements, rows y and y+1 interleaved
+void copyThin32Sse2(uint8_t const* src, uint8_t* dst, size_t dstPitch) {
+  for (uint32_t y = 0; y < MICRO_TILE_SIZE; y += 2, dst += 2 * dstPitch) {
+    auto const s = src + ((y & 2u) << 4 | (y & 4u) << 5);
+    for (uint32_t half = 0; half < 2; ++half) {
+      auto const a = _mm_loadu_si128((__m128i const*)(s + 64 * half));      // row y 0-1, row y+1 0-1
+      auto const b = _mm_loadu_si128((__m128i const*)(s + 64 * half + 16)); // row y 2-3, row y+1 2-3
+      _mm_storeu_si128((__m128i*)dst + half, _mm_unpacklo_epi64(a, b));
+      _mm_storeu_si128((__m128i*)(dst + dstPitch) + half, _mm_unpackhi_epi64(a, b));
+    }
+  }
+}
+
+TARGET_AVX2 void copyThin32Avx2(uint8_t const* src, uint8_t* dst, size_t dstPitch) {
+  for (uint32_t y = 0; y < MICRO_TILE_SIZE; y += 2, dst += 2 * dstPitch) {
+    auto const s  = src + ((y & 2u) << 4 | (y & 4u) << 5);
+    auto const lo = _mm256_permute4x64_epi64(_mm256_loadu_si256((__m256i const*)s), _MM_SHUFFLE(3, 1, 2, 0));        // row y 0-3, row y+1 0-3
+    auto const hi = _mm256_permute4x64_epi64(_mm256_loadu_si256((__m256i const*)(s + 64)), _MM_SHUFFLE(3, 1, 2, 0)); // 4-7
+    _mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + dstPitch), _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+}
+
+struct Kernels {
+  tileKernel_t display32 = copyDisplay32Sse2;
+  tileKernel_t thin32    = copyThin32Sse2;
+};
+
+__attribute__((target("xsave"))) bool hasAvx2() {
+  int regs[4];
+  __cpuid(regs, 0);
+  auto const maxLeaf = regs[0];
+
+  __cpuid(regs, 1);
+  bool const osxsave = (regs[2] & (1 << 27)) != 0;
+  bool const avx     = (regs[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || maxLeaf < 7) return false;
+  if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+}
+
+Kernels const& getKernels() {
+  static Kernels const kernels = [] {
+    LOG_USE_MODULE(Detile);
+
+    Kernels kernels;
+    bool const avx2 = hasAvx2();
+    if (avx2) {
+      kernels.display32 = copyDisplay32Avx2;
+      kernels.thin32    = copyThin32Avx2;
+    }
+    LOG_INFO(L"detile kernels| avx2:%S", util::getBoolStr(avx2));
+    return kernels;
+  }();
+  return kernels;
+}
+
+// Fixed sizes, compiled to plain moves
+inline void copyRun(uint8_t* dst, uint8_t const* src, uint32_t size) {
+  switch (size) {
+    case 1: *dst = *src; break;
+    case 2: std::memcpy(dst, src, 2); break;
+    case 4: std::memcpy(dst, src, 4); break;
+    case 8: std::memcpy(dst, src, 8); break;
+    case 16: std::memcpy(dst, src, 16); break;
+    case 32: std::memcpy(dst, src, 32); break;
+    case 64: std::memcpy(dst, src, 64); break;
+    default: std::memcpy(dst, src, size); break;
+  }
+}
+
+/**
+ * @brief Elements of a micro tile row that are consecutive in memory
+ *
+ */
+struct Run {
+  uint8_t  x      = 0;
+  uint8_t  count  = 0;
+  uint16_t offset = 0; // in the micro tile
+};
+
+struct RowRuns {
+  std::array<Run, MICRO_TILE_SIZE> runs;
+  uint32_t                         numRuns = 0;
+};
+
+struct Job {
+  Surface const& surface;
+  Layout const&  layout;
+  uint8_t const* src;
+  uint32_t       z;
+  uint8_t*       dst;
+  size_t         dstPitch;
+
+  tileKernel_t                         kernel = nullptr; // full tiles, nullptr: runs
+  std::array<RowRuns, MICRO_TILE_SIZE> rows;
+};
+
+void initRuns(Job& job) {
+  auto const& surface = job.surface;
+  auto const  size    = job.layout.bytesPerElement;
+
+  for (uint32_t y = 0; y < MICRO_TILE_SIZE; ++y) {
+    auto& row = job.rows[y];
+    for (uint32_t x = 0; x < MICRO_TILE_SIZE; ++x) {
+      uint32_t const offset = size * getElementIndex(x, y, job.z % job.layout.thickness, surface.bitsPerElement, surface.mode.microTileMode);
+
+      // Runs don't cross a chunk, the next one is elsewhere in 2d modes
+      if (row.numRuns > 0) {
+        auto& run = row.runs[row.numRuns - 1];
+        if (run.offset + run.count * size == offset && offset % PIPE_INTERLEAVE_BYTES != 0) {
+          ++run.count;
+          continue;
+        }
+      }
+      row.runs[row.numRuns++] = {.x = (uint8_t)x, .count = 1, .offset = (uint16_t)offset};
+    }
+  }
+}
+
+void copyTileRuns(Job const& job, uint8_t const* const* chunks, uint8_t* dst, uint32_t width, uint32_t height) {
+  auto const size = job.layout.bytesPerElement;
+  for (uint32_t y = 0; y < height; ++y, dst += job.dstPitch) {
+    auto const& row = job.rows[y];
+    for (uint32_t n = 0; n < row.numRuns; ++n) {
+      auto const& run = row.runs[n];
+      if (run.x >= width) continue;
+
+      auto const src = chunks[run.offset / PIPE_INTERLEAVE_BYTES] + run.offset % PIPE_INTERLEAVE_BYTES;
+      copyRun(dst + run.x * size, src, std::min<uint32_t>(run.count, width - run.x) * size);
+    }
+  }
+}
+
+/**
+ * @brief Rows of (macro) tiles [begin, end), a row of micro tiles at a time: dst is written in order
+ *
+ */
+void detileRows(Job const& job, uint32_t begin, uint32_t end) {
+  auto const&    surface   = job.surface;
+  auto const&    layout    = job.layout;
+  uint32_t const numChunks = std::max(layout.tileBytes / PIPE_INTERLEAVE_BYTES, 1u);
+
+  std::array<uint8_t const*, MAX_CHUNKS> chunks;
+  for (uint32_t y = begin * layout.tileHeight; y < std::min(end * layout.tileHeight, surface.height); y += MICRO_TILE_SIZE) {
+    uint32_t const height = std::min(surface.height - y, MICRO_TILE_SIZE);
+
+    for (uint32_t x = 0; x < surface.width; x += MICRO_TILE_SIZE) {
+      uint32_t const width = std::min(surface.width - x, MICRO_TILE_SIZE);
+
+      auto const tile = getTileAddress(surface, layout, x, y, job.z);
+      for (uint32_t n = 0; n < numChunks; ++n) {
+        chunks[n] = job.src + getAddress(layout, tile.offset + n * PIPE_INTERLEAVE_BYTES, tile.pipe, tile.bank);
+      }
+
+      auto const dst = job.dst + y * job.dstPitch + (size_t)x * layout.bytesPerElement;
+      if (job.kernel != nullptr && width == MICRO_TILE_SIZE && height == MICRO_TILE_SIZE) {
+        job.kernel(chunks[0], dst, job.dstPitch);
+      } else {
+        copyTileRuns(job, chunks.data(), dst, width, height);
+      }
+    }
+  }
+}
+
+bool detileLinear(Surface const& surface, Layout const& layout, uint8_t const* src, uint32_t z, uint8_t* dst, size_t dstPitch) {
+  uint64_t const srcPitch = (uint64_t)surface.pitch * layout.bytesPerElement;
+  uint64_t const rowSize  = (uint64_t)surface.width * layout.bytesPerElement;
+
+  src += z * layout.sliceBytes;
+  for (uint32_t y = 0; y < surface.height; ++y) {
+    std::memcpy(dst + y * dstPitch, src + y * srcPitch, rowSize);
+  }
+  return true;
+}
+} // namespace
+
+bool getTileMode(uint32_t tileModeIndex, uint32_t bitsPerElement, bool neo, TileMode& mode) {
+  mode            = {};
+  mode.pipeConfig = neo ? PipeConfig::p16_32x32_8x16 : PipeConfig::p8_32x32_16x16;
+
+  switch (tileModeIndex) {
+    case TILE_MODE_DISPLAY_LINEAR_ALIGNED: mode.arrayMode = ArrayMode::linear; return true;
+    case TILE_MODE_DISPLAY_1D_THIN: mode.arrayMode = ArrayMode::tiled1dThin; return true;
+    case TILE_MODE_THIN_1D_THIN:
+      mode.arrayMode     = ArrayMode::tiled1dThin;
+      mode.microTileMode = MicroTileMode::thin;
+      return true;
+    case TILE_MODE_THICK_1D_THICK:
+      mode.arrayMode     = ArrayMode::tiled1dThick;
+      mode.microTileMode = MicroTileMode::thick;
+      return true;
+
+    case TILE_MODE_DISPLAY_2D_THIN: mode.arrayMode = ArrayMode::tiled2dThin; break;
+    case TILE_MODE_THIN_2D_THIN:
+      mode.arrayMode     = ArrayMode::tiled2dThin;
+      mode.microTileMode = MicroTileMode::thin;
+      break;
+    case TILE_MODE_THICK_2D_THICK:
+      mode.arrayMode     = ArrayMode::tiled2dThick;
+      mode.microTileMode = MicroTileMode::thick;
+      break;
+
+    default: return false;
+  }
+
+  if (bitsPerElement < 8 || bitsPerElement > 128 || !std::has_single_bit(bitsPerElement)) return false;
+
+  uint32_t const tileBytes = MICRO_TILE_SIZE * MICRO_TILE_SIZE * (isThick(mode.arrayMode) ? THICK_SLICES : 1) * bitsPerElement / 8;
+  auto const&    params    = (neo ? MACRO_TILE_PARAMS_NEO : MACRO_TILE_PARAMS)[std::countr_zero(tileBytes / 64)];
+
+  mode.numBanks        = params.numBanks;
+  mode.bankWidth       = params.bankWidth;
+  mode.bankHeight      = params.bankHeight;
+  mode.macroTileAspect = params.macroTileAspect;
+  return true;
+}
+
+void getTileSize(Surface const& surface, uint32_t& width, uint32_t& height) {
+  Layout layout;
+  if (!getLayout(surface, layout)) {
+    width  = 0;
+    height = 0;
+    return;
+  }
+  width  = layout.tileWidth;
+  height = layout.tileHeight;
+}
+
+uint64_t getSliceSize(Surface const& surface) {
+  Layout layout;
+  if (!getLayout(surface, layout)) return 0;
+  return layout.sliceBytes << (layout.pipeBits + layout.bankBits);
+}
+
+uint64_t getTiledOffset(Surface const& surface, uint32_t x, uint32_t y, uint32_t z) {
+  Layout layout;
+  if (!getLayout(surface, layout)) return 0;
+
+  if (surface.mode.arrayMode == ArrayMode::linear) {
+    return z * layout.sliceBytes + ((uint64_t)y * surface.pitch + x) * layout.bytesPerElement;
+  }
+
+  uint32_t const mask    = MICRO_TILE_SIZE - 1;
+  auto const     tile    = getTileAddress(surface, layout, x & ~mask, y & ~mask, z);
+  uint32_t const element = getElementIndex(x & mask, y & mask, z % layout.thickness, surface.bitsPerElement, surface.mode.microTileMode);
+  return getAddress(layout, tile.offset + element * layout.bytesPerElement, tile.pipe, tile.bank);
+}
+
+bool detileSurface(Surface const& surface, void const* src, uint32_t z, void* dst, size_t dstPitch, uint32_t numThreads) {
+  Layout layout;
+  if (!getLayout(surface, layout)) return false;
+
+  if (surface.mode.arrayMode == ArrayMode::linear) return detileLinear(surface, layout, (uint8_t const*)src, z, (uint8_t*)dst, dstPitch);
+
+  Job job {.surface = surface, .layout = layout, .src = (uint8_t const*)src, .z = z, .dst = (uint8_t*)dst, .dstPitch = dstPitch};
+  if (surface.bitsPerElement == 32 && layout.thickness == 1) {
+    auto const& kernels = getKernels();
+    job.kernel          = surface.mode.microTileMode == MicroTileMode::display ? kernels.display32 : kernels.thin32;
+  }
+  initRuns(job);
+
+  // Rows of tiles are independent: split them evenly
+  uint32_t const numRows = (surface.height + layout.tileHeight - 1) / layout.tileHeight;
+  if (numThreads == 0) {
+    uint64_t const size = (uint64_t)surface.width * surface.height * layout.bytesPerElement;
+    numThreads          = (uint32_t)std::clamp<uint64_t>(size / BYTES_PER_THREAD, 1, std::min(std::max(std::thread::hardware_concurrency(), 1u), MAX_THREADS));
+  }
+  numThreads = std::clamp(numThreads, 1u, std::max(numRows, 1u));
+
+  auto const getBegin = [&](uint32_t n) { return (uint32_t)((uint64_t)numRows * n / numThreads); };
+
+  std::vector<std::thread> workers;
+  workers.reserve(numThreads - 1);
+  for (uint32_t n = 1; n < numThreads; ++n) {
+    workers.emplace_back([&job, begin = getBegin(n), end = getBegin(n + 1)] { detileRows(job, begin, end); });
+  }
+  detileRows(job, getBegin(0), getBegin(1));
+
+  for (auto& worker: workers) {
+    worker.join();
+  }
+  return true;
+}
+} // namespace detile
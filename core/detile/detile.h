@@ -0,0 +1,106 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+/**
+ * @brief CPU conversion of tiled GPU surfaces to linear rows (frame dumps, screenshots, inspection).
+ * Micro tiles are 8x8 elements (8x8x4 thick), 2d modes group them into macro tiles spread over the pipes and banks.
+ *
+ */
+namespace detile {
+
+enum class ArrayMode : uint8_t {
+  linear,
+  tiled1dThin,  ///< micro tiles in row order
+  tiled1dThick, ///< micro tiles of 4 slices in row order
+  tiled2dThin,  ///< macro tiles, pipe and bank interleaved
+  tiled2dThick,
+};
+
+enum class MicroTileMode : uint8_t {
+  display, ///< displayable element order
+  thin,    ///< non displayable element order
+  thick,   ///< 4 slices per micro tile
+};
+
+enum class PipeConfig : uint8_t {
+  p8_32x32_16x16, ///< base
+  p16_32x32_8x16, ///< neo
+};
+
+struct TileMode {
+  ArrayMode     arrayMode     = ArrayMode::linear;
+  MicroTileMode microTileMode = MicroTileMode::display;
+  PipeConfig    pipeConfig    = PipeConfig::p8_32x32_16x16;
+
+  // 2d only
+  uint8_t numBanks        = 16;
+  uint8_t bankWidth       = 1; // micro tiles
+  uint8_t bankHeight      = 1; // micro tiles
+  uint8_t macroTileAspect = 1;
+};
+
+// Tile mode indices of texture and render target descriptors
+constexpr uint32_t TILE_MODE_DISPLAY_LINEAR_ALIGNED = 0x08;
+constexpr uint32_t TILE_MODE_DISPLAY_1D_THIN        = 0x09;
+constexpr uint32_t TILE_MODE_DISPLAY_2D_THIN        = 0x0a;
+constexpr uint32_t TILE_MODE_THIN_1D_THIN           = 0x0d;
+constexpr uint32_t TILE_MODE_THIN_2D_THIN           = 0x0e;
+constexpr uint32_t TILE_MODE_THICK_1D_THICK         = 0x13;
+constexpr uint32_t TILE_MODE_THICK_2D_THICK         = 0x14;
+
+struct Surface {
+  TileMode mode;
+  uint32_t bitsPerElement = 32; // 8, 16, 32, 64 or 128
+  uint32_t width          = 0;  // elements
+  uint32_t height         = 0;
+  uint32_t pitch          = 0; // elements per row in memory, whole tiles
+  uint32_t paddedHeight   = 0; // rows in memory, whole tiles
+};
+
+/**
+ * @brief Layout of a tile mode index for an element size
+ *
+ * @param neo Pro console: 16 pipes
+ * @return false if the tile mode isn't supported (depth, prt and 3d modes)
+ */
+__APICALL bool getTileMode(uint32_t tileModeIndex, uint32_t bitsPerElement, bool neo, TileMode& mode);
+
+/**
+ * @brief Macro tile size in elements, 8x8 (micro tile) for 1d modes, 1x1 for linear
+ *
+ */
+__APICALL void getTileSize(Surface const& surface, uint32_t& width, uint32_t& height);
+
+/**
+ * @brief Bytes of one slice (a group of 4 slices for thick modes) in memory
+ *
+ */
+__APICALL uint64_t getSliceSize(Surface const& surface);
+
+/**
+ * @brief Reference address computation, one element at a time
+ *
+ * @return byte offset of element x,y in slice z
+ */
+__APICALL uint64_t getTiledOffset(Surface const& surface, uint32_t x, uint32_t y, uint32_t z);
+
+/**
+ * @brief Copies slice z of a tiled surface to linear rows, the elements aren't converted
+ *
+ * @param dstPitch bytes between two rows of dst
+ * @param numThreads rows of tiles are split over this many threads, 0: by surface size and core count
+ * @return false if the surface can't be detiled (unsupported element size, pitch or height not whole tiles)
+ */
+__APICALL bool detileSurface(Surface const& surface, void const* src, uint32_t z, void* dst, size_t dstPitch, uint32_t numThreads = 0);
+} // namespace detile
+
+#undef __APICALL
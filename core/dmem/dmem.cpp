@@ -9,8 +9,10 @@
 
 #include <algorithm>
 #include <magic_enum/magic_enum.hpp>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 LOG_DEFINE_MODULE(MemoryManager);
@@ -142,20 +144,59 @@ bool PhysicalMemory::Unmap(uint64_t vaddr, uint64_t size) {
 }
 
 class FlexibleMemory: public IFlexibleMemory {
-  uint64_t   m_totalAllocated = 0;
+  struct Mapping {
+    uint64_t size;
+    int      prot;
+    uint64_t caller;
+    uint64_t base; /// host allocation, a partial unmap splits the mapping
+  };
+
+  std::map<uint64_t, Mapping>  m_mappings;
+  std::map<uint64_t, uint64_t> m_hostAllocs; // base -> mapped bytes, released when 0
+
+  uint64_t m_totalAllocated = 0;
+  uint64_t m_highWater      = 0;
+  uint64_t m_numFailed      = 0;
+
   std::mutex m_mutex_int;
 
+  void dumpAllocations_locked();
+
   public:
   FlexibleMemory() = default;
 
-  uint64_t alloc(uint64_t vaddr, size_t len, int prot) final;
+  void setConfiguredSize(uint64_t size) final {
+    std::unique_lock const lock(m_mutex_int);
+    m_configuresSize = size;
+  }
+
+  uint64_t alloc(uint64_t vaddr, size_t len, int prot, uint64_t caller) final;
   bool     destroy(uint64_t vaddr, uint64_t size) final;
 
   void release(uint64_t start, size_t len) final;
 
   uint64_t available() final {
     std::unique_lock const lock(m_mutex_int);
-    return (uint64_t)448 * 1024 * 1024 - m_totalAllocated; // todo get system ram
+    return m_configuresSize > m_totalAllocated ? m_configuresSize - m_totalAllocated : 0;
+  }
+
+  bool isMapped(uint64_t vaddr) final {
+    std::unique_lock const lock(m_mutex_int);
+
+    auto it = m_mappings.upper_bound(vaddr);
+    if (it == m_mappings.begin()) return false;
+    --it;
+    return vaddr < it->first + it->second.size;
+  }
+
+  Stats getStats() final {
+    std::unique_lock const lock(m_mutex_int);
+    return {.allocated = m_totalAllocated, .highWater = m_highWater, .numMappings = m_mappings.size(), .numFailed = m_numFailed};
+  }
+
+  void dumpAllocations() final {
+    std::unique_lock const lock(m_mutex_int);
+    dumpAllocations_locked();
   }
 };
 
@@ -164,13 +205,32 @@ IFlexibleMemory& accessFlexibleMemory() {
   return inst;
 }
 
-uint64_t FlexibleMemory::alloc(uint64_t vaddr, size_t len, int prot) {
+uint64_t FlexibleMemory::alloc(uint64_t vaddr, size_t len, int prot, uint64_t caller) {
   LOG_USE_MODULE(MemoryManager);
 
   std::unique_lock const lock(m_mutex_int);
-  m_totalAllocated += len;
+
+  if (len == 0) return 0;
+
+  if (m_totalAllocated + len > m_configuresSize) {
+    ++m_numFailed;
+    LOG_ERR(L"--> Heap| out of budget vaddr:0x%08llx len:%llu prot:0x%x total:0x%08llx budget:0x%08llx caller:0x%08llx", vaddr, len, prot, m_totalAllocated,
+            m_configuresSize, caller);
+    dumpAllocations_locked();
+    return 0;
+  }
 
   auto const outAddr = memory::alloc(vaddr, len, prot);
+  if (outAddr == 0) {
+    return 0;
+  }
+
+  m_mappings[outAddr]   = Mapping {.size = len, .prot = prot, .caller = caller, .base = outAddr};
+  m_hostAllocs[outAddr] = len;
+
+  m_totalAllocated += len;
+  m_highWater       = std::max(m_highWater, m_totalAllocated);
+
   LOG_INFO(L"--> Heap| vaddr:0x%08llx len:%llu prot:0x%x total:0x%08llx -> @0x%08llx", vaddr, len, prot, m_totalAllocated, outAddr);
   return outAddr;
 }
@@ -179,10 +239,47 @@ bool FlexibleMemory::destroy(uint64_t vaddr, uint64_t size) {
   LOG_USE_MODULE(MemoryManager);
 
   std::unique_lock const lock(m_mutex_int);
-  m_totalAllocated -= size;
 
-  memory::free(vaddr);
-  LOG_INFO(L"<-- Heap| vaddr:0x%08llx len:%lld total:0x%08llx", vaddr, size, m_totalAllocated);
+  // First mapping overlapping [vaddr, end): the one containing vaddr, else the first one starting after it
+  auto it = m_mappings.upper_bound(vaddr);
+  if (it != m_mappings.begin()) {
+    --it;
+    if (vaddr >= it->first + it->second.size) ++it;
+  }
+
+  // Release [vaddr, end) of every mapping it overlaps, keep the rest
+  uint64_t const end      = vaddr + size;
+  uint64_t       released = 0;
+  while (it != m_mappings.end() && it->first < end) {
+    auto const start   = it->first;
+    auto const mapping = it->second;
+    auto const from    = std::max(start, vaddr);
+    auto const to      = std::min(start + mapping.size, end);
+
+    m_mappings.erase(it);
+    if (start < from) {
+      m_mappings[start] = Mapping {.size = from - start, .prot = mapping.prot, .caller = mapping.caller, .base = mapping.base};
+    }
+    if (to < start + mapping.size) {
+      m_mappings[to] = Mapping {.size = start + mapping.size - to, .prot = mapping.prot, .caller = mapping.caller, .base = mapping.base};
+    }
+
+    auto& hostMapped = m_hostAllocs[mapping.base];
+    hostMapped -= to - from;
+    if (hostMapped == 0) {
+      m_hostAllocs.erase(mapping.base);
+      memory::free(mapping.base);
+    } else {
+      memory::decommit(from, to - from);
+    }
+
+    released += to - from;
+    it        = m_mappings.lower_bound(to);
+  }
+  if (released == 0) return false;
+
+  m_totalAllocated -= released;
+  LOG_INFO(L"<-- Heap| vaddr:0x%08llx len:%lld released:%lld total:0x%08llx", vaddr, size, released, m_totalAllocated);
 
   return true;
 }
@@ -190,4 +287,35 @@ bool FlexibleMemory::destroy(uint64_t vaddr, uint64_t size) {
 void FlexibleMemory::release(uint64_t start, size_t len) {
   LOG_USE_MODULE(MemoryManager);
   LOG_ERR(L"todo %S", __FUNCTION__);
-}
\ No newline at end of file
+}
+
+void FlexibleMemory::dumpAllocations_locked() {
+  LOG_USE_MODULE(MemoryManager);
+
+  struct CallerInfo {
+    uint64_t caller;
+    uint64_t count;
+    uint64_t size;
+  };
+
+  std::unordered_map<uint64_t, CallerInfo> callers;
+  for (auto const& [addr, mapping]: m_mappings) {
+    auto& info  = callers[mapping.caller];
+    info.caller = mapping.caller;
+    ++info.count;
+    info.size += mapping.size;
+  }
+
+  std::vector<CallerInfo> sorted;
+  sorted.reserve(callers.size());
+  for (auto const& [caller, info]: callers) {
+    sorted.push_back(info);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](auto const& lhs, auto const& rhs) { return lhs.size > rhs.size; });
+
+  LOG_INFO(L"Flexible memory| live:%llu total:0x%08llx highWater:0x%08llx budget:0x%08llx failed:%llu", m_mappings.size(), m_totalAllocated, m_highWater,
+           m_configuresSize, m_numFailed);
+  for (auto const& info: sorted) {
+    LOG_INFO(L"  caller:0x%08llx count:%llu size:0x%08llx", info.caller, info.count, info.size);
+  }
+}
@@ -33,21 +33,50 @@ class IPysicalMemory {
 class IFlexibleMemory {
   CLASS_NO_COPY(IFlexibleMemory);
 
-  uint64_t m_configuresSize = 448 * 1024 * 1024;
-
   protected:
   IFlexibleMemory() = default;
 
+  uint64_t m_configuresSize = 448 * 1024 * 1024;
+
   public:
-  void setConfiguredSize(uint64_t size) { m_configuresSize = size; }
+  struct Stats {
+    uint64_t allocated;   /// currently mapped bytes
+    uint64_t highWater;   /// max mapped bytes since start
+    uint64_t numMappings; /// currently live mappings
+    uint64_t numFailed;   /// requests rejected because of the budget
+  };
+
+  virtual void setConfiguredSize(uint64_t size) = 0;
 
   uint64_t size() const { return m_configuresSize; }
 
-  virtual uint64_t available()                                 = 0;
-  virtual uint64_t alloc(uint64_t vaddr, size_t len, int prot) = 0;
-  virtual bool     destroy(uint64_t vaddr, uint64_t size)      = 0;
+  virtual uint64_t available() = 0;
+
+  /**
+   * @brief Maps flexible memory, fails (returns 0) if the configured budget is exceeded
+   *
+   * @param caller guest return address, used for the allocation report
+   */
+  virtual uint64_t alloc(uint64_t vaddr, size_t len, int prot, uint64_t caller = 0) = 0;
+
+  /**
+   * @brief Unmaps a mapping created by alloc()
+   *
+   * @return false if vaddr isn't a flexible memory mapping
+   */
+  virtual bool destroy(uint64_t vaddr, uint64_t size) = 0;
 
   virtual void release(uint64_t start, size_t len) = 0;
+
+  virtual bool isMapped(uint64_t vaddr) = 0;
+
+  virtual Stats getStats() = 0;
+
+  /**
+   * @brief Logs all live mappings, grouped by caller address and sorted by size
+   *
+   */
+  virtual void dumpAllocations() = 0;
 };
 
 #if defined(__APICALL_EXTERN)
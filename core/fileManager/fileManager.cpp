@@ -2,6 +2,7 @@
 #include "fileManager.h"
 #undef __APICALL_EXTERN
 
+#include "core/trace/trace.h"
 #include "logging.h"
 #include "magic_enum/magic_enum.hpp"
 #include "utility/utility.h"
@@ -103,6 +104,7 @@ class FileManager: public IFileManager {
 
   std::optional<std::filesystem::path> getMappedPath(std::string_view path) final {
     LOG_USE_MODULE(FileManager);
+    TRACE_SPAN("fs", "getMappedPath");
     std::unique_lock const lock(m_mutext_int);
 
     // Check Cache
@@ -193,6 +195,7 @@ class FileManager: public IFileManager {
 
   int getDents(int handle, char* buf, int nbytes, int64_t* basep) final {
     LOG_USE_MODULE(FileManager);
+    TRACE_SPAN("fs", "getDents");
 
     if (handle < FILE_DESCRIPTOR_MIN) return -1;
     handle -= FILE_DESCRIPTOR_MIN;
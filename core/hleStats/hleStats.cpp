@@ -0,0 +1,396 @@
+#define __APICALL_EXTERN
+#include "hleStats.h"
+#undef __APICALL_EXTERN
+
+#include "logging.h"
+#include "utility/utility.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+
+LOG_DEFINE_MODULE(HleStats);
+
+namespace hleStats {
+namespace {
+constexpr uint32_t SUB_BITS    = 3; // 8 buckets per power of two, ~12% resolution
+constexpr uint32_t MAX_BITS    = 40;
+constexpr uint32_t NUM_BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+constexpr uint32_t MAX_DEPTH = 64; // nested instrumented calls per thread, deeper calls aren't timed
+
+constexpr size_t STUB_SIZE  = 16;
+constexpr size_t STUB_CODE  = 64 * 1024;                  // executable part of a block, generated once and sealed
+constexpr size_t STUB_COUNT = STUB_CODE / STUB_SIZE - 1; // the last slot holds the address of hleStatsEnter
+
+/**
+ * @brief Histogram with log-linear buckets (like HdrHistogram), values in ns
+ *
+ */
+constexpr uint32_t getBucket(uint64_t ns) {
+  if (ns < (1u << SUB_BITS)) return (uint32_t)ns;
+
+  auto const msb = std::min(63u - (uint32_t)std::countl_zero(ns), MAX_BITS - 1);
+  auto const sub = (uint32_t)(ns >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+  return ((msb - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+constexpr uint64_t getBucketValue(uint32_t bucket) {
+  if (bucket < (1u << SUB_BITS)) return bucket;
+
+  auto const msb = (bucket >> SUB_BITS) + SUB_BITS - 1;
+  auto const sub = bucket & ((1u << SUB_BITS) - 1);
+  return (uint64_t)((1u << SUB_BITS) + sub) << (msb - SUB_BITS);
+}
+
+static_assert(getBucket(7) == 7 && getBucket(8) == 8 && getBucket(1000) == getBucket(getBucketValue(getBucket(1000))));
+
+struct Entry {
+  void*       target; // first member, read by the enter thunk
+  std::string name;
+
+  std::atomic<uint64_t> calls   = 0;
+  std::atomic<uint64_t> totalNs = 0;
+  std::atomic<uint64_t> maxNs   = 0;
+
+  std::array<std::atomic<uint32_t>, NUM_BUCKETS> buckets = {};
+
+  Entry(void* target_, char const* name_): target(target_), name(name_) {}
+
+  void record(uint64_t ns) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    totalNs.fetch_add(ns, std::memory_order_relaxed);
+    buckets[getBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    auto prev = maxNs.load(std::memory_order_relaxed);
+    while (prev < ns && !maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t getPercentile(uint64_t count, double p) const {
+    auto const target = (uint64_t)((double)count * p);
+
+    uint64_t sum = 0;
+    for (uint32_t n = 0; n < NUM_BUCKETS; ++n) {
+      sum += buckets[n].load(std::memory_order_relaxed);
+      if (sum > target) return getBucketValue(n);
+    }
+    return maxNs.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief Pending instrumented calls of a thread
+ *
+ */
+struct ShadowStack {
+  struct Frame {
+    Entry*   entry;
+    uint64_t retAddr;
+    uint64_t sp; // stack pointer after the return
+    uint64_t start;
+  };
+
+  std::array<Frame, MAX_DEPTH> frames;
+  uint32_t                     depth = 0;
+};
+
+thread_local ShadowStack t_stack;
+
+std::atomic<bool> g_enabled = false;
+
+class Registry {
+  std::mutex m_mutex;
+
+  std::unordered_map<void*, void*>    m_stubs; // target -> stub
+  std::vector<std::unique_ptr<Entry>> m_entries;
+
+  uint8_t* m_block    = nullptr;
+  Entry**  m_slots    = nullptr; // writable part of the block, Entry of each stub
+  size_t   m_blockPos = STUB_COUNT;
+
+  uint8_t* allocStub(Entry* entry);
+
+  public:
+  void* add(char const* name, void* func);
+
+  std::vector<Entry const*> getEntries() {
+    std::unique_lock const lock(m_mutex);
+
+    std::vector<Entry const*> ret;
+    for (auto const& entry: m_entries)
+      ret.push_back(entry.get());
+    return ret;
+  }
+};
+
+Registry& accessRegistry() {
+  static auto inst = new Registry; // never destroyed, thunks may run during static destruction
+  return *inst;
+}
+
+uint64_t getTimestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+} // namespace
+} // namespace hleStats
+
+// Called from the thunks
+extern "C" {
+SYSV_ABI void hleStatsOnEnter(void* entry, uint64_t* retSlot);
+SYSV_ABI uint64_t hleStatsOnExit(uint64_t sp);
+void              hleStatsEnter();
+void              hleStatsExit();
+
+/**
+ * @brief Reached through the stub of an instrumented symbol with its Entry in r11.
+ * Saves the argument registers, replaces the return address with hleStatsExit() and jumps to the target.
+ *
+ */
+__attribute__((naked)) void hleStatsEnter() {
+  __asm__ volatile("push %rbp\n"
+                   "mov %rsp, %rbp\n"
+                   "sub $192, %rsp\n"
+                   "mov %rdi, 0(%rsp)\n"
+                   "mov %rsi, 8(%rsp)\n"
+                   "mov %rdx, 16(%rsp)\n"
+                   "mov %rcx, 24(%rsp)\n"
+                   "mov %r8, 32(%rsp)\n"
+                   "mov %r9, 40(%rsp)\n"
+                   "mov %rax, 48(%rsp)\n"
+                   "mov %r11, 56(%rsp)\n"
+                   "movaps %xmm0, 64(%rsp)\n"
+                   "movaps %xmm1, 80(%rsp)\n"
+                   "movaps %xmm2, 96(%rsp)\n"
+                   "movaps %xmm3, 112(%rsp)\n"
+                   "movaps %xmm4, 128(%rsp)\n"
+                   "movaps %xmm5, 144(%rsp)\n"
+                   "movaps %xmm6, 160(%rsp)\n"
+                   "movaps %xmm7, 176(%rsp)\n"
+                   "mov %r11, %rdi\n"
+                   "lea 8(%rbp), %rsi\n"
+                   "call hleStatsOnEnter\n"
+                   "mov 0(%rsp), %rdi\n"
+                   "mov 8(%rsp), %rsi\n"
+                   "mov 16(%rsp), %rdx\n"
+                   "mov 24(%rsp), %rcx\n"
+                   "mov 32(%rsp), %r8\n"
+                   "mov 40(%rsp), %r9\n"
+                   "mov 48(%rsp), %rax\n"
+                   "mov 56(%rsp), %r11\n"
+                   "movaps 64(%rsp), %xmm0\n"
+                   "movaps 80(%rsp), %xmm1\n"
+                   "movaps 96(%rsp), %xmm2\n"
+                   "movaps 112(%rsp), %xmm3\n"
+                   "movaps 128(%rsp), %xmm4\n"
+                   "movaps 144(%rsp), %xmm5\n"
+                   "movaps 160(%rsp), %xmm6\n"
+                   "movaps 176(%rsp), %xmm7\n"
+                   "leave\n"
+                   "jmp *(%r11)\n");
+}
+
+/**
+ * @brief Return target of instrumented calls. Keeps the return registers (rax, rdx, xmm0, xmm1) and jumps to the original return address
+ *
+ */
+__attribute__((naked)) void hleStatsExit() {
+  __asm__ volatile("sub $48, %rsp\n"
+                   "mov %rax, 0(%rsp)\n"
+                   "mov %rdx, 8(%rsp)\n"
+                   "movaps %xmm0, 16(%rsp)\n"
+                   "movaps %xmm1, 32(%rsp)\n"
+                   "lea 48(%rsp), %rdi\n"
+                   "call hleStatsOnExit\n"
+                   "mov %rax, %r11\n"
+                   "mov 0(%rsp), %rax\n"
+                   "mov 8(%rsp), %rdx\n"
+                   "movaps 16(%rsp), %xmm0\n"
+                   "movaps 32(%rsp), %xmm1\n"
+                   "add $48, %rsp\n"
+                   "jmp *%r11\n");
+}
+
+SYSV_ABI void hleStatsOnEnter(void* entry, uint64_t* retSlot) {
+  auto&      stack = hleStats::t_stack;
+  auto const sp    = (uint64_t)(retSlot + 1);
+
+  // A frame with the same return slot was skipped by longjmp or an exception, its return address is gone
+  for (uint32_t n = stack.depth; n-- > 0;) {
+    if (stack.frames[n].sp == sp) {
+      std::copy(stack.frames.begin() + n + 1, stack.frames.begin() + stack.depth, stack.frames.begin() + n);
+      --stack.depth;
+      break;
+    }
+  }
+
+  if (stack.depth == hleStats::MAX_DEPTH) {
+    ((hleStats::Entry*)entry)->calls.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  stack.frames[stack.depth++] = {.entry = (hleStats::Entry*)entry, .retAddr = *retSlot, .sp = sp, .start = hleStats::getTimestamp()};
+  *retSlot                    = (uint64_t)&hleStatsExit;
+}
+
+SYSV_ABI uint64_t hleStatsOnExit(uint64_t sp) {
+  auto const now   = hleStats::getTimestamp();
+  auto&      stack = hleStats::t_stack;
+
+  // Frames above may belong to another fiber or were skipped by longjmp, keep them
+  for (uint32_t n = stack.depth; n-- > 0;) {
+    auto const frame = stack.frames[n];
+    if (frame.sp == sp) {
+      std::copy(stack.frames.begin() + n + 1, stack.frames.begin() + stack.depth, stack.frames.begin() + n);
+      --stack.depth;
+
+      frame.entry->record(now - frame.start);
+      return frame.retAddr;
+    }
+  }
+
+  LOG_USE_MODULE(HleStats);
+  if (stack.depth == 0) {
+    LOG_CRIT(L"return without call sp:0x%08llx", sp); // nothing to return to
+    return 0;
+  }
+
+  // Unmatched: return to the latest call and drop it without recording
+  static std::atomic_flag warned = ATOMIC_FLAG_INIT;
+  if (!warned.test_and_set(std::memory_order_relaxed)) LOG_WARN(L"return without matching call sp:0x%08llx, further ones aren't logged", sp);
+  return stack.frames[--stack.depth].retAddr;
+}
+}
+
+namespace hleStats {
+namespace {
+/**
+ * @brief Stubs load their Entry from a writable slot, the code is written once per block and never writable while executable
+ *
+ */
+uint8_t* Registry::allocStub(Entry* entry) {
+  if (m_blockPos == STUB_COUNT) {
+    auto block = (uint8_t*)VirtualAlloc(nullptr, STUB_CODE + STUB_COUNT * sizeof(Entry*), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (block == nullptr) return nullptr;
+
+    auto const slots     = (Entry**)(block + STUB_CODE);
+    auto const enterSlot = block + STUB_COUNT * STUB_SIZE;
+    auto const enterAddr = (uint64_t)&hleStatsEnter;
+    memcpy(enterSlot, &enterAddr, 8);
+
+    // mov r11, [rip + slot]; jmp [rip + enterSlot]; int3 padding
+    for (size_t n = 0; n < STUB_COUNT; ++n) {
+      auto const stub = block + n * STUB_SIZE;
+
+      uint8_t    code[STUB_SIZE] = {0x4C, 0x8B, 0x1D, 0, 0, 0, 0, 0xFF, 0x25, 0, 0, 0, 0, 0xCC, 0xCC, 0xCC};
+      auto const slotRel         = (int32_t)((uint8_t*)&slots[n] - (stub + 7));
+      auto const enterRel        = (int32_t)(enterSlot - (stub + 13));
+      memcpy(&code[3], &slotRel, 4);
+      memcpy(&code[9], &enterRel, 4);
+      memcpy(stub, code, sizeof(code));
+    }
+
+    DWORD oldProt = 0;
+    if (VirtualProtect(block, STUB_CODE, PAGE_EXECUTE_READ, &oldProt) == 0) {
+      VirtualFree(block, 0, MEM_RELEASE);
+      return nullptr;
+    }
+    FlushInstructionCache(GetCurrentProcess(), block, STUB_CODE);
+
+    m_block    = block;
+    m_slots    = slots;
+    m_blockPos = 0;
+  }
+
+  m_slots[m_blockPos] = entry;
+  return m_block + STUB_SIZE * m_blockPos++;
+}
+
+void* Registry::add(char const* name, void* func) {
+  std::unique_lock const lock(m_mutex);
+
+  if (auto it = m_stubs.find(func); it != m_stubs.end()) return it->second;
+
+  auto entry = std::make_unique<Entry>(func, name);
+  auto stub  = allocStub(entry.get());
+  if (stub == nullptr) return func;
+
+  m_entries.push_back(std::move(entry));
+  m_stubs[func] = stub;
+  return stub;
+}
+} // namespace
+
+void enable(uint32_t dumpIntervalS) {
+  if (g_enabled.exchange(true)) return;
+
+  atexit(dump);
+  if (dumpIntervalS > 0) {
+    std::thread([dumpIntervalS] {
+      util::setThreadName("HleStats");
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(dumpIntervalS));
+        dump();
+      }
+    }).detach();
+  }
+}
+
+bool isEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+void* instrument(char const* name, void* func) {
+  if (!isEnabled() || func == nullptr) return func;
+  return accessRegistry().add(name, func);
+}
+
+void dump() {
+  LOG_USE_MODULE(HleStats);
+
+  struct Row {
+    Entry const* entry;
+    uint64_t     calls;
+    uint64_t     totalNs;
+  };
+
+  std::vector<Row> rows;
+  for (auto entry: accessRegistry().getEntries()) {
+    auto const calls = entry->calls.load(std::memory_order_relaxed);
+    if (calls > 0) rows.push_back({entry, calls, entry->totalNs.load(std::memory_order_relaxed)});
+  }
+  std::sort(rows.begin(), rows.end(), [](Row const& lhs, Row const& rhs) { return lhs.totalNs > rhs.totalNs; });
+
+  LOG_INFO(L"HLE calls: %llu symbols called", rows.size());
+  for (auto const& row: rows) {
+    auto const& entry = *row.entry;
+    LOG_INFO(L"%S| calls:%llu total:%.3fms mean:%.3fus p50:%.3fus p99:%.3fus max:%.3fus", entry.name.c_str(), row.calls, (double)row.totalNs / 1e6,
+             (double)row.totalNs / 1e3 / (double)row.calls, (double)entry.getPercentile(row.calls, 0.5) / 1e3,
+             (double)entry.getPercentile(row.calls, 0.99) / 1e3, (double)entry.maxNs.load(std::memory_order_relaxed) / 1e3);
+  }
+}
+
+uint64_t getNumCalls() {
+  uint64_t calls = 0;
+  for (auto entry: accessRegistry().getEntries()) {
+    calls += entry->calls.load(std::memory_order_relaxed);
+  }
+  return calls;
+}
+
+uint64_t getCallerAddress(uint64_t retAddr) {
+  if (retAddr != (uint64_t)&hleStatsExit || t_stack.depth == 0) return retAddr;
+  return t_stack.frames[t_stack.depth - 1].retAddr;
+}
+} // namespace hleStats
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+/**
+ * @brief Call counts and latency histograms of exported (HLE) functions.
+ * Instrumented symbols are reached through a thunk that hooks the return address, recording is lock free.
+ *
+ */
+namespace hleStats {
+
+/**
+ * @brief Enables instrument(). Stats are dumped to the log periodically and at exit
+ *
+ * @param dumpIntervalS seconds between dumps, 0: only at exit
+ */
+__APICALL void enable(uint32_t dumpIntervalS);
+
+__APICALL bool isEnabled();
+
+/**
+ * @brief Wraps an exported function, call before handing its address to the guest.
+ * Only sceKernelDlsym calls it, imports bound by the runtime's loader aren't instrumented
+ *
+ * @param name symbol name or nid
+ * @param func sysv_abi function
+ * @return the thunk, or func if not enabled
+ */
+__APICALL void* instrument(char const* name, void* func);
+
+/**
+ * @brief Logs all instrumented symbols, sorted by total time
+ *
+ */
+__APICALL void dump();
+
+/**
+ * @brief Finished calls of all instrumented symbols, 0 if not enabled
+ *
+ */
+__APICALL uint64_t getNumCalls();
+
+/**
+ * @brief Return address of the guest caller. Instrumented calls return through a thunk
+ *
+ * @param retAddr __builtin_return_address(0) of an exported function
+ */
+__APICALL uint64_t getCallerAddress(uint64_t retAddr);
+} // namespace hleStats
+
+#undef __APICALL
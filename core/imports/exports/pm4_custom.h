@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
 
 namespace Pm4 {
 
@@ -28,4 +29,48 @@ constexpr uint32_t R_VS_UPDATE         = 0x0F;
 constexpr uint32_t R_PS_UPDATE         = 0x10;
 constexpr uint32_t R_VGT_CONTROL       = 0x11;
 constexpr uint32_t R_NUM_COMMANDS      = 0x12; // used for array size
+
+/**
+ * @brief Custom packet with a fixed number of fields. The header is a constant and the fields are written as 64 bit words, the packet never goes
+ * through the stack.
+ *
+ * @tparam Op R_*
+ * @tparam Length dwords, with header
+ */
+template <uint32_t Op, uint16_t Length>
+struct FixedPacket {
+  static_assert(Op > 0 && Op < R_NUM_COMMANDS, "unknown custom packet");
+  static_assert(Length >= 2 && Length <= 0x3fff + 2, "length doesn't fit the header");
+
+  static constexpr uint16_t LENGTH = Length;
+  static constexpr uint32_t HEADER = create(Length, Op);
+
+  /**
+   * @brief Writes header and fields to cmdOut
+   *
+   * @param size dwords reserved by the caller, the header covers all of them
+   */
+  template <typename... Fields>
+  static void emit(uint32_t* cmdOut, uint64_t size, Fields... fields) {
+    static_assert(sizeof...(Fields) == Length - 1, "field count doesn't match the packet length");
+
+    uint32_t const packet[Length] = {size == Length ? HEADER : create((uint16_t)size, Op), static_cast<uint32_t>(fields)...};
+    for (uint16_t n = 0; n + 1 < Length; n += 2) {
+      uint64_t const pair = packet[n] | ((uint64_t)packet[n + 1] << 32u);
+      memcpy(&cmdOut[n], &pair, sizeof(pair));
+    }
+    if constexpr (Length % 2 != 0) cmdOut[Length - 1] = packet[Length - 1];
+  }
+};
+
+using DrawIndexPacket       = FixedPacket<R_DRAW_INDEX, 6>;
+using DrawIndexAutoPacket   = FixedPacket<R_DRAW_INDEX_AUTO, 3>;
+using DrawResetPacket       = FixedPacket<R_DRAW_RESET, 2>;
+using WaitFlipDonePacket    = FixedPacket<R_WAIT_FLIP_DONE, 3>;
+using DispatchDirectPacket  = FixedPacket<R_DISPATCH_DIRECT, 5>;
+using DispatchResetPacket   = FixedPacket<R_DISPATCH_RESET, 2>;
+using DispatchWaitMemPacket = FixedPacket<R_DISPATCH_WAIT_MEM, 6>;
+using VsEmbeddedPacket      = FixedPacket<R_VS_EMBEDDED, 3>;
+using PsEmbeddedPacket      = FixedPacket<R_PS_EMBEDDED, 2>;
+using VgtControlPacket      = FixedPacket<R_VGT_CONTROL, 3>;
 } // namespace Pm4
\ No newline at end of file
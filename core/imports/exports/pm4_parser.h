@@ -0,0 +1,128 @@
+#pragma once
+
+#include <bit>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Allocation free walker over pm4 streams: type-0 register writes, custom packets (type-1, see pm4_custom.h), type-2 fillers and type-3 packets.
+ * Runs of type-2 fillers and type-3 NOPs are skipped without calling the visitor, fillers are compared a vector at a time.
+ *
+ */
+namespace Pm4 {
+
+constexpr uint32_t OP_NOP       = 0x10; // type-3 opcode
+constexpr uint32_t TYPE2_FILLER = 0x80000000u;
+
+enum class PacketType : uint8_t {
+  Type0  = 0,
+  Custom = 1,
+  Type2  = 2,
+  Type3  = 3,
+};
+
+struct Packet {
+  uint32_t const* data; // header, body starts at data[1]
+  uint32_t        len;  // dwords, with header
+  PacketType      type;
+  uint32_t        op; // type-0: base register, custom: R_*, type-3: opcode, type-2: 0
+};
+
+enum class ParseResult {
+  Done,
+  Stopped,   // visitor returned false
+  Truncated, // last packet exceeds the buffer
+};
+
+constexpr PacketType getType(uint32_t header) {
+  return (PacketType)(header >> 30u);
+}
+
+constexpr uint32_t getLength(uint32_t header) {
+  return getType(header) == PacketType::Type2 ? 1u : ((header >> 16u) & 0x3fffu) + 2u;
+}
+
+constexpr uint32_t getOp(uint32_t header) {
+  switch (getType(header)) {
+    case PacketType::Type0:
+    case PacketType::Custom: return header & 0xffffu;
+    case PacketType::Type3: return (header >> 8u) & 0xffu;
+    default: return 0;
+  }
+}
+
+/**
+ * @brief Number of type-2 fillers at cmds
+ *
+ */
+inline size_t countFillers(uint32_t const* cmds, uint32_t const* end) {
+  auto const start = cmds;
+#if defined(__AVX2__)
+  auto const filler8 = _mm256_set1_epi32((int)TYPE2_FILLER);
+  for (; end - cmds >= 8; cmds += 8) {
+    auto const mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((__m256i const*)cmds), filler8)));
+    if (mask != 0xffu) return (cmds - start) + std::countr_zero(~mask);
+  }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  auto const filler4 = _mm_set1_epi32((int)TYPE2_FILLER);
+  for (; end - cmds >= 4; cmds += 4) {
+    auto const mask = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((__m128i const*)cmds), filler4)));
+    if (mask != 0xfu) {
+      for (; *cmds == TYPE2_FILLER; ++cmds) {}
+      return cmds - start;
+    }
+  }
+#endif
+  for (; cmds < end && *cmds == TYPE2_FILLER; ++cmds) {}
+  return cmds - start;
+}
+
+/**
+ * @brief Calls visitor for every packet in [cmds, cmds + numDw)
+ *
+ * @tparam SkipNops don't report type-2 fillers and type-3 NOPs
+ * @param visitor bool(Packet const&), false stops parsing
+ * @param stopDw receives the dword offset of the packet parsing ended at (truncated or stopped), numDw when done
+ */
+template <bool SkipNops = true, typename Visitor>
+ParseResult parse(uint32_t const* cmds, size_t numDw, Visitor&& visitor, size_t* stopDw = nullptr) {
+  auto const begin = cmds;
+  auto const end   = cmds + numDw;
+
+  auto stop = [&](ParseResult result) {
+    if (stopDw != nullptr) *stopDw = (size_t)(cmds - begin);
+    return result;
+  };
+
+  while (cmds < end) {
+    auto const header = *cmds;
+    if constexpr (SkipNops) {
+      if (header == TYPE2_FILLER) {
+        cmds += countFillers(cmds, end);
+        continue;
+      }
+    }
+
+    auto const len = getLength(header);
+    if (len > (size_t)(end - cmds)) return stop(ParseResult::Truncated);
+
+    auto const type = getType(header);
+    auto const op   = getOp(header);
+    if constexpr (SkipNops) {
+      if (type == PacketType::Type2 || (type == PacketType::Type3 && op == OP_NOP)) {
+        cmds += len;
+        continue;
+      }
+    }
+
+    if (!visitor(Packet {.data = cmds, .len = len, .type = type, .op = op})) return stop(ParseResult::Stopped);
+    cmds += len;
+  }
+  return stop(ParseResult::Done);
+}
+} // namespace Pm4
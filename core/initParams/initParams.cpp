@@ -1,6 +1,12 @@
 #define __APICALL_EXTERN
 #include "initParams.h"
 #undef __APICALL_EXTERN
+
+#include "core/hleStats/hleStats.h"
+#include "core/pm4Capture/pm4Capture.h"
+#include "core/trace/trace.h"
+
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <memory>
@@ -27,9 +33,26 @@ bool InitParams::init(int argc, char** argv) {
   ("help,h", "Help")
   ("d", "Wait for debugger")
   ("vkValidation", "Enable vulkan validation layers")
+  ("gnmValidation", "Check submitted command buffers on the cpu")
   ("vsync", po::value<bool>()->default_value(true), "Enable vulkan validation layers")
+  ("resolution", po::value<std::string>()->default_value("1920x1080"), "Window size, e.g. 1280x720. Display buffers are scaled to it")
+  ("scaling", po::value<std::string>()->default_value("fit"), "fit: keep the aspect ratio, stretch: fill the window")
+  ("presentMode", po::value<std::string>(), "fifo, mailbox or immediate. Default: fifo with vsync, immediate without")
+  ("refreshRate", po::value<double>()->default_value(59.94), "VBlank rate in Hz: 59.94, 60, 120")
+  ("flipQueueDepth", po::value<uint32_t>()->default_value(16), "Max. pending flips per window, lower values reduce the latency")
+  ("statsInterval", po::value<uint32_t>()->default_value(500), "ms between updates of the flip statistics in the window title (0: off)")
+  ("statsLog", "Log the flip statistics at every update")
   ("file", po::value<std::string>(), "fullpath to applications binary")
   ("root", po::value<std::string>(), "Applications root")
+  ("hleStats", po::value<uint32_t>()->implicit_value(10), "Log call counts and latencies of HLE functions every n seconds (0: at exit), only symbols resolved through sceKernelDlsym")
+  ("pm4Capture", po::value<std::string>(), "Record submitted command buffers to a file, replay with pm4Replay")
+  ("trace", po::value<std::string>(), "Record a trace (.json) of file, sync and gpu submit calls, open with ui.perfetto.dev")
+  ("headless", "No window and no gpu, command buffers are dropped. Flips, vblanks and their events keep running")
+  ("frameDump", po::value<std::string>(), "Headless: write flipped display buffers as .bmp to this directory")
+  ("frameDumpEvery", po::value<uint32_t>()->default_value(60), "Headless: dump every n-th flip")
+  ("screenshotDir", po::value<std::string>()->default_value("screenshots"), "Directory of the screenshots")
+  ("screenshotFormat", po::value<std::string>()->default_value("png"), "png or jpeg")
+  ("screenshotEvery", po::value<uint32_t>()->default_value(0), "Headless: capture every n-th flip (0: off), also while the game disables screenshots")
       // clang-format on
       ;
 
@@ -44,6 +67,15 @@ bool InitParams::init(int argc, char** argv) {
   if (!vm.count("file")) {
     std::cout << "--file missing\n";
   }
+  if (vm.count("hleStats")) {
+    hleStats::enable(vm["hleStats"].as<uint32_t>());
+  }
+  if (vm.count("pm4Capture")) {
+    pm4Capture::start(vm["pm4Capture"].as<std::string>().c_str());
+  }
+  if (vm.count("trace")) {
+    trace::start(vm["trace"].as<std::string>().c_str());
+  }
 
   return true;
 }
@@ -69,6 +101,62 @@ bool InitParams::enableValidation() {
   return _pImpl->m_vm.count("vkValidation");
 }
 
+bool InitParams::enableGnmValidation() {
+  return _pImpl->m_vm.count("gnmValidation");
+}
+
 bool InitParams::useVSYNC() {
   return _pImpl->m_vm["vsync"].as<bool>();
 }
+
+std::string InitParams::getResolution() {
+  return _pImpl->m_vm["resolution"].as<std::string>();
+}
+
+std::string InitParams::getScaling() {
+  return _pImpl->m_vm["scaling"].as<std::string>();
+}
+
+std::string InitParams::getPresentMode() {
+  return _pImpl->m_vm.count("presentMode") ? _pImpl->m_vm["presentMode"].as<std::string>() : std::string();
+}
+
+double InitParams::getRefreshRate() {
+  return _pImpl->m_vm["refreshRate"].as<double>();
+}
+
+uint32_t InitParams::getFlipQueueDepth() {
+  return std::max(_pImpl->m_vm["flipQueueDepth"].as<uint32_t>(), 1u);
+}
+
+uint32_t InitParams::getStatsInterval() {
+  return _pImpl->m_vm["statsInterval"].as<uint32_t>();
+}
+
+bool InitParams::logStats() {
+  return _pImpl->m_vm.count("statsLog");
+}
+
+bool InitParams::isHeadless() {
+  return _pImpl->m_vm.count("headless");
+}
+
+std::string InitParams::getFrameDumpDir() {
+  return _pImpl->m_vm.count("frameDump") ? _pImpl->m_vm["frameDump"].as<std::string>() : std::string();
+}
+
+uint32_t InitParams::getFrameDumpEvery() {
+  return _pImpl->m_vm["frameDumpEvery"].as<uint32_t>();
+}
+
+std::string InitParams::getScreenShotDir() {
+  return _pImpl->m_vm["screenshotDir"].as<std::string>();
+}
+
+std::string InitParams::getScreenShotFormat() {
+  return _pImpl->m_vm["screenshotFormat"].as<std::string>();
+}
+
+uint32_t InitParams::getScreenShotEvery() {
+  return _pImpl->m_vm["screenshotEvery"].as<uint32_t>();
+}
@@ -23,7 +23,26 @@ class InitParams {
   std::string getApplicationRoot();
 
   bool enableValidation();
+  bool enableGnmValidation();
   bool useVSYNC();
+
+  std::string getResolution();
+  std::string getScaling();
+  std::string getPresentMode();
+
+  double   getRefreshRate();
+  uint32_t getFlipQueueDepth();
+
+  uint32_t getStatsInterval();
+  bool     logStats();
+
+  bool        isHeadless();
+  std::string getFrameDumpDir();
+  uint32_t    getFrameDumpEvery();
+
+  std::string getScreenShotDir();
+  std::string getScreenShotFormat();
+  uint32_t    getScreenShotEvery();
   ~InitParams();
 };
 
@@ -2,6 +2,8 @@
 #include "eventqueue.h"
 #undef __APICALL_EXTERN
 
+#include "core/kernel/resourceUsage.h"
+#include "core/trace/trace.h"
 #include "logging.h"
 #include "modules_include/common.h"
 
@@ -75,17 +77,20 @@ KernelEqueue::~KernelEqueue() {
 
 int KernelEqueue::waitForEvents(KernelEvent_t ev, int num, SceKernelUseconds const* micros) {
   LOG_USE_MODULE(EventQueue);
+  TRACE_SPAN("sync", "equeue wait");
   // LOG_TRACE(L"->waitForEvents: ident:0x%08llx num:%d", ev->ident, num);
 
   boost::unique_lock lock(m_mutex_cond);
 
-  int ret = 0;
+  int ret    = 0;
+  int checks = 0; // more than one: the thread blocked
   if (micros == nullptr) {
     ret = getTriggeredEvents(ev, num);
   } else if (*micros > 0) {
     using namespace std::chrono_literals;
 
     if (m_cond_var.wait_for(lock, boost::chrono::microseconds(*(decltype(micros))micros), [&] {
+          ++checks;
           ret = getTriggeredEvents(ev, num);
           return (ret > 0) | m_closed;
         }) == 0) {
@@ -93,11 +98,14 @@ int KernelEqueue::waitForEvents(KernelEvent_t ev, int num, SceKernelUseconds con
     }
   } else {
     m_cond_var.wait(lock, [&] {
+      ++checks;
       ret = getTriggeredEvents(ev, num);
       return (ret > 0) | m_closed;
     });
   }
+  if (checks > 1) Kernel::ResourceUsage::countBlockingWait();
   // LOG_TRACE(L"<-waitForEvents: ident:0x%08llx ret:%d", ev->ident, ret);
+  if (ret > 0) trace::flowEnd("equeue", (uint64_t)this);
   return ret;
 }
 
@@ -259,6 +267,7 @@ int KernelEqueue::addEvent(const KernelEqueueEvent& event) {
 int KernelEqueue::triggerEvent(uintptr_t ident, int16_t filter, void* trigger_data) {
   LOG_USE_MODULE(EventQueue);
   LOG_TRACE(L"triggerEvent: ident:0x%08llx, filter:%d", (uint64_t)ident, filter);
+  TRACE_SPAN("sync", "equeue trigger");
 
   std::unique_lock const lock(m_mutex_cond);
   auto it = std::find_if(m_events.begin(), m_events.end(), [=](KernelEqueueEvent const& ev) { return ev.event.ident == ident && ev.event.filter == filter; });
@@ -269,6 +278,7 @@ int KernelEqueue::triggerEvent(uintptr_t ident, int16_t filter, void* trigger_da
     } else {
       it->triggered = true;
     }
+    trace::flowBegin("equeue", (uint64_t)this);
     m_cond_var.notify_all();
     return Ok;
   }
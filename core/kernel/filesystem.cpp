@@ -1,6 +1,9 @@
 #include "filesystem.h"
 
+#include "core/dmem/dmem.h"
 #include "core/fileManager/fileManager.h"
+#include "core/kernel/resourceUsage.h"
+#include "core/trace/trace.h"
 #include "logging.h"
 
 #include <assert.h>
@@ -81,11 +84,13 @@ int mmap(void* addr, size_t len, int prot, SceMap flags, int fd, int64_t offset,
 }
 
 int munmap(void* address, size_t len) {
+  if (accessFlexibleMemory().destroy((uint64_t)address, len)) return Ok;
   return UnmapViewOfFile(address) != 0 ? Ok : -1;
 }
 
 size_t read(int handle, void* buf, size_t nbytes) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "read");
   if (handle < FILE_DESCRIPTOR_MIN) {
     return getErr(ErrCode::_EPERM);
   }
@@ -100,6 +105,7 @@ size_t read(int handle, void* buf, size_t nbytes) {
   }
 
   file->read((char*)buf, nbytes);
+  Kernel::ResourceUsage::countRead();
   auto const count = file->gcount();
   LOG_TRACE(L"KernelRead[%d]: 0x%08llx:%llu read(%lld)", handle, (uint64_t)buf, nbytes, count);
   return count;
@@ -107,6 +113,7 @@ size_t read(int handle, void* buf, size_t nbytes) {
 
 int64_t write(int handle, const void* buf, size_t nbytes) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "write");
 
   if (handle < FILE_DESCRIPTOR_MIN) {
     return getErr(ErrCode::_EPERM);
@@ -120,6 +127,7 @@ int64_t write(int handle, const void* buf, size_t nbytes) {
 
   auto const start = file->tellp(); // current pos
   file->write((char*)buf, nbytes);
+  Kernel::ResourceUsage::countWrite();
   size_t count = file->tellp() - start;
 
   LOG_TRACE(L"KernelWrite[%d]: 0x%08llx:%llu count:%llu", handle, (uint64_t)buf, nbytes, count);
@@ -130,6 +138,7 @@ int64_t write(int handle, const void* buf, size_t nbytes) {
 
 int open(const char* path, SceOpen flags, SceKernelMode kernelMode) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "open");
 
   if (path == nullptr) {
     return getErr(ErrCode::_EINVAL);
@@ -327,6 +336,7 @@ int utimes(const char* path, const SceKernelTimeval* times) {
 
 int stat(const char* path, SceKernelStat* sb) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "stat");
 
   LOG_TRACE(L"KernelStat: %S", path);
 
@@ -413,6 +423,7 @@ size_t pwritev(int handle, const SceKernelIovec* iov, int iovcnt, int64_t offset
 
 size_t pread(int handle, void* buf, size_t nbytes, int64_t offset) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "pread");
   LOG_TRACE(L"pread [%d]", handle);
   if (handle < FILE_DESCRIPTOR_MIN) {
     return getErr(ErrCode::_EPERM);
@@ -439,6 +450,7 @@ size_t pread(int handle, void* buf, size_t nbytes, int64_t offset) {
   }
 
   file->read((char*)buf, nbytes);
+  Kernel::ResourceUsage::countRead();
   auto const count = file->gcount();
   LOG_TRACE(L"pread[%d]: 0x%08llx:%llu read(%lld) offset:0x%08llx", handle, (uint64_t)buf, nbytes, count, offset);
   return count;
@@ -446,6 +458,7 @@ size_t pread(int handle, void* buf, size_t nbytes, int64_t offset) {
 
 size_t pwrite(int handle, const void* buf, size_t nbytes, int64_t offset) {
   LOG_USE_MODULE(filesystem);
+  TRACE_SPAN("fs", "pwrite");
   LOG_TRACE(L"pwrite[%d]: 0x%08llx:%llu", handle, (uint64_t)buf, nbytes);
   if (handle < FILE_DESCRIPTOR_MIN) {
     return getErr(ErrCode::_EPERM);
@@ -458,6 +471,7 @@ size_t pwrite(int handle, const void* buf, size_t nbytes, int64_t offset) {
 
   file->seekp(offset);
   file->write((char*)buf, nbytes);
+  Kernel::ResourceUsage::countWrite();
   if (*file) return Ok;
 
   return getErr(ErrCode::_EIO);
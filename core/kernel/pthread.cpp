@@ -13,6 +13,9 @@
 #include "core/timer/timer.h"
 #undef __APICALL_IMPORT
 
+#include "core/trace/trace.h"
+#include "core/kernel/resourceUsage.h"
+
 #include <assert.h>
 #include <boost/chrono.hpp>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -345,6 +348,7 @@ int condTimedwait(ScePthreadCond* cond, ScePthreadMutex* mutex, SceKernelUsecond
   LOG_USE_MODULE(pthread);
   // LOG_DEBUG(L"->Cond: %S mutex:%d", (*cond)->name.c_str(), (*mutex)->id);
 
+  Kernel::ResourceUsage::countBlockingWait();
   auto ret = (*cond)->p.do_wait_until((*mutex)->p, boost::detail::internal_platform_clock::now() + boost::chrono::microseconds(usec))
                  ? Ok
                  : getErr(ErrCode::_ETIMEDOUT);
@@ -358,6 +362,7 @@ int condTimedwait(ScePthreadCond* cond, ScePthreadMutex* mutex, const SceKernelT
   LOG_USE_MODULE(pthread);
   // LOG_DEBUG(L"->Cond: %S mutex:%d", (*cond)->name.c_str(), (*mutex)->id);
 
+  Kernel::ResourceUsage::countBlockingWait();
   auto ret = (*cond)->p.do_wait_until((*mutex)->p, boost::detail::internal_platform_clock::now() + getTimeDuration(t)) ? Ok : getErr(ErrCode::_ETIMEDOUT);
   // LOG_DEBUG(L"<-Cond: %S", (*cond)->name.c_str());
   return ret;
@@ -368,6 +373,7 @@ int condWait(ScePthreadCond* cond, ScePthreadMutex* mutex) {
 
   LOG_USE_MODULE(pthread);
   // LOG_DEBUG(L"->Cond: %S mutex:%d", (*cond)->name.c_str(), (*mutex)->id);
+  Kernel::ResourceUsage::countBlockingWait();
   (*cond)->p.do_wait_until((*mutex)->p, boost::detail::internal_platform_timepoint::getMax());
 
   // LOG_DEBUG(L"<-Cond: %S", (*cond)->name.c_str());
@@ -519,7 +525,11 @@ int mutexLock(ScePthreadMutex* mutex) {
   if (int res = checkMutexInit(mutex); res != Ok) return res;
 
   // LOG_DEBUG(L"-> mutex lock(%S)| id:%llu thread:%d", (*mutex)->name.c_str(), (*mutex)->id, getThreadId());
-  (*mutex)->p.lock();
+  if (!(*mutex)->p.try_lock()) {
+    TRACE_SPAN("sync", "mutex wait"); // only contended locks
+    Kernel::ResourceUsage::countBlockingWait();
+    (*mutex)->p.lock();
+  }
   int ret = Ok;
   if ((*mutex)->type != SceMutexType::RECURSIVE && (*mutex)->p.recursion_count > 1) {
     ret = getErr(ErrCode::_EDEADLK);
@@ -1242,6 +1252,7 @@ ScePthread setup_thread(void* arg) {
   thread->started = true;
   thread->started.notify_one();
   util::setThreadName(thread->name);
+  trace::setThreadName(thread->name.c_str());
 
   return thread;
 }
@@ -0,0 +1,239 @@
+#define __APICALL_EXTERN
+#include "resourceUsage.h"
+#undef __APICALL_EXTERN
+
+#include "logging.h"
+
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <psapi.h>
+#include <vector>
+
+LOG_DEFINE_MODULE(ResourceUsage);
+
+namespace Kernel::ResourceUsage {
+namespace {
+constexpr auto SNAPSHOT_MAX_AGE = std::chrono::milliseconds(50); // NtQuerySystemInformation walks all processes
+
+struct Counters {
+  uint64_t reads  = 0;
+  uint64_t writes = 0;
+  uint64_t waits  = 0;
+};
+
+struct ProcessCounters {
+  std::atomic<uint64_t> reads  = 0;
+  std::atomic<uint64_t> writes = 0;
+  std::atomic<uint64_t> waits  = 0;
+};
+
+thread_local Counters t_counters;
+ProcessCounters       g_counters;
+
+thread_local uint64_t t_lastInvoluntary = 0;
+
+std::atomic<uint64_t> g_lastMinorFaults = 0;
+std::atomic<uint64_t> g_lastInvoluntary = 0;
+
+// Layout of SYSTEM_PROCESS_INFORMATION (x64) up to the thread array
+struct SystemProcessInfo {
+  ULONG   nextEntryOffset;
+  ULONG   numberOfThreads;
+  uint8_t reserved0[0x08];
+  ULONG   hardFaultCount;
+  uint8_t reserved1[0x3C];
+  HANDLE  uniqueProcessId;
+  uint8_t reserved2[0xA8];
+};
+
+static_assert(sizeof(SystemProcessInfo) == 0x100);
+
+struct SystemThreadInfo {
+  uint8_t reserved0[0x28];
+  HANDLE  uniqueProcess;
+  HANDLE  uniqueThread;
+  uint8_t reserved1[0x08];
+  ULONG   contextSwitches;
+  uint8_t reserved2[0x0C];
+};
+
+static_assert(sizeof(SystemThreadInfo) == 0x50);
+
+using NtQuerySystemInformation_t = LONG(WINAPI*)(int infoClass, void* info, ULONG infoLength, ULONG* returnLength);
+
+/**
+ * @brief Hard faults and context switches, only available from the system process list
+ *
+ */
+class HostSnapshot {
+  std::mutex m_mutex;
+
+  NtQuerySystemInformation_t m_query = nullptr;
+  std::vector<uint8_t>       m_buffer;
+
+  std::chrono::steady_clock::time_point m_time;
+
+  uint64_t                                m_hardFaults = 0;
+  uint64_t                                m_switches   = 0;
+  std::vector<std::pair<DWORD, uint64_t>> m_threadSwitches;
+
+  void update();
+
+  public:
+  HostSnapshot() {
+    m_query = (NtQuerySystemInformation_t)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation");
+    m_buffer.resize(512 * 1024);
+  }
+
+  void getProcess(uint64_t* hardFaults, uint64_t* switches);
+  void getThread(DWORD threadId, uint64_t* switches);
+};
+
+HostSnapshot& accessSnapshot() {
+  static HostSnapshot inst;
+  return inst;
+}
+
+void HostSnapshot::update() {
+  auto const now = std::chrono::steady_clock::now();
+  if (m_query == nullptr || (m_time.time_since_epoch().count() != 0 && now - m_time < SNAPSHOT_MAX_AGE)) return;
+  m_time = now;
+
+  constexpr int  SystemProcessInformation    = 5;
+  constexpr LONG STATUS_INFO_LENGTH_MISMATCH = (LONG)0xC0000004;
+
+  ULONG size   = 0;
+  LONG  status = 0;
+  while ((status = m_query(SystemProcessInformation, m_buffer.data(), (ULONG)m_buffer.size(), &size)) == STATUS_INFO_LENGTH_MISMATCH) {
+    m_buffer.resize(std::max((size_t)size, m_buffer.size()) + 64 * 1024);
+  }
+  if (status < 0) {
+    LOG_USE_MODULE(ResourceUsage);
+    LOG_WARN(L"NtQuerySystemInformation failed: 0x%08x", status);
+    m_query = nullptr;
+    return;
+  }
+
+  auto const processId = (HANDLE)(uintptr_t)GetCurrentProcessId();
+  for (auto pos = m_buffer.data();;) {
+    auto const process = (SystemProcessInfo const*)pos;
+    if (process->uniqueProcessId == processId) {
+      auto const threads = (SystemThreadInfo const*)(pos + sizeof(SystemProcessInfo));
+
+      m_hardFaults = process->hardFaultCount;
+      m_switches   = 0;
+      m_threadSwitches.clear();
+      for (ULONG n = 0; n < process->numberOfThreads; ++n) {
+        m_switches += threads[n].contextSwitches;
+        m_threadSwitches.push_back({(DWORD)(uintptr_t)threads[n].uniqueThread, threads[n].contextSwitches});
+      }
+      break;
+    }
+    if (process->nextEntryOffset == 0) break;
+    pos += process->nextEntryOffset;
+  }
+}
+
+void HostSnapshot::getProcess(uint64_t* hardFaults, uint64_t* switches) {
+  std::unique_lock const lock(m_mutex);
+  update();
+  *hardFaults = m_hardFaults;
+  *switches   = m_switches;
+}
+
+void HostSnapshot::getThread(DWORD threadId, uint64_t* switches) {
+  std::unique_lock const lock(m_mutex);
+  update();
+
+  auto it   = std::find_if(m_threadSwitches.begin(), m_threadSwitches.end(), [threadId](auto const& item) { return item.first == threadId; });
+  *switches = it != m_threadSwitches.end() ? it->second : 0;
+}
+
+/**
+ * @brief Values derived from the cached snapshot and live counters may lag behind, reported values never decrease
+ *
+ */
+uint64_t keepMonotonic(std::atomic<uint64_t>& last, uint64_t value) {
+  auto prev = last.load(std::memory_order_relaxed);
+  while (prev < value && !last.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+  }
+  return std::max(prev, value);
+}
+
+uint64_t toUs(FILETIME const& time) {
+  return ((uint64_t)time.dwHighDateTime << 32u | time.dwLowDateTime) / 10;
+}
+
+void getMemory(Usage& usage) {
+  PROCESS_MEMORY_COUNTERS counters {.cb = sizeof(PROCESS_MEMORY_COUNTERS)};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) != 0) {
+    usage.maxRssKb    = counters.PeakWorkingSetSize / 1024;
+    usage.minorFaults = counters.PageFaultCount; // hard faults are subtracted by the caller
+  }
+}
+} // namespace
+
+Usage getProcess() {
+  Usage usage {};
+
+  FILETIME creation, exit, kernel, user;
+  if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) != 0) {
+    usage.userTimeUs   = toUs(user);
+    usage.systemTimeUs = toUs(kernel);
+  }
+  getMemory(usage);
+
+  uint64_t hardFaults = 0, switches = 0;
+  accessSnapshot().getProcess(&hardFaults, &switches);
+
+  usage.majorFaults         = hardFaults;
+  usage.minorFaults         = keepMonotonic(g_lastMinorFaults, usage.minorFaults > hardFaults ? usage.minorFaults - hardFaults : 0);
+  usage.inBlock             = g_counters.reads.load(std::memory_order_relaxed);
+  usage.outBlock            = g_counters.writes.load(std::memory_order_relaxed);
+  usage.voluntarySwitches   = g_counters.waits.load(std::memory_order_relaxed);
+  usage.involuntarySwitches = keepMonotonic(g_lastInvoluntary, switches > usage.voluntarySwitches ? switches - usage.voluntarySwitches : 0);
+  return usage;
+}
+
+Usage getThread() {
+  Usage usage {};
+
+  FILETIME creation, exit, kernel, user;
+  if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) != 0) {
+    usage.userTimeUs   = toUs(user);
+    usage.systemTimeUs = toUs(kernel);
+  }
+
+  // Windows counts memory and page faults per process only
+  getMemory(usage);
+  usage.minorFaults = 0;
+
+  uint64_t switches = 0;
+  accessSnapshot().getThread(GetCurrentThreadId(), &switches);
+
+  usage.inBlock             = t_counters.reads;
+  usage.outBlock            = t_counters.writes;
+  usage.voluntarySwitches   = t_counters.waits;
+  usage.involuntarySwitches = t_lastInvoluntary = std::max(t_lastInvoluntary, switches > usage.voluntarySwitches ? switches - usage.voluntarySwitches : 0);
+  return usage;
+}
+
+void countRead() {
+  ++t_counters.reads;
+  g_counters.reads.fetch_add(1, std::memory_order_relaxed);
+}
+
+void countWrite() {
+  ++t_counters.writes;
+  g_counters.writes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void countBlockingWait() {
+  ++t_counters.waits;
+  g_counters.waits.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace Kernel::ResourceUsage
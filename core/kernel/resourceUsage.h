@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+/**
+ * @brief Host resource usage (times, memory, page faults, context switches) combined with counters of the emulated kernel
+ *
+ */
+namespace Kernel::ResourceUsage {
+struct Usage {
+  uint64_t userTimeUs;
+  uint64_t systemTimeUs;
+  uint64_t maxRssKb;
+  uint64_t minorFaults;
+  uint64_t majorFaults;
+  uint64_t inBlock;             /// file reads
+  uint64_t outBlock;            /// file writes
+  uint64_t voluntarySwitches;   /// blocking waits on sync primitives
+  uint64_t involuntarySwitches; /// host context switches without the blocking waits
+};
+
+__APICALL Usage getProcess();
+__APICALL Usage getThread();
+
+// Counters of the emulated kernel
+__APICALL void countRead();
+__APICALL void countWrite();
+__APICALL void countBlockingWait();
+} // namespace Kernel::ResourceUsage
+
+#undef __APICALL
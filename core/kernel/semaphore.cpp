@@ -1,5 +1,7 @@
 #include "semaphore.h"
 
+#include "core/kernel/resourceUsage.h"
+#include "core/trace/trace.h"
 #include "logging.h"
 #include "modules_include/common.h"
 
@@ -97,6 +99,7 @@ int Semaphore::cancel(int setCount, int* numWaitingThreads) {
 
 int Semaphore::signal(int signalCount) {
   LOG_USE_MODULE(Semaphore);
+  TRACE_SPAN("sync", "sema signal");
 
   boost::unique_lock lock(m_mutex);
   LOG_TRACE(L"KernelSema(%llu) name:%S signal:%d count:%d", m_id, m_name.c_str(), signalCount, m_count);
@@ -111,6 +114,7 @@ int Semaphore::signal(int signalCount) {
   }
   if (signalCount > 0) {
     m_count += signalCount;
+    trace::flowBegin("sema", m_id);
     if (!m_condQueue.empty()) m_condQueue.front()->notify_one();
   }
   return Ok;
@@ -118,6 +122,7 @@ int Semaphore::signal(int signalCount) {
 
 int Semaphore::wait_internal(int needCount, uint32_t* pMicros, boost::unique_lock<boost::mutex>& lock) {
   LOG_USE_MODULE(Semaphore);
+  TRACE_SPAN("sync", "sema wait");
   std::chrono::time_point<std::chrono::system_clock> start     = std::chrono::system_clock::now();
   uint32_t const                                     micros    = pMicros != nullptr ? *pMicros : 0;
   size_t                                             waitCount = 0;
@@ -136,21 +141,24 @@ int Semaphore::wait_internal(int needCount, uint32_t* pMicros, boost::unique_loc
     waitCount = m_waitCounter++;
     LOG_TRACE(L"-> KernelSema(%llu) name:%S waitCount:%llu need:%d count:%d time:%u us", m_id, m_name.c_str(), waitCount, needCount, m_count, micros);
 
+    auto const isReady = [this, condVar, needCount] { return m_state != Status::Set || (m_condQueue.front() == condVar && m_count >= needCount); };
+    if (!isReady()) Kernel::ResourceUsage::countBlockingWait();
+
     m_countThreads++;
     if (pMicros != nullptr) {
-      if (!condVar->wait_for(lock, boost::chrono::microseconds(micros),
-                             [this, condVar, needCount] { return m_state != Status::Set || (m_condQueue.front() == condVar && m_count >= needCount); })) {
+      if (!condVar->wait_for(lock, boost::chrono::microseconds(micros), isReady)) {
         LOG_WARN(L"<- KernelSema(%llu) name:%S waitCount:%llu timeout", m_id, m_name.c_str(), waitCount);
         *pMicros = 0;
         m_countThreads--;
         return getErr(ErrCode::_ETIMEDOUT);
       }
     } else {
-      condVar->wait(lock, [this, condVar, needCount] { return m_state != Status::Set || (m_condQueue.front() == condVar && m_count >= needCount); });
+      condVar->wait(lock, isReady);
     }
 
     if (m_fifo) m_condQueue.pop();
     m_count -= needCount;
+    trace::flowEnd("sema", m_id);
     m_countThreads--;
 
     m_condState.notify_all();
@@ -0,0 +1,364 @@
+#define __APICALL_EXTERN
+#include "heap.h"
+#undef __APICALL_EXTERN
+
+#include "logging.h"
+#include "utility/utility.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+LOG_DEFINE_MODULE(heap);
+
+namespace {
+constexpr size_t ALIGN_SIZE  = 16;
+constexpr size_t HEADER_SIZE = 16;
+
+// Size classes (incl. header): 16 byte steps up to 256, then 4 steps per power of two up to 64KB
+constexpr uint32_t NUM_LINEAR_CLASSES = 16;
+constexpr uint32_t NUM_CLASSES        = NUM_LINEAR_CLASSES + 4 * 8;
+constexpr size_t   MAX_SMALL_SIZE     = 64 * 1024;
+constexpr uint16_t CLASS_LARGE        = 0xffff;
+
+constexpr size_t SPAN_SIZE = 256 * 1024;
+
+constexpr size_t classSize(uint32_t index) {
+  if (index < NUM_LINEAR_CLASSES) return ALIGN_SIZE * (index + 1);
+
+  auto const p   = 8 + (index - NUM_LINEAR_CLASSES) / 4;
+  auto const sub = (index - NUM_LINEAR_CLASSES) % 4 + 1;
+  return (size_t(1) << p) + sub * (size_t(1) << (p - 2));
+}
+
+constexpr uint32_t classIndex(size_t size) {
+  if (size <= 256) return (uint32_t)((size + ALIGN_SIZE - 1) / ALIGN_SIZE) - 1;
+
+  auto const p   = (uint32_t)std::bit_width(size - 1) - 1;
+  auto const sub = (uint32_t)((size - (size_t(1) << p) + (size_t(1) << (p - 2)) - 1) >> (p - 2));
+  return NUM_LINEAR_CLASSES + (p - 8) * 4 + sub - 1;
+}
+
+static_assert(classSize(NUM_CLASSES - 1) == MAX_SMALL_SIZE);
+static_assert(classIndex(MAX_SMALL_SIZE) == NUM_CLASSES - 1);
+static_assert(classIndex(257) == NUM_LINEAR_CLASSES && classSize(NUM_LINEAR_CLASSES) == 320);
+
+/**
+ * @brief Sits directly before every returned pointer
+ *
+ */
+struct Header {
+  uint64_t usable;    /// bytes usable from the returned pointer
+  uint32_t offset;    /// returned pointer - block start
+  uint16_t sizeClass; /// CLASS_LARGE: host allocation
+  uint16_t pad;
+};
+
+static_assert(sizeof(Header) == HEADER_SIZE);
+
+Header* getHeader(void const* ptr) {
+  return (Header*)((uint8_t const*)ptr - HEADER_SIZE);
+}
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+constexpr uint32_t batchCount(uint32_t index) {
+  return (uint32_t)std::clamp<size_t>(16 * 1024 / classSize(index), 4, 64);
+}
+
+class CentralHeap {
+  struct SizeClass {
+    std::mutex mutex;
+    FreeBlock* head = nullptr;
+  };
+
+  std::array<SizeClass, NUM_CLASSES> m_classes;
+
+  std::atomic<uint64_t> m_systemSize = 0;
+
+  public:
+  std::atomic<int64_t> m_retiredInUse = 0; // inUse of exited threads
+
+  uint32_t fetch(uint32_t index, FreeBlock** head, uint32_t count);
+  void     release(uint32_t index, FreeBlock* first, FreeBlock* last);
+
+  void addSystemSize(int64_t size) { m_systemSize += size; }
+
+  uint64_t systemSize() const { return m_systemSize; }
+};
+
+CentralHeap& accessCentralHeap() {
+  static CentralHeap inst;
+  return inst;
+}
+
+uint32_t CentralHeap::fetch(uint32_t index, FreeBlock** head, uint32_t count) {
+  auto& sc = m_classes[index];
+
+  std::unique_lock lock(sc.mutex);
+  if (sc.head == nullptr) {
+    // Carve a new span, spans are kept until exit
+    auto const size = classSize(index);
+    auto const num  = SPAN_SIZE / size;
+
+    auto span = (uint8_t*)::_aligned_malloc(num * size, ALIGN_SIZE);
+    if (span == nullptr) return 0;
+    m_systemSize += num * size;
+
+    for (size_t n = num; n > 0; --n) {
+      auto block  = (FreeBlock*)(span + (n - 1) * size);
+      block->next = sc.head;
+      sc.head     = block;
+    }
+  }
+
+  uint32_t fetched = 0;
+  for (; fetched < count && sc.head != nullptr; ++fetched) {
+    auto block  = sc.head;
+    sc.head     = block->next;
+    block->next = *head;
+    *head       = block;
+  }
+  return fetched;
+}
+
+void CentralHeap::release(uint32_t index, FreeBlock* first, FreeBlock* last) {
+  auto& sc = m_classes[index];
+
+  std::unique_lock const lock(sc.mutex);
+  last->next = sc.head;
+  sc.head    = first;
+}
+
+class ThreadCache;
+
+std::mutex                g_mutexCaches;
+std::vector<ThreadCache*> g_caches;
+std::atomic<uint64_t>     g_maxInUse = 0;
+
+class ThreadCache {
+  struct FreeList {
+    FreeBlock* head  = nullptr;
+    uint32_t   count = 0;
+  };
+
+  std::array<FreeList, NUM_CLASSES> m_lists;
+
+  public:
+  std::atomic<int64_t> m_inUse = 0; // only written by the owning thread
+
+  ThreadCache() {
+    std::unique_lock const lock(g_mutexCaches);
+    g_caches.push_back(this);
+  }
+
+  ~ThreadCache() {
+    auto& central = accessCentralHeap();
+    for (uint32_t n = 0; n < NUM_CLASSES; ++n) {
+      releaseBatch(n, m_lists[n].count);
+    }
+
+    std::unique_lock const lock(g_mutexCaches);
+    central.m_retiredInUse += m_inUse;
+    std::erase(g_caches, this);
+  }
+
+  void* alloc(uint32_t index) {
+    auto& list = m_lists[index];
+    if (list.head == nullptr) {
+      list.count += accessCentralHeap().fetch(index, &list.head, batchCount(index));
+      if (list.head == nullptr) return nullptr;
+    }
+
+    auto block = list.head;
+    list.head  = block->next;
+    --list.count;
+    return block;
+  }
+
+  void free(uint32_t index, void* ptr) {
+    auto& list = m_lists[index];
+
+    auto block  = (FreeBlock*)ptr;
+    block->next = list.head;
+    list.head   = block;
+    if (++list.count > 2 * batchCount(index)) {
+      releaseBatch(index, batchCount(index));
+    }
+  }
+
+  void releaseBatch(uint32_t index, uint32_t count) {
+    auto& list = m_lists[index];
+    if (count == 0 || list.head == nullptr) return;
+
+    auto first = list.head;
+    auto last  = first;
+    for (uint32_t n = 1; n < count && last->next != nullptr; ++n) {
+      last = last->next;
+    }
+
+    list.head = last->next;
+    list.count -= std::min(list.count, count);
+    accessCentralHeap().release(index, first, last);
+  }
+
+  void addInUse(int64_t size) { m_inUse.store(m_inUse.load(std::memory_order_relaxed) + size, std::memory_order_relaxed); }
+};
+
+ThreadCache& accessThreadCache() {
+  thread_local ThreadCache inst;
+  return inst;
+}
+
+/**
+ * @brief Allocates total bytes (incl. header) and places the user pointer at alignment
+ *
+ */
+void* allocBlock(size_t size, size_t alignment) {
+  if (size > SIZE_MAX - HEADER_SIZE - alignment) return nullptr;
+
+  size_t const total = std::max<size_t>(size, 1) + HEADER_SIZE + (alignment > ALIGN_SIZE ? alignment : 0);
+
+  uint8_t* block     = nullptr;
+  uint16_t sizeClass = CLASS_LARGE;
+  size_t   blockSize = total;
+  if (total <= MAX_SMALL_SIZE) {
+    sizeClass = (uint16_t)classIndex(total);
+    blockSize = classSize(sizeClass);
+    block     = (uint8_t*)accessThreadCache().alloc(sizeClass);
+  } else {
+    block = (uint8_t*)::_aligned_malloc(total, ALIGN_SIZE);
+    if (block != nullptr) accessCentralHeap().addSystemSize((int64_t)total);
+  }
+
+  if (block == nullptr) {
+    LOG_USE_MODULE(heap);
+    LOG_ERR(L"out of memory size:0x%08llx alignment:0x%08llx", size, alignment);
+    return nullptr;
+  }
+
+  auto const ptr = util::alignUp((uint64_t)block + HEADER_SIZE, std::max(alignment, ALIGN_SIZE));
+
+  auto header       = getHeader((void*)ptr);
+  header->usable    = (uint64_t)block + blockSize - ptr;
+  header->offset    = (uint32_t)(ptr - (uint64_t)block);
+  header->sizeClass = sizeClass;
+  header->pad       = 0;
+
+  accessThreadCache().addInUse((int64_t)header->usable);
+  return (void*)ptr;
+}
+} // namespace
+
+namespace heap {
+void* malloc(size_t size) {
+  return allocBlock(size, ALIGN_SIZE);
+}
+
+void* calloc(size_t n, size_t size) {
+  if (size != 0 && n > SIZE_MAX / size) return nullptr;
+
+  auto ptr = allocBlock(n * size, ALIGN_SIZE);
+  if (ptr != nullptr) std::memset(ptr, 0, n * size);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  if (ptr == nullptr) return malloc(size);
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+
+  auto const usable = getHeader(ptr)->usable;
+  if (size <= usable) return ptr;
+
+  auto dst = malloc(size);
+  if (dst == nullptr) return nullptr;
+
+  std::memcpy(dst, ptr, usable);
+  free(ptr);
+  return dst;
+}
+
+void* memalign(size_t alignment, size_t size) {
+  if (!std::has_single_bit(alignment) || alignment > (1u << 30)) return nullptr;
+  return allocBlock(size, alignment);
+}
+
+void free(void* ptr) {
+  if (ptr == nullptr) return;
+
+  auto const header = *getHeader(ptr);
+  auto       block  = (uint8_t*)ptr - header.offset;
+
+  auto& cache = accessThreadCache();
+  cache.addInUse(-(int64_t)header.usable);
+
+  if (header.sizeClass == CLASS_LARGE) {
+    accessCentralHeap().addSystemSize(-(int64_t)(header.usable + header.offset));
+    ::_aligned_free(block);
+  } else {
+    cache.free(header.sizeClass, block);
+  }
+}
+
+size_t usableSize(void const* ptr) {
+  if (ptr == nullptr) return 0;
+  return getHeader(ptr)->usable;
+}
+
+Stats getStats() {
+  auto& central = accessCentralHeap();
+
+  int64_t inUse = 0;
+  {
+    std::unique_lock const lock(g_mutexCaches);
+    inUse = central.m_retiredInUse;
+    for (auto cache: g_caches) {
+      inUse += cache->m_inUse.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Blocks can be freed by another thread than the allocating one -> only the sum is valid
+  auto const inUseTotal = (uint64_t)std::max<int64_t>(inUse, 0);
+
+  auto maxInUse = g_maxInUse.load();
+  while (inUseTotal > maxInUse && !g_maxInUse.compare_exchange_weak(maxInUse, inUseTotal)) {
+  }
+
+  return {.systemSize = central.systemSize(), .inUse = inUseTotal, .maxInUse = std::max(maxInUse, inUseTotal)};
+}
+
+namespace {
+ApplicationHeapAPI g_appHeapAPI {};
+std::atomic_bool   g_appHeapSet  = false;
+std::atomic_bool   g_appHeapRead = false;
+} // namespace
+
+void setApplicationHeapAPI(ApplicationHeapAPI const& api) {
+  LOG_USE_MODULE(heap);
+  if (g_appHeapRead.load(std::memory_order_acquire)) {
+    LOG_WARN(L"application heap api registered after the first allocation, ignored");
+    return;
+  }
+
+  LOG_INFO(L"application heap api| malloc:0x%08llx free:0x%08llx posix_memalign:0x%08llx", (uint64_t)api.malloc, (uint64_t)api.free,
+           (uint64_t)api.posix_memalign);
+
+  g_appHeapAPI = api;
+  g_appHeapSet.store(true, std::memory_order_release);
+}
+
+ApplicationHeapAPI const* getApplicationHeapAPI() {
+  g_appHeapRead.store(true, std::memory_order_release);
+  return g_appHeapSet.load(std::memory_order_acquire) ? &g_appHeapAPI : nullptr;
+}
+} // namespace heap
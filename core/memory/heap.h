@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+/**
+ * @brief Default heap of the emulated libc.
+ * Small sizes are served from per thread caches of size classes, larger ones from the host.
+ *
+ */
+namespace heap {
+struct Stats {
+  uint64_t systemSize; /// bytes requested from the host
+  uint64_t inUse;      /// usable bytes of live allocations
+  uint64_t maxInUse;   /// highest inUse observed by getStats()
+};
+
+/**
+ * @brief Heap functions the libc registers with the kernel (_sceKernelRtldSetApplicationHeapAPI),
+ * same order as in SceMallocReplace
+ *
+ */
+struct ApplicationHeapAPI {
+  void* malloc;
+  void* free;
+  void* calloc;
+  void* realloc;
+  void* memalign;
+  void* reallocalign;
+  void* posix_memalign;
+};
+
+__APICALL void*  malloc(size_t size);
+__APICALL void*  calloc(size_t n, size_t size);
+__APICALL void*  realloc(void* ptr, size_t size);
+__APICALL void*  memalign(size_t alignment, size_t size);
+__APICALL void   free(void* ptr);
+__APICALL size_t usableSize(void const* ptr);
+__APICALL Stats  getStats();
+
+/**
+ * @brief Ignored once getApplicationHeapAPI() was called, allocations of one heap can't be freed by the other
+ *
+ */
+__APICALL void setApplicationHeapAPI(ApplicationHeapAPI const& api);
+
+/**
+ * @brief Read once by the libc on its first heap call
+ *
+ * @return nullptr: none registered, use the default heap
+ */
+__APICALL ApplicationHeapAPI const* getApplicationHeapAPI();
+} // namespace heap
+
+#undef __APICALL
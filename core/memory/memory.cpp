@@ -246,6 +246,15 @@ bool free(uint64_t address) {
   return true;
 }
 
+bool decommit(uint64_t address, uint64_t size) {
+  LOG_USE_MODULE(memory);
+  if (VirtualFree(reinterpret_cast<LPVOID>(static_cast<uintptr_t>(address)), size, MEM_DECOMMIT) == 0) {
+    LOG_ERR(L"VirtualFree() decommit failed addr:0x%08llx size:0x%08llx err:0x%04x", address, size, static_cast<uint32_t>(GetLastError()));
+    return false;
+  }
+  return true;
+}
+
 bool protect(uint64_t address, uint64_t size, int protection, int* oldProt) {
   LOG_USE_MODULE(memory);
 
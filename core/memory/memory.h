@@ -35,6 +35,7 @@ __APICALL uint64_t  alloc(uint64_t address, uint64_t size, int prot);
 __APICALL uint64_t  allocAligned(uint64_t address, uint64_t size, int prot, uint64_t alignment);
 __APICALL bool      allocFixed(uint64_t address, uint64_t size, int prot);
 __APICALL bool      free(uint64_t address);
+__APICALL bool      decommit(uint64_t address, uint64_t size); /// frees the pages of a range, the allocation stays reserved
 __APICALL bool      protect(uint64_t address, uint64_t size, int prot, int* oldMode = nullptr);
 __APICALL int       getProtection(uint64_t address);
 
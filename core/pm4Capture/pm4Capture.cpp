@@ -0,0 +1,255 @@
+#define __APICALL_EXTERN
+#include "pm4Capture.h"
+#undef __APICALL_EXTERN
+
+#include "core/imports/exports/graphics.h"
+#include "core/imports/exports/pm4_custom.h"
+#include "core/imports/exports/pm4_parser.h"
+#include "core/trace/trace.h"
+#include "logging.h"
+#include "pm4Capture_types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <windows.h>
+
+LOG_DEFINE_MODULE(Pm4Capture);
+
+namespace pm4Capture {
+namespace {
+constexpr size_t FILE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+std::atomic<bool> g_enabled = false;
+bool              g_started = false; // wrap() only adds the layer if a capture was started
+
+class Writer {
+  std::mutex m_mutex;
+  FILE*      m_file = nullptr;
+
+  std::unordered_map<uint64_t, uint64_t> m_memoryHashes; // addr -> hash of the last written content
+
+  uint64_t m_numSubmits     = 0;
+  uint64_t m_numMemory      = 0;
+  uint64_t m_bytesWritten   = 0;
+  uint64_t m_memorySkipped  = 0; // unchanged ranges
+  uint64_t m_memoryUnmapped = 0; // ranges not (fully) readable
+
+  void write(void const* data, size_t size) {
+    fwrite(data, 1, size, m_file);
+    m_bytesWritten += size;
+  }
+
+  void writeMemory(uint64_t addr, uint64_t size);
+  void writeIndexBuffers(uint32_t const* cmds, uint32_t numBytes);
+
+  public:
+  bool open(char const* path);
+  void close();
+
+  void writeSubmit(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawBytes[], uint32_t const* constBuffers[],
+                   uint32_t const numConstBytes[], int handle, int index, int flipMode, int64_t flipArg, bool flip);
+};
+
+Writer& accessWriter() {
+  static auto inst = new Writer; // never destroyed, the gpu thread may submit during static destruction
+  return *inst;
+}
+
+uint64_t hashData(uint8_t const* data, uint64_t size) {
+  uint64_t hash = 0xcbf29ce484222325ull; // fnv-1a on 64bit words
+
+  uint64_t n = 0;
+  for (; n + sizeof(uint64_t) <= size; n += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + n, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  for (; n < size; ++n) {
+    hash = (hash ^ data[n]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/**
+ * @brief Bytes at addr that can be read, packets may reference memory the game hasn't mapped (yet)
+ *
+ */
+uint64_t getReadableSize(uint64_t addr, uint64_t size) {
+  uint64_t                 readable = 0;
+  MEMORY_BASIC_INFORMATION info;
+  while (readable < size && VirtualQuery((void const*)(addr + readable), &info, sizeof(info)) != 0) {
+    if (info.State != MEM_COMMIT || (info.Protect & (PAGE_NOACCESS | PAGE_GUARD)) != 0) break;
+    readable = (uint64_t)info.BaseAddress + info.RegionSize - addr;
+  }
+  return std::min(readable, size);
+}
+
+bool Writer::open(char const* path) {
+  std::unique_lock const lock(m_mutex);
+
+  m_file = fopen(path, "wb");
+  if (m_file == nullptr) return false;
+  setvbuf(m_file, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+  FileHeader const header;
+  write(&header, sizeof(header));
+  return true;
+}
+
+void Writer::close() {
+  LOG_USE_MODULE(Pm4Capture);
+  std::unique_lock const lock(m_mutex);
+  if (m_file == nullptr) return;
+
+  fclose(m_file);
+  m_file = nullptr;
+  m_memoryHashes.clear();
+
+  LOG_INFO(L"capture done| submits:%llu memory:%llu (unchanged:%llu unmapped:%llu) size:%llu KB", m_numSubmits, m_numMemory, m_memorySkipped,
+           m_memoryUnmapped, m_bytesWritten / 1024);
+}
+
+void Writer::writeMemory(uint64_t addr, uint64_t size) {
+  if (auto const readable = getReadableSize(addr, size); readable < size) {
+    ++m_memoryUnmapped;
+    size = readable;
+  }
+  if (size == 0) return;
+
+  auto const hash = hashData((uint8_t const*)addr, size);
+  if (auto [it, inserted] = m_memoryHashes.try_emplace(addr, hash); !inserted) {
+    if (it->second == hash) {
+      ++m_memorySkipped;
+      return;
+    }
+    it->second = hash;
+  }
+
+  RecordHeader const header {.type = RecordType::Memory, .size = sizeof(MemoryRecord) + size};
+  MemoryRecord const record {.addr = addr, .size = size};
+  write(&header, sizeof(header));
+  write(&record, sizeof(record));
+  write((void const*)addr, size);
+  ++m_numMemory;
+}
+
+void Writer::writeIndexBuffers(uint32_t const* cmds, uint32_t numBytes) {
+  Pm4::parse(cmds, numBytes / sizeof(uint32_t), [this](Pm4::Packet const& packet) {
+    if (packet.type == Pm4::PacketType::Custom && packet.op == Pm4::R_DRAW_INDEX && packet.len >= 4) {
+      // The index size is set by a separate packet, capture the 32bit upper bound
+      writeMemory(util::getAddress(&packet.data[2]), (uint64_t)packet.data[1] * sizeof(uint32_t));
+    }
+    return true;
+  });
+}
+
+void Writer::writeSubmit(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawBytes[], uint32_t const* constBuffers[],
+                         uint32_t const numConstBytes[], int handle, int index, int flipMode, int64_t flipArg, bool flip) {
+  TRACE_SPAN("gpu", "capture");
+  std::unique_lock const lock(m_mutex);
+  if (m_file == nullptr) return;
+
+  uint64_t payloadSize = sizeof(SubmitRecord) + count * sizeof(BufferInfo);
+  for (uint32_t n = 0; n < count; ++n) {
+    if (drawBuffers != nullptr) {
+      writeIndexBuffers(drawBuffers[n], numDrawBytes[n]);
+      payloadSize += numDrawBytes[n];
+    }
+    if (constBuffers != nullptr) payloadSize += numConstBytes[n];
+  }
+
+  RecordHeader const header {.type = RecordType::Submit, .size = payloadSize};
+  SubmitRecord const record {.count = count, .handle = handle, .index = index, .flipMode = flipMode, .flipArg = flipArg, .flip = flip};
+  write(&header, sizeof(header));
+  write(&record, sizeof(record));
+
+  for (uint32_t n = 0; n < count; ++n) {
+    BufferInfo const info {
+        .dcbAddr = drawBuffers != nullptr ? (uint64_t)drawBuffers[n] : 0,
+        .ccbAddr = constBuffers != nullptr ? (uint64_t)constBuffers[n] : 0,
+        .dcbSize = drawBuffers != nullptr ? numDrawBytes[n] : 0,
+        .ccbSize = constBuffers != nullptr ? numConstBytes[n] : 0,
+    };
+    write(&info, sizeof(info));
+  }
+
+  for (uint32_t n = 0; n < count; ++n) {
+    if (drawBuffers != nullptr) write(drawBuffers[n], numDrawBytes[n]);
+    if (constBuffers != nullptr) write(constBuffers[n], numConstBytes[n]);
+  }
+  ++m_numSubmits;
+}
+
+/**
+ * @brief Forwards everything, submits are written first
+ *
+ */
+class CaptureGraphics: public IGraphics {
+  std::unique_ptr<IGraphics> m_graphics;
+
+  public:
+  CaptureGraphics(std::unique_ptr<IGraphics> graphics): m_graphics(std::move(graphics)) {}
+
+  virtual ~CaptureGraphics() = default;
+
+  int addEvent(Kernel::EventQueue::KernelEqueueEvent& event, Kernel::EventQueue::IKernelEqueue_t eq) final { return m_graphics->addEvent(event, eq); }
+
+  void removeEvent(Kernel::EventQueue::IKernelEqueue_t eq, int const ident) final { m_graphics->removeEvent(eq, ident); }
+
+  void registerCommandBuffer(void* cmdBufferClass) final { m_graphics->registerCommandBuffer(cmdBufferClass); }
+
+  void submitCmdBuffer(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawDw[], uint32_t const* constBuffers[], uint32_t const numConstDw[],
+                       int const handle, int const index, int const flipMode, int64_t const flipArg, bool flip) final {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+      accessWriter().writeSubmit(count, drawBuffers, numDrawDw, constBuffers, numConstDw, handle, index, flipMode, flipArg, flip);
+    }
+    m_graphics->submitCmdBuffer(count, drawBuffers, numDrawDw, constBuffers, numConstDw, handle, index, flipMode, flipArg, flip);
+  }
+
+  void waitSubmitDone() final { m_graphics->waitSubmitDone(); }
+
+  void submited() final { m_graphics->submited(); }
+
+  void submitDone() final { m_graphics->submitDone(); }
+
+  bool isRunning() const final { return m_graphics->isRunning(); }
+};
+} // namespace
+
+bool start(char const* path) {
+  LOG_USE_MODULE(Pm4Capture);
+  stop();
+
+  if (!accessWriter().open(path)) {
+    LOG_ERR(L"couldn't create %S", path);
+    return false;
+  }
+
+  static std::once_flag atExit;
+  std::call_once(atExit, [] { atexit(stop); });
+
+  g_started = true;
+  g_enabled = true;
+  LOG_INFO(L"capturing to %S", path);
+  return true;
+}
+
+void stop() {
+  if (!g_enabled.exchange(false)) return;
+  accessWriter().close();
+}
+
+bool isEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<IGraphics> wrap(std::unique_ptr<IGraphics> graphics) {
+  if (!g_started || !graphics) return graphics;
+  return std::make_unique<CaptureGraphics>(std::move(graphics));
+}
+} // namespace pm4Capture
@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+class IGraphics;
+
+/**
+ * @brief Records submitted command buffers (dcb, ccb) and the index buffers they draw from, see pm4Capture_types.h.
+ * Replay with tools/pm4Replay.
+ *
+ */
+namespace pm4Capture {
+
+/**
+ * @brief Starts writing submits to path
+ *
+ * @param path capture file, finished by stop() or at exit
+ * @return false if the file can't be created
+ */
+__APICALL bool start(char const* path);
+
+__APICALL void stop();
+
+__APICALL bool isEnabled();
+
+/**
+ * @brief Records submitCmdBuffer() calls while a capture is running
+ *
+ * @param graphics
+ * @return the wrapped graphics, or graphics if capturing was never started
+ */
+__APICALL std::unique_ptr<IGraphics> wrap(std::unique_ptr<IGraphics> graphics);
+} // namespace pm4Capture
+
+#undef __APICALL
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief File layout of a pm4 capture: FileHeader, then records (RecordHeader + payload).
+ * Memory records precede the submit that references them and are only written when the content changed.
+ *
+ */
+namespace pm4Capture {
+constexpr uint32_t FILE_MAGIC   = 0x43344d50; // "PM4C"
+constexpr uint32_t FILE_VERSION = 1;
+
+struct FileHeader {
+  uint32_t magic   = FILE_MAGIC;
+  uint32_t version = FILE_VERSION;
+};
+
+enum class RecordType : uint32_t {
+  Memory = 1,
+  Submit = 2,
+};
+
+struct RecordHeader {
+  RecordType type;
+  uint32_t   reserved = 0;
+  uint64_t   size; // payload
+};
+
+// Payload: MemoryRecord, data
+struct MemoryRecord {
+  uint64_t addr;
+  uint64_t size;
+};
+
+// Payload: SubmitRecord, BufferInfo[count], data of dcb[0], ccb[0], dcb[1] ...
+struct SubmitRecord {
+  uint32_t count;
+  int32_t  handle;
+  int32_t  index;
+  int32_t  flipMode;
+  int64_t  flipArg;
+  uint32_t flip;
+  uint32_t reserved = 0;
+};
+
+struct BufferInfo {
+  uint64_t dcbAddr;
+  uint64_t ccbAddr;
+  uint32_t dcbSize; // bytes
+  uint32_t ccbSize; // bytes
+};
+} // namespace pm4Capture
@@ -0,0 +1,268 @@
+#define __APICALL_EXTERN
+#include "trace.h"
+#undef __APICALL_EXTERN
+
+#include "logging.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+LOG_DEFINE_MODULE(Trace);
+
+namespace trace {
+namespace {
+constexpr size_t CHUNK_EVENTS = 16 * 1024;
+constexpr size_t MAX_CHUNKS   = 64; // per thread, afterwards events are dropped
+
+enum class EventType : uint8_t {
+  Span,
+  Counter,
+  FlowBegin,
+  FlowEnd,
+};
+
+struct Event {
+  uint64_t    ts;    // ns
+  uint64_t    value; // span: duration, counter: value, flow: id
+  char const* category;
+  char const* name;
+  EventType   type;
+};
+
+/**
+ * @brief Events of one thread. Only the owner writes, the exporter reads [0, count)
+ *
+ */
+struct ThreadBuffer {
+  uint32_t              threadId;
+  std::string           name; // guarded by getMutex()
+  std::atomic<uint32_t> session = 0;
+
+  std::array<std::unique_ptr<Event[]>, MAX_CHUNKS> chunks;
+
+  std::atomic<uint64_t> count   = 0;
+  std::atomic<uint64_t> dropped = 0;
+  std::atomic<bool>     exited  = false;
+
+  ThreadBuffer(uint32_t id): threadId(id) {}
+};
+
+std::atomic<bool>     g_enabled = false;
+std::atomic<uint32_t> g_session = 0;
+
+std::mutex& getMutex() {
+  static std::mutex mMutex;
+  return mMutex;
+}
+
+std::vector<ThreadBuffer*>& getBuffers() {
+  static auto inst = new std::vector<ThreadBuffer*>; // never destroyed, threads may outlive static destruction
+  return *inst;
+}
+
+std::string& getPath() {
+  static std::string mPath;
+  return mPath;
+}
+
+// Marks the buffer as exited, start() deletes it
+struct ThreadBufferOwner {
+  ThreadBuffer* buffer = nullptr;
+
+  ~ThreadBufferOwner() {
+    if (buffer != nullptr) buffer->exited = true;
+  }
+};
+
+ThreadBuffer* getBuffer() {
+  thread_local ThreadBufferOwner owner;
+  if (owner.buffer == nullptr) {
+    owner.buffer = new ThreadBuffer(GetCurrentThreadId());
+
+    std::unique_lock const lock(getMutex());
+    getBuffers().push_back(owner.buffer);
+  }
+  return owner.buffer;
+}
+
+uint64_t getTimestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(EventType type, char const* category, char const* name, uint64_t ts, uint64_t value) {
+  auto buffer = getBuffer();
+
+  if (auto const session = g_session.load(std::memory_order_relaxed); buffer->session.load(std::memory_order_relaxed) != session) {
+    buffer->session.store(session, std::memory_order_relaxed); // chunks are kept for reuse
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+  }
+
+  auto const n     = buffer->count.load(std::memory_order_relaxed);
+  auto const chunk = n / CHUNK_EVENTS;
+  if (chunk >= MAX_CHUNKS) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto& events = buffer->chunks[chunk];
+  if (!events) events = std::make_unique<Event[]>(CHUNK_EVENTS);
+
+  events[n % CHUNK_EVENTS] = Event {.ts = ts, .value = value, .category = category, .name = name, .type = type};
+  buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void writeString(FILE* file, char const* str) {
+  fputc('"', file);
+  for (; *str != '\0'; ++str) {
+    if (*str == '"' || *str == '\\') fputc('\\', file);
+    if ((uint8_t)*str >= 0x20) fputc(*str, file);
+  }
+  fputc('"', file);
+}
+
+void writeJson(FILE* file) {
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+  fputs(R"({"ph":"M","pid":1,"tid":0,"name":"process_name","args":{"name":"psOff"}})", file);
+
+  auto const session = g_session.load();
+  for (auto buffer: getBuffers()) {
+    if (buffer->session != session) continue;
+
+    auto const tid = buffer->threadId;
+    if (!buffer->name.empty()) {
+      fprintf(file, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", tid);
+      writeString(file, buffer->name.c_str());
+      fputs("}}", file);
+    }
+
+    auto const count = buffer->count.load(std::memory_order_acquire);
+    for (uint64_t n = 0; n < count; ++n) {
+      auto const& ev = buffer->chunks[n / CHUNK_EVENTS][n % CHUNK_EVENTS];
+      auto const  ts = (double)ev.ts / 1000.0; // us
+
+      switch (ev.type) {
+        case EventType::Span:
+          fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"cat\":", tid, ts, (double)ev.value / 1000.0);
+          writeString(file, ev.category);
+          fputs(",\"name\":", file);
+          writeString(file, ev.name);
+          fputc('}', file);
+          break;
+        case EventType::Counter:
+          fprintf(file, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", tid, ts);
+          writeString(file, ev.name);
+          fprintf(file, ",\"args\":{\"value\":%lld}}", (int64_t)ev.value);
+          break;
+        case EventType::FlowBegin:
+          fprintf(file, ",\n{\"ph\":\"s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"id\":%llu,\"cat\":\"flow\",\"name\":", tid, ts, ev.value);
+          writeString(file, ev.name);
+          fputc('}', file);
+          break;
+        case EventType::FlowEnd: // binds to the enclosing span
+          fprintf(file, ",\n{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"id\":%llu,\"cat\":\"flow\",\"name\":", tid, ts, ev.value);
+          writeString(file, ev.name);
+          fputc('}', file);
+          break;
+      }
+    }
+
+    if (auto const dropped = buffer->dropped.load(); dropped > 0) {
+      LOG_USE_MODULE(Trace);
+      LOG_WARN(L"thread %u: %llu events dropped", tid, dropped);
+    }
+  }
+  fputs("\n]}\n", file);
+}
+} // namespace
+
+bool start(char const* path) {
+  LOG_USE_MODULE(Trace);
+
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    LOG_ERR(L"couldn't create %S", path);
+    return false;
+  }
+  fclose(file);
+
+  {
+    std::unique_lock const lock(getMutex());
+
+    // Buffers of exited threads are only needed until the next session
+    std::erase_if(getBuffers(), [](ThreadBuffer* buffer) {
+      if (!buffer->exited) return false;
+      delete buffer;
+      return true;
+    });
+
+    getPath() = path;
+    ++g_session;
+  }
+
+  static std::once_flag atExit;
+  std::call_once(atExit, [] { atexit(stop); });
+
+  g_enabled = true;
+  LOG_INFO(L"recording to %S", path);
+  return true;
+}
+
+void stop() {
+  LOG_USE_MODULE(Trace);
+  if (!g_enabled.exchange(false)) return;
+
+  std::unique_lock const lock(getMutex());
+
+  FILE* file = fopen(getPath().c_str(), "w");
+  if (file == nullptr) {
+    LOG_ERR(L"couldn't write %S", getPath().c_str());
+    return;
+  }
+  writeJson(file);
+  fclose(file);
+  LOG_INFO(L"written %S", getPath().c_str());
+}
+
+uint64_t spanBegin() {
+  if (!g_enabled.load(std::memory_order_relaxed)) return 0;
+  return getTimestamp();
+}
+
+void spanEnd(char const* category, char const* name, uint64_t begin) {
+  if (!g_enabled.load(std::memory_order_relaxed)) return;
+  record(EventType::Span, category, name, begin, getTimestamp() - begin);
+}
+
+void counter(char const* name, int64_t value) {
+  if (!g_enabled.load(std::memory_order_relaxed)) return;
+  record(EventType::Counter, nullptr, name, getTimestamp(), (uint64_t)value);
+}
+
+void flowBegin(char const* name, uint64_t id) {
+  if (!g_enabled.load(std::memory_order_relaxed)) return;
+  record(EventType::FlowBegin, nullptr, name, getTimestamp(), id);
+}
+
+void flowEnd(char const* name, uint64_t id) {
+  if (!g_enabled.load(std::memory_order_relaxed)) return;
+  record(EventType::FlowEnd, nullptr, name, getTimestamp(), id);
+}
+
+void setThreadName(char const* name) {
+  if (g_session == 0) return; // never started
+
+  auto buffer = getBuffer();
+
+  std::unique_lock const lock(getMutex());
+  buffer->name = name;
+}
+} // namespace trace
@@ -0,0 +1,89 @@
+#pragma once
+#include "utility/utility.h"
+
+#include <stdint.h>
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+/**
+ * @brief Timeline of spans, counters and flows for finding stalls (filesystem, sync primitives, gpu submits).
+ * Events are written to per thread buffers and exported as trace event json (opens in ui.perfetto.dev and chrome://tracing).
+ * Categories and names have to be string literals.
+ *
+ */
+namespace trace {
+
+/**
+ * @brief Starts recording, a running session is discarded
+ *
+ * @param path output file, written by stop() or at exit
+ * @return false if the file can't be created
+ */
+__APICALL bool start(char const* path);
+
+/**
+ * @brief Stops recording and writes the file
+ *
+ */
+__APICALL void stop();
+
+/**
+ * @brief Start time of a span
+ *
+ * @return 0 if not recording
+ */
+__APICALL uint64_t spanBegin();
+
+__APICALL void spanEnd(char const* category, char const* name, uint64_t begin);
+
+/**
+ * @brief Value of a counter track
+ *
+ */
+__APICALL void counter(char const* name, int64_t value);
+
+/**
+ * @brief Arrow from the current span to the span that calls flowEnd() with the same id
+ *
+ */
+__APICALL void flowBegin(char const* name, uint64_t id);
+__APICALL void flowEnd(char const* name, uint64_t id);
+
+/**
+ * @brief Name of the calling thread in the trace
+ *
+ */
+__APICALL void setThreadName(char const* name);
+
+class Span {
+  CLASS_NO_COPY(Span);
+
+  char const* m_category;
+  char const* m_name;
+  uint64_t    m_begin;
+
+  public:
+  Span(char const* category, char const* name): m_category(category), m_name(name), m_begin(spanBegin()) {}
+
+  ~Span() {
+    if (m_begin != 0) spanEnd(m_category, m_name, m_begin);
+  }
+};
+} // namespace trace
+
+#define __TRACE_CONCAT_(a, b) a##b
+#define __TRACE_CONCAT(a, b)  __TRACE_CONCAT_(a, b)
+
+/**
+ * @brief Span until the end of the scope
+ *
+ */
+#define TRACE_SPAN(category, name) [[maybe_unused]] trace::Span const __TRACE_CONCAT(__traceSpan, __LINE__)(category, name)
+
+#undef __APICALL
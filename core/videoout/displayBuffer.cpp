@@ -0,0 +1,80 @@
+#include "displayBuffer.h"
+
+#include "core/detile/detile.h"
+#include "modules/libSceVideoOut/types.h"
+
+namespace {
+constexpr uint32_t TILE_PITCH_ALIGN    = 128; // pixels
+constexpr uint32_t TILE_ROWS_ALIGN     = 64;
+constexpr uint32_t TILE_ROWS_ALIGN_NEO = 128;
+constexpr uint32_t TILE_ADDR_ALIGN     = 32 * 1024;
+constexpr uint32_t TILE_ADDR_ALIGN_NEO = 64 * 1024;
+constexpr uint32_t LINEAR_ADDR_ALIGN   = 256;
+
+constexpr uint32_t alignUp(uint32_t value, uint32_t align) {
+  return (value + align - 1) / align * align;
+}
+} // namespace
+
+uint32_t getBytesPerPixel(uint32_t pixelFormat) {
+  switch ((SceVideoOutPixelFormat)pixelFormat) {
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A8R8G8B8_SRGB:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A8B8G8R8_SRGB:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10_SRGB:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10_BT2020_PQ: return 4;
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A16R16G16B16_FLOAT: return 8;
+  }
+  return 0;
+}
+
+DisplayBufferLayout getDisplayBufferLayout(SceVideoOutBufferAttribute const& attribute, bool neo) {
+  DisplayBufferLayout layout {.bytesPerPixel = getBytesPerPixel((uint32_t)attribute.pixelFormat)};
+  if (layout.bytesPerPixel == 0) return layout;
+
+  if (attribute.tilingMode == (int32_t)SceVideoOutTilingMode::TILE) {
+    // Whole macro tiles, 1080p: 1920x1088 (neo 1920x1152)
+    layout.pitch     = alignUp(attribute.pitchInPixel, TILE_PITCH_ALIGN);
+    layout.rows      = alignUp(attribute.height, neo ? TILE_ROWS_ALIGN_NEO : TILE_ROWS_ALIGN);
+    layout.alignment = neo ? TILE_ADDR_ALIGN_NEO : TILE_ADDR_ALIGN;
+  } else {
+    layout.pitch     = attribute.pitchInPixel;
+    layout.rows      = attribute.height;
+    layout.alignment = LINEAR_ADDR_ALIGN;
+  }
+
+  layout.size = (uint64_t)layout.pitch * layout.rows * layout.bytesPerPixel;
+  return layout;
+}
+
+bool getDisplayBufferSurface(SceVideoOutBufferAttribute const& attribute, bool neo, detile::Surface& surface) {
+  auto const layout = getDisplayBufferLayout(attribute, neo);
+  if (layout.size == 0) return false;
+
+  surface.bitsPerElement = layout.bytesPerPixel * 8;
+  surface.width          = attribute.width;
+  surface.height         = attribute.height;
+  surface.pitch          = layout.pitch;
+  surface.paddedHeight   = layout.rows;
+
+  bool const tiled = attribute.tilingMode == (int32_t)SceVideoOutTilingMode::TILE;
+  return detile::getTileMode(tiled ? detile::TILE_MODE_DISPLAY_2D_THIN : detile::TILE_MODE_DISPLAY_LINEAR_ALIGNED, surface.bitsPerElement, neo, surface.mode);
+}
+
+OutputScaling getOutputScaling(std::string_view name) {
+  if (name == "stretch") return OutputScaling::stretch;
+  return OutputScaling::fit;
+}
+
+OutputRect getOutputRect(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight, OutputScaling scaling) {
+  if (scaling == OutputScaling::stretch || srcWidth == 0 || srcHeight == 0) return {0, 0, dstWidth, dstHeight};
+
+  // Largest size with the aspect of src, centered
+  uint64_t const scaledWidth = (uint64_t)dstHeight * srcWidth / srcHeight;
+  if (scaledWidth <= dstWidth) {
+    return {(int32_t)(dstWidth - scaledWidth) / 2, 0, (uint32_t)scaledWidth, dstHeight};
+  }
+
+  uint64_t const scaledHeight = (uint64_t)dstWidth * srcHeight / srcWidth;
+  return {0, (int32_t)(dstHeight - scaledHeight) / 2, dstWidth, (uint32_t)scaledHeight};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+
+struct SceVideoOutBufferAttribute;
+
+namespace detile {
+struct Surface;
+}
+
+/**
+ * @brief Memory layout of a display buffer
+ *
+ */
+struct DisplayBufferLayout {
+  uint32_t bytesPerPixel = 0; // 0: pixel format not supported
+  uint32_t pitch         = 0; // pixels per row in memory, tiled: padded to whole tiles
+  uint32_t rows          = 0; // rows in memory, tiled: padded to whole tiles
+  uint64_t size          = 0; // bytes
+  uint32_t alignment     = 0; // of the start address
+};
+
+/**
+ * @brief Size of a pixel of a SceVideoOutPixelFormat
+ *
+ * @return 0 if not supported
+ */
+uint32_t getBytesPerPixel(uint32_t pixelFormat);
+
+/**
+ * @brief Computed layout for any size, pixel format and tiling mode
+ *
+ * @param neo Pro console: tiled buffers use a larger tile alignment
+ * @return size 0 if the pixel format is not supported
+ */
+DisplayBufferLayout getDisplayBufferLayout(SceVideoOutBufferAttribute const& attribute, bool neo);
+
+/**
+ * @brief The display buffer as a detile surface (display 2d thin when tiled)
+ *
+ * @return false if the pixel format is not supported
+ */
+bool getDisplayBufferSurface(SceVideoOutBufferAttribute const& attribute, bool neo, detile::Surface& surface);
+
+enum class OutputScaling {
+  fit,     ///< keeps the aspect ratio, black bars
+  stretch, ///< fills the output
+};
+
+/**
+ * @brief fit or stretch, anything else is fit
+ *
+ */
+OutputScaling getOutputScaling(std::string_view name);
+
+struct OutputRect {
+  int32_t  x      = 0;
+  int32_t  y      = 0;
+  uint32_t width  = 0;
+  uint32_t height = 0;
+};
+
+/**
+ * @brief Where a display buffer is shown in the output (window, swapchain or frame dump)
+ *
+ */
+OutputRect getOutputRect(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight, OutputScaling scaling);
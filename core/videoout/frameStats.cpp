@@ -0,0 +1,64 @@
+#include "frameStats.h"
+
+namespace {
+void updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+  auto prev = max.load(std::memory_order_relaxed);
+  while (prev < value && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+  }
+}
+} // namespace
+
+void FrameStats::onSubmit(bool accepted) {
+  (accepted ? m_numSubmits : m_numRejected).fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameStats::onFlip(uint64_t frameNs, uint64_t latencyNs, uint64_t missedVblanks) {
+  m_numFlips.fetch_add(1, std::memory_order_relaxed);
+  m_latencyNs.fetch_add(latencyNs, std::memory_order_relaxed);
+  updateMax(m_maxLatencyNs, latencyNs);
+
+  if (frameNs > 0) {
+    m_numFrames.fetch_add(1, std::memory_order_relaxed);
+    m_frameNs.fetch_add(frameNs, std::memory_order_relaxed);
+    updateMax(m_maxFrameNs, frameNs);
+  }
+  if (missedVblanks > 0) m_vblankMisses.fetch_add(missedVblanks, std::memory_order_relaxed);
+}
+
+VideoOutStats FrameStats::publish(std::chrono::steady_clock::time_point now, double hleCallsPerS) {
+  Totals const cur {
+      .numSubmits   = m_numSubmits.load(std::memory_order_relaxed),
+      .numFlips     = m_numFlips.load(std::memory_order_relaxed),
+      .numFrames    = m_numFrames.load(std::memory_order_relaxed),
+      .vblankMisses = m_vblankMisses.load(std::memory_order_relaxed),
+      .frameNs      = m_frameNs.load(std::memory_order_relaxed),
+      .latencyNs    = m_latencyNs.load(std::memory_order_relaxed),
+  };
+
+  auto const intervalS = std::chrono::duration<double>(now - m_lastTime).count();
+  auto const perS      = [=](uint64_t value, uint64_t last) { return intervalS > 0.0 ? (double)(value - last) / intervalS : 0.0; };
+  auto const avgMs     = [](uint64_t ns, uint64_t count) { return count > 0 ? 1e-6 * (double)ns / (double)count : 0.0; };
+
+  VideoOutStats const stats {
+      .numFlips         = cur.numFlips,
+      .numSubmits       = cur.numSubmits,
+      .numRejected      = m_numRejected.load(std::memory_order_relaxed),
+      .vblankMisses     = cur.vblankMisses,
+      .intervalS        = intervalS,
+      .fps              = perS(cur.numFlips, m_last.numFlips),
+      .frameMs          = avgMs(cur.frameNs - m_last.frameNs, cur.numFrames - m_last.numFrames),
+      .maxFrameMs       = 1e-6 * (double)m_maxFrameNs.exchange(0, std::memory_order_relaxed),
+      .latencyMs        = avgMs(cur.latencyNs - m_last.latencyNs, cur.numFlips - m_last.numFlips),
+      .maxLatencyMs     = 1e-6 * (double)m_maxLatencyNs.exchange(0, std::memory_order_relaxed),
+      .submitsPerS      = perS(cur.numSubmits, m_last.numSubmits),
+      .vblankMissesPerS = perS(cur.vblankMisses, m_last.vblankMisses),
+      .hleCallsPerS     = hleCallsPerS,
+  };
+
+  m_last     = cur;
+  m_lastTime = now;
+
+  std::unique_lock const lock(m_mutex);
+  m_stats = stats;
+  return stats;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "videoout.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+
+/**
+ * @brief Flip statistics of a window. Recording is lock-free (submitting threads, VideoOut thread),
+ * publish() aggregates the interval since its last call into VideoOutStats.
+ *
+ */
+class FrameStats {
+  CLASS_NO_COPY(FrameStats);
+  CLASS_NO_MOVE(FrameStats);
+
+  std::atomic<uint64_t> m_numSubmits   = 0;
+  std::atomic<uint64_t> m_numRejected  = 0;
+  std::atomic<uint64_t> m_numFlips     = 0;
+  std::atomic<uint64_t> m_numFrames    = 0; // flips with a frame time
+  std::atomic<uint64_t> m_vblankMisses = 0;
+  std::atomic<uint64_t> m_frameNs      = 0;
+  std::atomic<uint64_t> m_latencyNs    = 0;
+  std::atomic<uint64_t> m_maxFrameNs   = 0; // since the last publish()
+  std::atomic<uint64_t> m_maxLatencyNs = 0;
+
+  struct Totals {
+    uint64_t numSubmits   = 0;
+    uint64_t numFlips     = 0;
+    uint64_t numFrames    = 0;
+    uint64_t vblankMisses = 0;
+    uint64_t frameNs      = 0;
+    uint64_t latencyNs    = 0;
+  };
+
+  // publish()
+  Totals                                m_last;
+  std::chrono::steady_clock::time_point m_lastTime = std::chrono::steady_clock::now();
+  // -
+
+  mutable std::mutex m_mutex;
+  VideoOutStats      m_stats;
+
+  public:
+  FrameStats() = default;
+
+  void onSubmit(bool accepted);
+
+  /**
+   * @param frameNs time since the previous flip, 0: first flip
+   * @param latencyNs submit to shown
+   * @param missedVblanks vsync flips: vblanks after the one it was due
+   */
+  void onFlip(uint64_t frameNs, uint64_t latencyNs, uint64_t missedVblanks);
+
+  /**
+   * @brief Called at a fixed rate by the VideoOut thread
+   *
+   * @param hleCallsPerS process wide, copied as is
+   */
+  VideoOutStats publish(std::chrono::steady_clock::time_point now, double hleCallsPerS);
+
+  VideoOutStats get() const {
+    std::unique_lock const lock(m_mutex);
+    return m_stats;
+  }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "utility/utility.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bounded lock-free queue for many producers and one consumer. Every cell carries a sequence number,
+ * a producer claims a cell with one CAS on the tail and never waits for other producers or the consumer.
+ *
+ */
+template <typename T>
+class MpscQueue {
+  CLASS_NO_COPY(MpscQueue);
+  CLASS_NO_MOVE(MpscQueue);
+
+  struct Cell {
+    std::atomic<size_t> seq; // == pos: free for the producer of pos, == pos + 1: filled for the consumer
+    T                   value {};
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t                  m_mask = 0;
+
+  alignas(64) std::atomic<size_t> m_tail = 0; // producers
+  alignas(64) size_t m_head              = 0; // consumer
+
+  public:
+  /**
+   * @param capacity rounded up to a power of two
+   */
+  explicit MpscQueue(size_t capacity) {
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 2));
+    m_cells  = std::make_unique<Cell[]>(capacity);
+    m_mask   = capacity - 1;
+    for (size_t n = 0; n < capacity; ++n) {
+      m_cells[n].seq.store(n, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Any thread
+   *
+   * @return false: full
+   */
+  bool push(T const& value) {
+    auto pos = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+      auto&      cell = m_cells[pos & m_mask];
+      auto const diff = (intptr_t)cell.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // not consumed yet
+      } else {
+        pos = m_tail.load(std::memory_order_relaxed); // claimed by another producer
+      }
+    }
+  }
+
+  /**
+   * @brief Consumer thread only
+   *
+   * @return false: empty, or the next producer hasn't finished its push yet
+   */
+  bool pop(T& value) {
+    auto& cell = m_cells[m_head & m_mask];
+    if (cell.seq.load(std::memory_order_acquire) != m_head + 1) return false;
+
+    value = std::move(cell.value);
+    cell.seq.store(m_head + m_mask + 1, std::memory_order_release);
+    ++m_head;
+    return true;
+  }
+};
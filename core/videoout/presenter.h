@@ -0,0 +1,119 @@
+#pragma once
+
+#include "core/imports/exports/graphics.h"
+#include "displayBuffer.h"
+#include "utility/utility.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace vulkan {
+struct VulkanObj;
+}
+
+struct SceVideoOutBufferAttribute;
+struct ScreenShotFrame;
+
+size_t constexpr WindowsMAX = 2;
+
+/**
+ * @brief Output side of VideoOut: windows, transfer of the display buffers and presentation.
+ * Flip and vblank state and their events stay in VideoOut, every backend gets the same flip semantics.
+ *
+ */
+class IPresenter {
+  CLASS_NO_COPY(IPresenter);
+  CLASS_NO_MOVE(IPresenter);
+
+  protected:
+  IPresenter() = default;
+
+  public:
+  virtual ~IPresenter() = default;
+
+  /**
+   * @brief Creates the output of a window. Called from the VideoOut thread
+   *
+   * @param index window index
+   * @return {width, height} of the output
+   */
+  virtual std::pair<uint32_t, uint32_t> open(int index, std::string const& title, uint32_t width, uint32_t height) = 0;
+
+  /**
+   * @brief Destroys the output of a window. Called from the VideoOut thread
+   *
+   * @param index window index
+   */
+  virtual void close(int index) = 0;
+
+  /**
+   * @brief Creates the graphics backend, after the first open()
+   *
+   * @param listener receives the flips of submitted command buffers
+   * @return std::unique_ptr<IGraphics>
+   */
+  virtual std::unique_ptr<IGraphics> createGraphics(IEventsGraphics& listener) = 0;
+
+  /**
+   * @brief Adds a set of display buffers
+   *
+   * @param index window index
+   * @param setIndex
+   * @return index of the buffer shown first, -1 on error
+   */
+  virtual int registerBuffers(int index, int setIndex, void* const* addresses, int numBuffers, SceVideoOutBufferAttribute const& attribute) = 0;
+
+  /**
+   * @brief Copies a display buffer to the output and shows it. Called from the VideoOut thread
+   *
+   * @param index window index
+   * @param waitSema waits for waitValue before the copy, nullptr: no wait
+   */
+  virtual void present(int index, int setIndex, int bufferIndex, VkSemaphore waitSema, size_t waitValue) = 0;
+
+  /**
+   * @brief Copies the display buffer of the last present() into frame (attribute, layout and data). Called from the VideoOut thread
+   *
+   * @param index window index
+   * @return false if not supported or the buffer is unknown
+   */
+  virtual bool capture(int index, int setIndex, int bufferIndex, ScreenShotFrame& frame) = 0;
+
+  /**
+   * @brief false if capture() always fails
+   *
+   */
+  virtual bool canCapture() const = 0;
+
+  virtual void setTitle(int index, std::string const& title) = 0;
+
+  /**
+   * @brief Handles the window system messages. Called from the VideoOut thread
+   *
+   */
+  virtual void pollEvents() = 0;
+
+  /**
+   * @brief Access the vulkan objects
+   *
+   * @return nullptr without a device
+   */
+  virtual vulkan::VulkanObj* getVulkan() = 0;
+};
+
+/**
+ * @brief GLFW window and vulkan swapchain
+ *
+ * @param scaling of the display buffers to the window
+ */
+std::unique_ptr<IPresenter> createVulkanPresenter(OutputScaling scaling);
+
+/**
+ * @brief No window and no device, command buffers are dropped (only their end of pipe writes and events are done)
+ *
+ * @param dumpDir writes every dumpEvery-th flip as .bmp in the output size, empty: no dumps
+ * @param dumpEvery
+ * @param scaling of the display buffers in the dumps
+ */
+std::unique_ptr<IPresenter> createNullPresenter(std::string const& dumpDir, uint32_t dumpEvery, OutputScaling scaling);
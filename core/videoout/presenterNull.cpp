@@ -0,0 +1,299 @@
+#include "core/detile/detile.h"
+#include "core/imports/exports/pm4_parser.h"
+#include "core/kernel/eventqueue.h"
+#include "core/timer/timer.h"
+#include "logging.h"
+#include "modules/libSceVideoOut/types.h"
+#include "presenter.h"
+#include "screenShot.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <list>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+LOG_DEFINE_MODULE(Presenter);
+
+namespace {
+constexpr uint32_t OP_EVENT_WRITE_EOP = 0x47;
+constexpr uint32_t OP_RELEASE_MEM     = 0x49;
+
+#pragma pack(push, 1)
+
+struct BmpHeader {
+  uint16_t type      = 0x4d42; // "BM"
+  uint32_t fileSize  = 0;
+  uint32_t reserved  = 0;
+  uint32_t offBits   = 54;
+  uint32_t infoSize  = 40;
+  int32_t  width     = 0;
+  int32_t  height    = 0; // negative: top-down
+  uint16_t planes    = 1;
+  uint16_t bitCount  = 32;
+  uint32_t compress  = 0;
+  uint32_t imageSize = 0;
+  uint32_t ppmX      = 0;
+  uint32_t ppmY      = 0;
+  uint32_t clrUsed   = 0;
+  uint32_t clrImport = 0;
+};
+
+#pragma pack(pop)
+
+/**
+ * @brief Drops the command buffers. End of pipe writes and interrupts are done on submit, flips are forwarded to VideoOut.
+ *
+ */
+class NullGraphics: public IGraphics {
+  IEventsGraphics& m_listener;
+
+  std::mutex              m_mutex;
+  std::condition_variable m_condDone;
+  uint32_t                m_numPending = 0;
+
+  std::list<Kernel::EventQueue::IKernelEqueue_t> m_eventsEop;
+
+  void endOfPipe(uint32_t addrLo, uint32_t addrHi, uint32_t dataSel, uint32_t intSel, uint32_t dataLo, uint32_t dataHi);
+
+  public:
+  NullGraphics(IEventsGraphics& listener): m_listener(listener) {}
+
+  virtual ~NullGraphics() = default;
+
+  int addEvent(Kernel::EventQueue::KernelEqueueEvent& event, Kernel::EventQueue::IKernelEqueue_t eq) final {
+    int const result = eq->addEvent(event);
+    if (event.event.ident == (int)GRAPHICS_EVENTS::EOP) {
+      std::unique_lock const lock(m_mutex);
+      m_eventsEop.push_back(eq);
+    }
+    return result;
+  }
+
+  void removeEvent(Kernel::EventQueue::IKernelEqueue_t eq, int const ident) final {
+    if (ident != (int)GRAPHICS_EVENTS::EOP) return;
+    std::unique_lock const lock(m_mutex);
+    m_eventsEop.remove(eq);
+  }
+
+  void registerCommandBuffer(void* cmdBufferClass) final {}
+
+  void submitCmdBuffer(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawDw[], uint32_t const* constBuffers[], uint32_t const numConstDw[],
+                       int const handle, int const index, int const flipMode, int64_t const flipArg, bool flip) final;
+
+  void waitSubmitDone() final {
+    std::unique_lock lock(m_mutex);
+    m_condDone.wait(lock, [this] { return m_numPending == 0; });
+  }
+
+  void submited() final {
+    std::unique_lock const lock(m_mutex);
+    ++m_numPending;
+  }
+
+  void submitDone() final {
+    std::unique_lock lock(m_mutex);
+    if (m_numPending > 0) --m_numPending;
+    if (m_numPending == 0) {
+      lock.unlock();
+      m_condDone.notify_all();
+    }
+  }
+
+  bool isRunning() const final { return true; }
+};
+
+void NullGraphics::endOfPipe(uint32_t addrLo, uint32_t addrHi, uint32_t dataSel, uint32_t intSel, uint32_t dataLo, uint32_t dataHi) {
+  auto const addr = ((uint64_t)(addrHi & 0xffffu) << 32u) | (addrLo & ~3u);
+  if (addr != 0) {
+    switch (dataSel) {
+      case 1: *(uint32_t*)addr = dataLo; break;
+      case 2: *(uint64_t*)addr = ((uint64_t)dataHi << 32u) | dataLo; break;
+      case 3:
+      case 4: *(uint64_t*)addr = accessTimer().queryPerformance(); break;
+      default: break;
+    }
+  }
+
+  if (intSel != 0) {
+    std::unique_lock const lock(m_mutex);
+    for (auto& eq: m_eventsEop) {
+      (void)eq->triggerEvent((uintptr_t)GRAPHICS_EVENTS::EOP, Kernel::EventQueue::KERNEL_EVFILT_GRAPHICS, nullptr);
+    }
+  }
+}
+
+void NullGraphics::submitCmdBuffer(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawDw[], uint32_t const* constBuffers[],
+                                   uint32_t const numConstDw[], int const handle, int const index, int const flipMode, int64_t const flipArg, bool flip) {
+  for (uint32_t n = 0; n < count && drawBuffers != nullptr; ++n) {
+    Pm4::parse(drawBuffers[n], numDrawDw[n] / sizeof(uint32_t), [this](Pm4::Packet const& packet) {
+      if (packet.type != Pm4::PacketType::Type3) return true;
+
+      auto const d = packet.data;
+      if (packet.op == OP_EVENT_WRITE_EOP && packet.len >= 6) {
+        endOfPipe(d[2], d[3], d[3] >> 29u, (d[3] >> 24u) & 3u, d[4], d[5]);
+      } else if (packet.op == OP_RELEASE_MEM && packet.len >= 7) {
+        endOfPipe(d[3], d[4], d[2] >> 29u, (d[2] >> 24u) & 7u, d[5], d[6]);
+      }
+      return true;
+    });
+  }
+
+  if (flip) m_listener.eventDoFlip(handle, index, flipArg, nullptr, 0);
+}
+
+class NullPresenter: public IPresenter {
+  struct BufferSet {
+    std::vector<uint64_t>      addresses;
+    SceVideoOutBufferAttribute attribute;
+    DisplayBufferLayout        layout;
+  };
+
+  struct Window {
+    std::array<BufferSet, 16> bufferSets;
+    uint64_t                  numPresents = 0;
+
+    uint32_t width = 0, height = 0; // output, the dumps are scaled to it
+  };
+
+  std::array<Window, WindowsMAX> m_windows;
+
+  std::filesystem::path m_dumpDir;
+  uint32_t              m_dumpEvery;
+  OutputScaling         m_scaling;
+  std::vector<uint8_t>  m_detiled; // linear copy of a tiled display buffer
+
+  void dump(int index, BufferSet const& bufferSet, int bufferIndex);
+
+  public:
+  NullPresenter(std::string const& dumpDir, uint32_t dumpEvery, OutputScaling scaling)
+      : m_dumpDir(dumpDir), m_dumpEvery(std::max(dumpEvery, 1u)), m_scaling(scaling) {
+    if (!m_dumpDir.empty()) std::filesystem::create_directories(m_dumpDir);
+  }
+
+  virtual ~NullPresenter() = default;
+
+  std::pair<uint32_t, uint32_t> open(int index, std::string const& title, uint32_t width, uint32_t height) final {
+    m_windows[index].width  = width;
+    m_windows[index].height = height;
+    return {width, height};
+  }
+
+  void close(int index) final { m_windows[index] = {}; }
+
+  std::unique_ptr<IGraphics> createGraphics(IEventsGraphics& listener) final { return std::make_unique<NullGraphics>(listener); }
+
+  int registerBuffers(int index, int setIndex, void* const* addresses, int numBuffers, SceVideoOutBufferAttribute const& attribute) final {
+    LOG_USE_MODULE(Presenter);
+
+    auto& bufferSet     = m_windows[index].bufferSets[setIndex];
+    bufferSet.attribute = attribute;
+    bufferSet.layout    = getDisplayBufferLayout(attribute, false);
+    bufferSet.addresses.assign((uint64_t const*)addresses, (uint64_t const*)addresses + numBuffers);
+
+    LOG_INFO(L"+bufferset[%d] %ux%u pitch:%u format:0x%08x size:%llu align:%u", setIndex, attribute.width, attribute.height, bufferSet.layout.pitch,
+             attribute.pixelFormat, bufferSet.layout.size, bufferSet.layout.alignment);
+    return 0;
+  }
+
+  void present(int index, int setIndex, int bufferIndex, VkSemaphore waitSema, size_t waitValue) final {
+    auto& window = m_windows[index];
+    if (!m_dumpDir.empty() && window.numPresents % m_dumpEvery == 0) dump(index, window.bufferSets[setIndex], bufferIndex);
+
+    ++window.numPresents;
+  }
+
+  bool capture(int index, int setIndex, int bufferIndex, ScreenShotFrame& frame) final {
+    auto const& bufferSet = m_windows[index].bufferSets[setIndex];
+    if (bufferIndex >= bufferSet.addresses.size() || bufferSet.layout.size == 0) return false;
+
+    auto const src  = (uint8_t const*)bufferSet.addresses[bufferIndex];
+    frame.attribute = bufferSet.attribute;
+    frame.layout    = bufferSet.layout;
+    frame.data.assign(src, src + bufferSet.layout.size);
+    return true;
+  }
+
+  bool canCapture() const final { return true; }
+
+  void setTitle(int index, std::string const& title) final {}
+
+  void pollEvents() final {}
+
+  vulkan::VulkanObj* getVulkan() final { return nullptr; }
+};
+
+void NullPresenter::dump(int index, BufferSet const& bufferSet, int bufferIndex) {
+  LOG_USE_MODULE(Presenter);
+
+  auto const& attr = bufferSet.attribute;
+  if (bufferIndex >= bufferSet.addresses.size()) return;
+
+  bool const swapRB = attr.pixelFormat == SceVideoOutPixelFormat::PIXEL_FORMAT_A8B8G8R8_SRGB;
+  if (!swapRB && attr.pixelFormat != SceVideoOutPixelFormat::PIXEL_FORMAT_A8R8G8B8_SRGB) {
+    static bool warned = false;
+    if (!warned) LOG_WARN(L"frame dump: pixel format 0x%08x not supported", attr.pixelFormat);
+    warned = true;
+    return;
+  }
+
+  auto           src      = (uint8_t const*)bufferSet.addresses[bufferIndex];
+  uint64_t const srcPitch = (uint64_t)bufferSet.layout.pitch * bufferSet.layout.bytesPerPixel;
+  if (attr.tilingMode == (int32_t)SceVideoOutTilingMode::TILE) {
+    m_detiled.resize(bufferSet.layout.size);
+
+    detile::Surface surface;
+    if (!getDisplayBufferSurface(attr, false, surface) || !detile::detileSurface(surface, src, 0, m_detiled.data(), srcPitch)) {
+      static bool warned = false;
+      if (!warned) LOG_WARN(L"frame dump: couldn't detile %ux%u pitch:%u", attr.width, attr.height, bufferSet.layout.pitch);
+      warned = true;
+      return;
+    }
+    src = m_detiled.data();
+  }
+
+  auto const path = m_dumpDir / std::format("frame_{}_{:06}.bmp", index, m_windows[index].numPresents);
+  auto       file = fopen(path.string().c_str(), "wb");
+  if (file == nullptr) {
+    LOG_ERR(L"frame dump: couldn't create %S", path.string().c_str());
+    return;
+  }
+
+  auto const& window  = m_windows[index];
+  auto const  rect    = getOutputRect(attr.width, attr.height, window.width, window.height, m_scaling);
+  auto const  rowSize = window.width * sizeof(uint32_t);
+
+  BmpHeader header;
+  header.width     = (int32_t)window.width;
+  header.height    = -(int32_t)window.height;
+  header.imageSize = rowSize * window.height;
+  header.fileSize  = header.offBits + header.imageSize;
+  fwrite(&header, sizeof(header), 1, file);
+
+  // Nearest pixel, the same rect as the swapchain blit
+  std::vector<uint32_t> row(window.width);
+  for (uint32_t y = 0; y < window.height; ++y) {
+    std::fill(row.begin(), row.end(), 0);
+
+    int64_t const ry = (int64_t)y - rect.y;
+    if (ry >= 0 && ry < rect.height) {
+      auto const srcRow = (uint32_t const*)(src + (uint64_t)ry * attr.height / rect.height * srcPitch);
+      for (uint32_t x = 0; x < rect.width; ++x) {
+        auto pixel = srcRow[(uint64_t)x * attr.width / rect.width];
+        if (swapRB) pixel = (pixel & 0xff00ff00u) | ((pixel & 0xffu) << 16u) | ((pixel >> 16u) & 0xffu);
+        row[rect.x + x] = pixel;
+      }
+    }
+    fwrite(row.data(), rowSize, 1, file);
+  }
+  fclose(file);
+}
+} // namespace
+
+std::unique_ptr<IPresenter> createNullPresenter(std::string const& dumpDir, uint32_t dumpEvery, OutputScaling scaling) {
+  return std::make_unique<NullPresenter>(dumpDir, dumpEvery, scaling);
+}
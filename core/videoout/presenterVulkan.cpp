@@ -0,0 +1,229 @@
+#include "core/imports/exports/gpuMemory_types.h"
+#include "core/imports/imports_func.h"
+#include "core/initParams/initParams.h"
+#include "logging.h"
+#include "modules/libSceVideoOut/types.h"
+#include "presenter.h"
+#include "vulkan/vulkanHelper.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optick.h>
+
+LOG_DEFINE_MODULE(Presenter);
+
+namespace {
+void cbWindow_close(GLFWwindow* window) {
+  // glfwDestroyWindow(window.window);
+  // Todo submit close event, cleanup
+  // m_stop = true;
+  // lock.unlock();
+  // m_condGlfw.notify_one();
+  // m_threadGlfw.join();
+  // // accessGraphics().stop();
+  // m_graphics.reset();
+  // deinitVulkan(m_vulkanObj);
+
+  exit(0); // just hard exit for now.
+           // todo clean shutdown (file syncs etc.)
+}
+
+VkPresentModeKHR getRequestedPresentMode() {
+  LOG_USE_MODULE(Presenter);
+
+  auto const name = accessInitParams()->getPresentMode();
+  if (name.empty()) return accessInitParams()->useVSYNC() ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+  if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+  if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+  if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+  LOG_ERR(L"unknown presentMode %S, using fifo", name.c_str());
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+class VulkanPresenter: public IPresenter {
+  struct Window {
+    GLFWwindow*  window  = nullptr;
+    VkSurfaceKHR surface = nullptr;
+
+    std::array<vulkan::SwapchainData, 16>          bufferSets;
+    std::array<std::weak_ptr<IGpuImageObject>, 16> displayBuffers;
+  };
+
+  std::array<Window, WindowsMAX> m_windows;
+
+  vulkan::VulkanObj* m_vulkanObj   = nullptr;
+  VkPresentModeKHR   m_presentMode = VK_PRESENT_MODE_FIFO_KHR; // requested, the surface may not support it
+  OutputScaling      m_scaling;
+
+  bool transfer(Window& window, vulkan::SwapchainData& swapchain, int bufferIndex, VkSemaphore waitSema, size_t waitValue);
+
+  static void cbWindow_resize(GLFWwindow* glfwWindow, int width, int height) {
+    auto& window = *(Window*)glfwGetWindowUserPointer(glfwWindow);
+    for (auto& bufferSet: window.bufferSets) {
+      if (bufferSet.swapchain != nullptr) bufferSet.outOfDate = true;
+    }
+  }
+
+  public:
+  VulkanPresenter(OutputScaling scaling): m_presentMode(getRequestedPresentMode()), m_scaling(scaling) {
+    LOG_USE_MODULE(Presenter);
+    LOG_DEBUG(L"Init glfw");
+    glfwInit();
+  }
+
+  virtual ~VulkanPresenter() { glfwTerminate(); }
+
+  std::pair<uint32_t, uint32_t> open(int index, std::string const& title, uint32_t width, uint32_t height) final;
+  void                          close(int index) final;
+
+  std::unique_ptr<IGraphics> createGraphics(IEventsGraphics& listener) final {
+    auto& info = m_vulkanObj->deviceInfo;
+    return ::createGraphics(listener, info.device, info.physicalDevice, info.instance);
+  }
+
+  int  registerBuffers(int index, int setIndex, void* const* addresses, int numBuffers, SceVideoOutBufferAttribute const& attribute) final;
+  void present(int index, int setIndex, int bufferIndex, VkSemaphore waitSema, size_t waitValue) final;
+
+  // The display buffers are gpu images, their guest memory isn't written. Needs a readback of the display image
+  bool capture(int index, int setIndex, int bufferIndex, ScreenShotFrame& frame) final { return false; }
+
+  bool canCapture() const final { return false; }
+
+  void setTitle(int index, std::string const& title) final { glfwSetWindowTitle(m_windows[index].window, title.c_str()); }
+
+  void pollEvents() final { glfwPollEvents(); }
+
+  vulkan::VulkanObj* getVulkan() final { return m_vulkanObj; }
+};
+
+std::pair<uint32_t, uint32_t> VulkanPresenter::open(int index, std::string const& title, uint32_t width, uint32_t height) {
+  auto& window = m_windows[index];
+
+  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  window.window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+
+  glfwMakeContextCurrent(window.window);
+  glfwShowWindow(window.window);
+
+  int paneWidth = 0, paneHeight = 0;
+  glfwGetWindowSize(window.window, &paneWidth, &paneHeight);
+
+  if (m_vulkanObj == nullptr) {
+    m_vulkanObj = vulkan::initVulkan(window.window, window.surface, accessInitParams()->enableValidation());
+  } else {
+    vulkan::createSurface(m_vulkanObj, window.window, window.surface);
+  }
+
+  glfwSetWindowUserPointer(window.window, &window);
+  glfwSetWindowCloseCallback(window.window, cbWindow_close);
+  glfwSetFramebufferSizeCallback(window.window, cbWindow_resize);
+  return {paneWidth, paneHeight};
+}
+
+void VulkanPresenter::close(int index) {
+  glfwDestroyWindow(m_windows[index].window);
+}
+
+int VulkanPresenter::registerBuffers(int index, int setIndex, void* const* addresses, int numBuffers, SceVideoOutBufferAttribute const& attribute) {
+  LOG_USE_MODULE(Presenter);
+
+  auto& window    = m_windows[index];
+  auto& bufferSet = window.bufferSets[setIndex];
+  bufferSet.buffers.resize(numBuffers);
+
+  // Addresses may map to other images now
+  window.displayBuffers.fill({});
+  vulkan::invalidateTransfers(bufferSet);
+
+  auto const layout = getDisplayBufferLayout(attribute, false);
+  if (layout.size == 0) LOG_WARN(L"bufferset[%d] pixel format 0x%08x not supported", setIndex, attribute.pixelFormat);
+
+  for (size_t n = 0; n < numBuffers; ++n) {
+    bufferSet.buffers[n].bufferVaddr = (uintptr_t)addresses[n];
+    bufferSet.buffers[n].bufferSize  = layout.size;
+    bufferSet.buffers[n].bufferAlign = layout.alignment;
+    LOG_INFO(L"+bufferset[%d] buffer:%d vaddr:0x%08llx", setIndex, n, (uint64_t)addresses[n]);
+
+    auto [format, colorSpace] = vulkan::getDisplayFormat(m_vulkanObj);
+    if (!registerDisplayBuffer(bufferSet.buffers[n].bufferVaddr, VkExtent2D {.width = attribute.width, .height = attribute.height}, attribute.pitchInPixel,
+                               format))
+      return -1;
+  }
+
+  vulkan::createData(m_vulkanObj, window.surface, bufferSet, attribute.width, attribute.height, vulkan::getPresentMode(m_vulkanObj, m_presentMode));
+  return 0;
+}
+
+bool VulkanPresenter::transfer(Window& window, vulkan::SwapchainData& swapchain, int bufferIndex, VkSemaphore waitSema, size_t waitValue) {
+  LOG_USE_MODULE(Presenter);
+
+  auto& displayBufferMeta = swapchain.buffers[bufferIndex];
+
+  auto image = window.displayBuffers[bufferIndex].lock();
+  if (!image) {
+    image = getDisplayBuffer(displayBufferMeta.bufferVaddr);
+    if (!image) {
+      LOG_ERR(L"No Display for 0x%08llx:%u", displayBufferMeta.bufferVaddr, displayBufferMeta.bufferSize);
+      return false;
+    }
+    window.displayBuffers[bufferIndex] = image;
+  }
+
+  auto const     rect = getOutputRect(image->getExtent().width, image->getExtent().height, swapchain.extent2d.width, swapchain.extent2d.height, m_scaling);
+  VkRect2D const dstRect {.offset = {rect.x, rect.y}, .extent = {rect.width, rect.height}};
+
+  auto const cmdBuffer = vulkan::transfer2Display(m_vulkanObj, swapchain, image->getImage(), image.get(), (uint32_t)bufferIndex, swapchain.acquiredImage,
+                                                  dstRect);
+  if (cmdBuffer == nullptr) return false;
+
+  vulkan::submitDisplayTransfer(cmdBuffer, m_vulkanObj, swapchain.images[swapchain.acquiredImage].semPresentReady, swapchain.acquiredSema, waitSema, waitValue);
+  return true;
+}
+
+void VulkanPresenter::present(int index, int setIndex, int bufferIndex, VkSemaphore waitSema, size_t waitValue) {
+  OPTICK_EVENT("Present");
+  LOG_USE_MODULE(Presenter);
+
+  auto& window    = m_windows[index];
+  auto& swapchain = window.bufferSets[setIndex];
+  auto& stats     = swapchain.presentStats;
+
+  // Resized or out of date: recreated once the image acquired in advance is used up
+  if (swapchain.outOfDate && swapchain.acquiredImage == vulkan::SwapchainData::NO_IMAGE) {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window.window, &width, &height);
+    if (!vulkan::recreateSwapchain(m_vulkanObj, window.surface, swapchain, width, height)) return; // minimized, the flip isn't shown
+  }
+
+  if (swapchain.acquiredImage == vulkan::SwapchainData::NO_IMAGE) {
+    OPTICK_EVENT("AcquireStall");
+    auto const start    = std::chrono::steady_clock::now();
+    bool const acquired = vulkan::acquireImage(m_vulkanObj, swapchain, UINT64_MAX);
+
+    ++stats.numStalls;
+    stats.stallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if (!acquired) return; // out of date, recreated with the next flip
+  }
+
+  if (!transfer(window, swapchain, bufferIndex, waitSema, waitValue)) return;
+  vulkan::presentImage(m_vulkanObj, swapchain);
+
+  if (stats.numPresents % 1024 == 0) {
+    auto const& transferStats = swapchain.transferStats;
+    LOG_DEBUG(L"present set:%d presents:%llu stalls:%llu (%.1fus avg) recreated:%llu transfers recorded:%llu (%.1fus avg) reused:%llu", setIndex,
+              stats.numPresents, stats.numStalls, 1e-3 * (double)stats.stallNs / (double)std::max<uint64_t>(stats.numStalls, 1), stats.numRecreations,
+              transferStats.numRecorded, 1e-3 * (double)transferStats.recordNs / (double)std::max<uint64_t>(transferStats.numRecorded, 1),
+              transferStats.numReused);
+  }
+}
+} // namespace
+
+std::unique_ptr<IPresenter> createVulkanPresenter(OutputScaling scaling) {
+  return std::make_unique<VulkanPresenter>(scaling);
+}
@@ -0,0 +1,582 @@
+#define __APICALL_EXTERN
+#include "screenShot.h"
+#undef __APICALL_EXTERN
+
+#include "core/detile/detile.h"
+#include "core/initParams/initParams.h"
+#include "logging.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/crc.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+LOG_DEFINE_MODULE(ScreenShot);
+
+namespace {
+constexpr size_t NUM_FRAMES = 2; // one being encoded, one queued
+
+enum class ImageFormat { png, jpeg };
+
+struct Param {
+  std::string photoTitle;
+  std::string gameTitle;
+  std::string gameComment;
+};
+
+/**
+ * @brief Decoded overlay, rgba rows (not premultiplied)
+ *
+ */
+struct OverlayImage {
+  ScreenShotOverlay    placement;
+  uint32_t             width  = 0;
+  uint32_t             height = 0;
+  std::vector<uint8_t> rgba;
+};
+
+float halfToFloat(uint16_t value) {
+  uint32_t const sign     = (uint32_t)(value & 0x8000u) << 16u;
+  uint32_t const exponent = (value >> 10u) & 0x1fu;
+  uint32_t const mantissa = value & 0x3ffu;
+
+  if (exponent == 0) return (sign != 0 ? -1.0f : 1.0f) * std::ldexp((float)mantissa, -24); // denormal
+  uint32_t const bits = exponent == 31 ? sign | 0x7f800000u | (mantissa << 13u) : sign | ((exponent + 112u) << 23u) | (mantissa << 13u);
+  return std::bit_cast<float>(bits);
+}
+
+/**
+ * @brief Linear to srgb, 4096 steps
+ *
+ */
+uint8_t toSrgb(float linear) {
+  static auto const table = [] {
+    std::array<uint8_t, 4096> table;
+    for (size_t n = 0; n < table.size(); ++n) {
+      double const v = (double)n / (table.size() - 1);
+      double const s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+      table[n]       = (uint8_t)std::lround(s * 255.0);
+    }
+    return table;
+  }();
+
+  if (!(linear > 0.0f)) return 0; // also NaN
+  return table[(size_t)(std::min(linear, 1.0f) * (table.size() - 1) + 0.5f)];
+}
+
+/**
+ * @brief Display buffer rows to rgb24
+ *
+ * @return false if the pixel format isn't supported
+ */
+bool convertRows(SceVideoOutPixelFormat format, uint8_t const* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height) {
+  auto forEachPixel = [&]<typename T>(T, auto&& convert) {
+    for (uint32_t y = 0; y < height; ++y) {
+      auto const srcRow = (T const*)(src + y * srcPitch);
+      auto       dstRow = dst + y * dstPitch;
+      for (uint32_t x = 0; x < width; ++x, dstRow += 3) {
+        convert(srcRow[x], dstRow);
+      }
+    }
+  };
+
+  switch (format) {
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A8R8G8B8_SRGB:
+      forEachPixel(uint32_t(), [](uint32_t pixel, uint8_t* rgb) {
+        rgb[0] = (uint8_t)(pixel >> 16u);
+        rgb[1] = (uint8_t)(pixel >> 8u);
+        rgb[2] = (uint8_t)pixel;
+      });
+      return true;
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A8B8G8R8_SRGB:
+      forEachPixel(uint32_t(), [](uint32_t pixel, uint8_t* rgb) {
+        rgb[0] = (uint8_t)pixel;
+        rgb[1] = (uint8_t)(pixel >> 8u);
+        rgb[2] = (uint8_t)(pixel >> 16u);
+      });
+      return true;
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10_SRGB:
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A2R10G10B10_BT2020_PQ: // not tone mapped
+      forEachPixel(uint32_t(), [](uint32_t pixel, uint8_t* rgb) {
+        rgb[0] = (uint8_t)(pixel >> 22u);
+        rgb[1] = (uint8_t)(pixel >> 12u);
+        rgb[2] = (uint8_t)(pixel >> 2u);
+      });
+      return true;
+    case SceVideoOutPixelFormat::PIXEL_FORMAT_A16R16G16B16_FLOAT:
+      forEachPixel(uint64_t(), [](uint64_t pixel, uint8_t* rgb) {
+        rgb[0] = toSrgb(halfToFloat((uint16_t)(pixel >> 32u)));
+        rgb[1] = toSrgb(halfToFloat((uint16_t)(pixel >> 16u)));
+        rgb[2] = toSrgb(halfToFloat((uint16_t)pixel));
+      });
+      return true;
+  }
+  return false;
+}
+
+int32_t getOverlayPos(uint8_t align, int32_t offset, uint32_t size, uint32_t overlaySize) {
+  switch (align) {
+    case 0: return offset;
+    case 1: return ((int32_t)size - (int32_t)overlaySize) / 2 + offset;
+    default: break;
+  }
+  return (int32_t)size - (int32_t)overlaySize - offset;
+}
+
+/**
+ * @brief Alpha blends the overlay into the rgb24 frame, clipped to it
+ *
+ */
+void drawOverlay(OverlayImage const& overlay, AVFrame* frame) {
+  auto const& placement = overlay.placement;
+
+  int32_t const posX = getOverlayPos(placement.alignX, placement.x, frame->width, overlay.width);
+  int32_t const posY = getOverlayPos(placement.alignY, placement.y, frame->height, overlay.height);
+
+  int32_t const startX = std::max(posX, 0), endX = std::min(posX + (int32_t)overlay.width, frame->width);
+  int32_t const startY = std::max(posY, 0), endY = std::min(posY + (int32_t)overlay.height, frame->height);
+
+  for (int32_t y = startY; y < endY; ++y) {
+    auto src = overlay.rgba.data() + ((size_t)(y - posY) * overlay.width + (startX - posX)) * 4;
+    auto dst = frame->data[0] + (size_t)y * frame->linesize[0] + (size_t)startX * 3;
+    for (int32_t x = startX; x < endX; ++x, src += 4, dst += 3) {
+      uint32_t const alpha = src[3];
+      for (int c = 0; c < 3; ++c) {
+        dst[c] = (uint8_t)((src[c] * alpha + dst[c] * (255u - alpha) + 127u) / 255u);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Adds an iTXt chunk (utf-8) after the IHDR chunk
+ *
+ */
+void addPngText(std::vector<uint8_t>& png, char const* keyword, std::string const& text) {
+  constexpr size_t IHDR_END = 8 + 4 + 4 + 13 + 4; // signature, length, type, data, crc
+  if (text.empty() || png.size() < IHDR_END || memcmp(png.data() + 12, "IHDR", 4) != 0) return;
+
+  std::vector<uint8_t> chunk(8);
+  memcpy(chunk.data() + 4, "iTXt", 4);
+  chunk.insert(chunk.end(), keyword, keyword + strlen(keyword) + 1);
+  chunk.insert(chunk.end(), {0, 0, 0, 0}); // not compressed, no language and translated keyword
+  chunk.insert(chunk.end(), text.begin(), text.end());
+
+  uint32_t const length = (uint32_t)(chunk.size() - 8);
+  uint32_t const crc    = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), UINT32_MAX, chunk.data() + 4, chunk.size() - 4) ^ UINT32_MAX;
+  for (int n = 0; n < 4; ++n) {
+    chunk[n] = (uint8_t)(length >> (24 - 8 * n));
+    chunk.push_back((uint8_t)(crc >> (24 - 8 * n)));
+  }
+  png.insert(png.begin() + IHDR_END, chunk.begin(), chunk.end());
+}
+
+/**
+ * @brief Adds a comment segment after the start of image marker
+ *
+ */
+void addJpegComment(std::vector<uint8_t>& jpeg, char const* name, std::string const& text) {
+  if (text.empty() || jpeg.size() < 2 || jpeg[0] != 0xff || jpeg[1] != 0xd8) return;
+
+  auto comment = std::format("{}: {}", name, text);
+  comment.resize(std::min<size_t>(comment.size(), UINT16_MAX - 2));
+
+  uint16_t const       length = (uint16_t)(comment.size() + 2);
+  std::vector<uint8_t> segment {0xff, 0xfe, (uint8_t)(length >> 8u), (uint8_t)length};
+  segment.insert(segment.end(), comment.begin(), comment.end());
+  jpeg.insert(jpeg.begin() + 2, segment.begin(), segment.end());
+}
+
+class ScreenShot: public IScreenShot {
+  std::filesystem::path m_dir;
+  ImageFormat           m_format = ImageFormat::png;
+  uint32_t              m_every  = 0; // periodic captures, 0: off
+
+  std::atomic_uint32_t m_requests  = 0; // bit per window
+  std::atomic_bool     m_enabled   = true;
+  std::atomic_bool     m_supported = true;
+
+  mutable std::mutex                            m_mutex;
+  std::condition_variable                       m_condWork;
+  std::condition_variable                       m_condDone;
+  std::vector<std::unique_ptr<ScreenShotFrame>> m_free;
+  std::deque<std::unique_ptr<ScreenShotFrame>>  m_queue;
+  uint32_t                                      m_numBusy = 0; // being encoded
+  bool                                          m_stop    = false;
+  std::thread                                   m_thread;
+
+  Param             m_param;
+  ScreenShotOverlay m_overlay;
+  uint64_t          m_overlayVersion = 0;
+  ScreenShotStats   m_stats;
+
+  // Worker
+  std::vector<uint8_t> m_linear; // detiled display buffer
+  std::vector<uint8_t> m_encoded;
+  OverlayImage         m_overlayImage;
+  uint64_t             m_overlayImageVersion = 0;
+  SwsContext*          m_sws                 = nullptr;
+
+  void run();
+  bool write(ScreenShotFrame const& frame, Param const& param);
+  bool toRgb(ScreenShotFrame const& frame, AVFrame* rgb);
+  bool encode(AVFrame* rgb);
+  void loadOverlay(ScreenShotOverlay const& overlay);
+
+  public:
+  ScreenShot() {
+    m_dir   = accessInitParams()->getScreenShotDir();
+    m_every = accessInitParams()->getScreenShotEvery();
+
+    auto const format = accessInitParams()->getScreenShotFormat();
+    if (format == "jpeg" || format == "jpg") {
+      m_format = ImageFormat::jpeg;
+    } else if (format != "png") {
+      LOG_USE_MODULE(ScreenShot);
+      LOG_ERR(L"screenshotFormat %S unknown, using png", format.c_str());
+    }
+
+    for (size_t n = 0; n < NUM_FRAMES; ++n) {
+      m_free.push_back(std::make_unique<ScreenShotFrame>());
+    }
+  }
+
+  virtual ~ScreenShot() {
+    std::unique_lock lock(m_mutex);
+    m_stop = true;
+    lock.unlock();
+    m_condWork.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+    sws_freeContext(m_sws);
+  }
+
+  void setEnabled(bool enabled) final {
+    m_enabled = enabled;
+    if (!enabled) m_requests = 0;
+  }
+
+  void setSupported(bool supported) final {
+    m_supported = supported;
+    if (!supported && m_every > 0) {
+      LOG_USE_MODULE(ScreenShot);
+      LOG_WARN(L"screenshotEvery: the presenter can't capture display buffers");
+    }
+  }
+
+  bool isSupported() const final { return m_supported; }
+
+  void setParam(std::string const& photoTitle, std::string const& gameTitle, std::string const& gameComment) final {
+    std::unique_lock const lock(m_mutex);
+    m_param = {photoTitle, gameTitle, gameComment};
+  }
+
+  void setOverlay(ScreenShotOverlay const& overlay) final {
+    std::unique_lock const lock(m_mutex);
+    m_overlay = overlay;
+    ++m_overlayVersion;
+  }
+
+  bool request(int handle) final {
+    if (!m_enabled || !m_supported) return false;
+    m_requests.fetch_or(1u << (uint32_t)(handle - 1));
+    return true;
+  }
+
+  void flush() final {
+    std::unique_lock lock(m_mutex);
+    m_condDone.wait(lock, [this] { return m_queue.empty() && m_numBusy == 0; });
+  }
+
+  ScreenShotStats getStats() const final {
+    std::unique_lock const lock(m_mutex);
+    return m_stats;
+  }
+
+  std::unique_ptr<ScreenShotFrame> beginCapture(int handle, uint64_t flipCount) final;
+  void                             endCapture(std::unique_ptr<ScreenShotFrame> frame, bool captured) final;
+};
+
+std::unique_ptr<ScreenShotFrame> ScreenShot::beginCapture(int handle, uint64_t flipCount) {
+  uint32_t const bit       = 1u << (uint32_t)(handle - 1);
+  if (!m_supported.load(std::memory_order_relaxed)) return {};
+
+  bool const     periodic  = m_every > 0 && flipCount % m_every == 0;
+  bool const     requested = (m_requests.load(std::memory_order_relaxed) & bit) != 0;
+  if (!periodic && !requested) return {};
+
+  auto const start = std::chrono::steady_clock::now();
+
+  std::unique_lock const lock(m_mutex);
+  if (m_free.empty()) {
+    ++m_stats.numDropped; // a request stays pending for the next flip
+    return {};
+  }
+  if (requested) m_requests.fetch_and(~bit);
+
+  auto frame = std::move(m_free.back());
+  m_free.pop_back();
+
+  frame->handle       = handle;
+  frame->flipCount    = flipCount;
+  frame->captureStart = start;
+  return frame;
+}
+
+void ScreenShot::endCapture(std::unique_ptr<ScreenShotFrame> frame, bool captured) {
+  auto const captureNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame->captureStart).count();
+
+  std::unique_lock lock(m_mutex);
+  m_stats.captureNs += captureNs;
+  m_stats.maxCaptureNs = std::max(m_stats.maxCaptureNs, captureNs);
+  if (!captured) {
+    ++m_stats.numFailed;
+    m_free.push_back(std::move(frame));
+    return;
+  }
+
+  ++m_stats.numCaptured;
+  m_queue.push_back(std::move(frame));
+  if (!m_thread.joinable()) m_thread = std::thread([this] { run(); });
+  lock.unlock();
+  m_condWork.notify_one();
+}
+
+void ScreenShot::run() {
+  util::setThreadName("ScreenShot");
+
+  std::unique_lock lock(m_mutex);
+  while (true) {
+    m_condWork.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+    if (m_stop) break;
+
+    auto frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    ++m_numBusy;
+
+    auto const param = m_param;
+    if (m_overlayImageVersion != m_overlayVersion) {
+      m_overlayImageVersion = m_overlayVersion;
+      auto const overlay    = m_overlay;
+      lock.unlock();
+      loadOverlay(overlay);
+    } else {
+      lock.unlock();
+    }
+
+    auto const start    = std::chrono::steady_clock::now();
+    bool const written  = write(*frame, param);
+    auto const encodeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    m_stats.encodeNs += encodeNs;
+    if (written) {
+      ++m_stats.numWritten;
+    } else {
+      ++m_stats.numFailed;
+    }
+    m_free.push_back(std::move(frame));
+    --m_numBusy;
+    m_condDone.notify_all();
+  }
+}
+
+bool ScreenShot::write(ScreenShotFrame const& frame, Param const& param) {
+  LOG_USE_MODULE(ScreenShot);
+
+  auto const& attr = frame.attribute;
+
+  AVFrame* rgb = av_frame_alloc();
+  rgb->format  = AV_PIX_FMT_RGB24;
+  rgb->width   = (int)attr.width;
+  rgb->height  = (int)attr.height;
+
+  bool const converted = av_frame_get_buffer(rgb, 0) >= 0 && toRgb(frame, rgb);
+  if (converted && !m_overlayImage.rgba.empty()) drawOverlay(m_overlayImage, rgb);
+
+  bool const encoded = converted && encode(rgb);
+  av_frame_free(&rgb);
+  if (!encoded) return false;
+
+  if (m_format == ImageFormat::png) {
+    addPngText(m_encoded, "Comment", param.gameComment);
+    addPngText(m_encoded, "Software", param.gameTitle);
+    addPngText(m_encoded, "Title", param.photoTitle);
+  } else {
+    addJpegComment(m_encoded, "Comment", param.gameComment);
+    addJpegComment(m_encoded, "Game", param.gameTitle);
+    addJpegComment(m_encoded, "Title", param.photoTitle);
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(m_dir, ec);
+
+  auto const path = m_dir / std::format("screenshot_{}_{:06}.{}", frame.handle, frame.flipCount, m_format == ImageFormat::png ? "png" : "jpg");
+  auto       file = fopen(path.string().c_str(), "wb");
+  if (file == nullptr) {
+    LOG_ERR(L"couldn't create %S", path.string().c_str());
+    return false;
+  }
+
+  bool const result = fwrite(m_encoded.data(), 1, m_encoded.size(), file) == m_encoded.size();
+  fclose(file);
+
+  LOG_DEBUG(L"%S %ux%u flip:%llu", path.string().c_str(), attr.width, attr.height, frame.flipCount);
+  return result;
+}
+
+bool ScreenShot::toRgb(ScreenShotFrame const& frame, AVFrame* rgb) {
+  LOG_USE_MODULE(ScreenShot);
+
+  auto const& attr   = frame.attribute;
+  auto const& layout = frame.layout;
+
+  auto           src      = frame.data.data();
+  uint64_t const srcPitch = (uint64_t)layout.pitch * layout.bytesPerPixel;
+  if (attr.tilingMode == (int32_t)SceVideoOutTilingMode::TILE) {
+    m_linear.resize(layout.size);
+
+    detile::Surface surface;
+    if (!getDisplayBufferSurface(attr, false, surface) || !detile::detileSurface(surface, src, 0, m_linear.data(), srcPitch)) {
+      LOG_ERR(L"couldn't detile %ux%u pitch:%u", attr.width, attr.height, layout.pitch);
+      return false;
+    }
+    src = m_linear.data();
+  }
+
+  if (!convertRows(attr.pixelFormat, src, srcPitch, rgb->data[0], rgb->linesize[0], attr.width, attr.height)) {
+    LOG_ERR(L"pixel format 0x%08x not supported", (uint32_t)attr.pixelFormat);
+    return false;
+  }
+  return true;
+}
+
+bool ScreenShot::encode(AVFrame* rgb) {
+  LOG_USE_MODULE(ScreenShot);
+
+  bool const png   = m_format == ImageFormat::png;
+  auto const codec = avcodec_find_encoder(png ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG);
+  if (codec == nullptr) {
+    LOG_ERR(L"no %S encoder", png ? "png" : "jpeg");
+    return false;
+  }
+
+  AVCodecContext* ctx = avcodec_alloc_context3(codec);
+  ctx->width          = rgb->width;
+  ctx->height         = rgb->height;
+  ctx->time_base      = {1, 60};
+  ctx->pix_fmt        = png ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_YUVJ420P;
+  if (!png) {
+    ctx->flags |= AV_CODEC_FLAG_QSCALE;
+    ctx->global_quality = FF_QP2LAMBDA * 2; // high quality
+  }
+
+  AVFrame*  yuv    = nullptr;
+  AVFrame*  input  = rgb;
+  AVPacket* packet = av_packet_alloc();
+
+  bool result = avcodec_open2(ctx, codec, nullptr) >= 0;
+  if (result && !png) {
+    yuv         = av_frame_alloc();
+    yuv->format = ctx->pix_fmt;
+    yuv->width  = rgb->width;
+    yuv->height = rgb->height;
+
+    m_sws  = sws_getCachedContext(m_sws, rgb->width, rgb->height, AV_PIX_FMT_RGB24, yuv->width, yuv->height, AV_PIX_FMT_YUVJ420P, SWS_BILINEAR, nullptr,
+                                  nullptr, nullptr);
+    result = m_sws != nullptr && av_frame_get_buffer(yuv, 0) >= 0 &&
+             sws_scale(m_sws, rgb->data, rgb->linesize, 0, rgb->height, yuv->data, yuv->linesize) == yuv->height;
+    input = yuv;
+  }
+
+  m_encoded.clear();
+  if (result) result = avcodec_send_frame(ctx, input) >= 0 && avcodec_send_frame(ctx, nullptr) >= 0;
+  while (result && avcodec_receive_packet(ctx, packet) >= 0) {
+    m_encoded.insert(m_encoded.end(), packet->data, packet->data + packet->size);
+    av_packet_unref(packet);
+  }
+  if (result && m_encoded.empty()) result = false;
+  if (!result) LOG_ERR(L"%S encoding of %dx%d failed", png ? "png" : "jpeg", rgb->width, rgb->height);
+
+  av_packet_free(&packet);
+  av_frame_free(&yuv);
+  avcodec_free_context(&ctx);
+  return result;
+}
+
+void ScreenShot::loadOverlay(ScreenShotOverlay const& overlay) {
+  LOG_USE_MODULE(ScreenShot);
+
+  m_overlayImage = {.placement = overlay};
+  if (overlay.path.empty()) return;
+
+  std::vector<uint8_t> data;
+  if (auto file = fopen(overlay.path.string().c_str(), "rb"); file != nullptr) {
+    fseek(file, 0, SEEK_END);
+    data.resize((size_t)std::max(ftell(file), 0L));
+    fseek(file, 0, SEEK_SET);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+  }
+  if (data.empty()) {
+    LOG_ERR(L"overlay %S not found", overlay.path.string().c_str());
+    return;
+  }
+
+  auto const      codec  = avcodec_find_decoder(AV_CODEC_ID_PNG);
+  AVCodecContext* ctx    = codec != nullptr ? avcodec_alloc_context3(codec) : nullptr;
+  AVPacket*       packet = av_packet_alloc();
+  AVFrame*        image  = av_frame_alloc();
+
+  bool result = ctx != nullptr && avcodec_open2(ctx, codec, nullptr) >= 0 && av_new_packet(packet, (int)data.size()) >= 0;
+  if (result) {
+    memcpy(packet->data, data.data(), data.size());
+    result = avcodec_send_packet(ctx, packet) >= 0 && avcodec_receive_frame(ctx, image) >= 0;
+  }
+
+  if (result) {
+    auto sws = sws_getContext(image->width, image->height, (AVPixelFormat)image->format, image->width, image->height, AV_PIX_FMT_RGBA, SWS_POINT, nullptr,
+                              nullptr, nullptr);
+    if (sws != nullptr) {
+      m_overlayImage.width  = (uint32_t)image->width;
+      m_overlayImage.height = (uint32_t)image->height;
+      m_overlayImage.rgba.resize((size_t)image->width * image->height * 4);
+
+      uint8_t* const dst[]      = {m_overlayImage.rgba.data()};
+      int const      dstPitch[] = {image->width * 4};
+      sws_scale(sws, image->data, image->linesize, 0, image->height, dst, dstPitch);
+      sws_freeContext(sws);
+    }
+  }
+
+  if (m_overlayImage.rgba.empty()) {
+    LOG_ERR(L"overlay %S isn't a png", overlay.path.string().c_str());
+  } else {
+    LOG_INFO(L"overlay %S %ux%u", overlay.path.string().c_str(), m_overlayImage.width, m_overlayImage.height);
+  }
+
+  av_frame_free(&image);
+  av_packet_free(&packet);
+  avcodec_free_context(&ctx);
+}
+} // namespace
+
+IScreenShot& accessScreenShot() {
+  static ScreenShot inst;
+  return inst;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "displayBuffer.h"
+#include "modules/libSceVideoOut/types.h"
+#include "utility/utility.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A display buffer copied on the VideoOut thread as is (tiled or linear), converted and encoded by the screenshot worker
+ *
+ */
+struct ScreenShotFrame {
+  int      handle    = 0;
+  uint64_t flipCount = 0;
+
+  SceVideoOutBufferAttribute attribute {};
+  DisplayBufferLayout        layout;
+  std::vector<uint8_t>       data; // layout.size bytes, the capacity is kept for the next capture
+
+  std::chrono::steady_clock::time_point captureStart;
+};
+
+struct ScreenShotStats {
+  uint64_t numCaptured  = 0; // copied on the VideoOut thread
+  uint64_t numDropped   = 0; // flips not captured, all frames were in use
+  uint64_t numWritten   = 0;
+  uint64_t numFailed    = 0; // capture, conversion, encoding or file errors
+  uint64_t captureNs    = 0; // VideoOut thread: frame handling and copy
+  uint64_t maxCaptureNs = 0;
+  uint64_t encodeNs     = 0; // worker: detile, conversion, overlay, encoding and file
+};
+
+/**
+ * @brief Image drawn over the screenshots
+ *
+ */
+struct ScreenShotOverlay {
+  std::filesystem::path path; // png, empty: none
+
+  int32_t x      = 0; // left/top: offset, right/bottom: margin to the border, center: offset from the centered position
+  int32_t y      = 0;
+  uint8_t alignX = 0; // 0: left, 1: center, 2: right
+  uint8_t alignY = 0; // 0: top, 1: center, 2: bottom
+};
+
+/**
+ * @brief Screenshots of flipped display buffers. The VideoOut thread only copies the buffer,
+ * detiling, color conversion and png/jpeg encoding are done by a worker thread. Captures are dropped instead of waiting for it.
+ *
+ */
+class IScreenShot {
+  CLASS_NO_COPY(IScreenShot);
+  CLASS_NO_MOVE(IScreenShot);
+
+  protected:
+  IScreenShot() = default;
+
+  public:
+  virtual ~IScreenShot() = default;
+
+  /**
+   * @brief sceScreenShotEnable/Disable, enabled at start. The periodic captures (--screenshotEvery) ignore it
+   *
+   */
+  virtual void setEnabled(bool enabled) = 0;
+
+  /**
+   * @brief Set by VideoOut, false if its presenter can't copy display buffers
+   *
+   */
+  virtual void setSupported(bool supported) = 0;
+
+  virtual bool isSupported() const = 0;
+
+  /**
+   * @brief Metadata of the following screenshots (png text chunks, jpeg comments), empty strings are left out
+   *
+   */
+  virtual void setParam(std::string const& photoTitle, std::string const& gameTitle, std::string const& gameComment) = 0;
+
+  /**
+   * @brief Image drawn over the following screenshots, loaded by the worker
+   *
+   */
+  virtual void setOverlay(ScreenShotOverlay const& overlay) = 0;
+
+  /**
+   * @brief Captures the next flip of the window
+   *
+   * @param handle VideoOut handle
+   * @return false if disabled or not supported
+   */
+  virtual bool request(int handle) = 0;
+
+  /**
+   * @brief Waits until the captured frames are written
+   *
+   */
+  virtual void flush() = 0;
+
+  virtual ScreenShotStats getStats() const = 0;
+
+  /**
+   * @brief Called from the VideoOut thread for every flip
+   *
+   * @param flipCount flip count after this flip
+   * @return a free frame if this flip is captured, nullptr: not requested or no free frame
+   */
+  virtual std::unique_ptr<ScreenShotFrame> beginCapture(int handle, uint64_t flipCount) = 0;
+
+  /**
+   * @brief Queues the frame for the worker, or returns it to the pool if it wasn't captured. Never waits for the worker
+   *
+   */
+  virtual void endCapture(std::unique_ptr<ScreenShotFrame> frame, bool captured) = 0;
+};
+
+#if defined(__APICALL_EXTERN)
+#define __APICALL __declspec(dllexport)
+#elif defined(__APICALL_IMPORT)
+#define __APICALL __declspec(dllimport)
+#else
+#define __APICALL
+#endif
+
+__APICALL IScreenShot& accessScreenShot();
+
+#undef __APICALL
@@ -0,0 +1,128 @@
+#include "vblankClock.h"
+
+#include "logging.h"
+
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <optick.h>
+#include <thread>
+
+LOG_DEFINE_MODULE(VblankClock);
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t SPIN_MIN_NS = 200'000;   // margin kept for spinning, above the usual wakeup latency
+constexpr int64_t SPIN_MAX_NS = 2'000'000; // bounds the cpu spent spinning when sleeps overshoot a lot
+
+class VblankClock: public IVblankClock {
+  RefreshRate const m_rate;
+  callback_t const  m_callback;
+
+  HANDLE m_timer     = nullptr;
+  HANDLE m_stopEvent = nullptr;
+
+  std::atomic<uint64_t> m_count  = 0;
+  int64_t               m_spinNs = SPIN_MAX_NS; // follows the observed oversleep
+
+  std::thread m_thread;
+
+  bool sleepUntil(Clock::time_point time);
+
+  void run();
+
+  public:
+  VblankClock(RefreshRate rate, callback_t&& callback): m_rate(rate), m_callback(std::move(callback)) {
+    LOG_USE_MODULE(VblankClock);
+
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (m_timer == nullptr) {
+      LOG_WARN(L"no high resolution timer, vblanks spin longer");
+      m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    LOG_INFO(L"vblank %.3fHz", (double)m_rate.num / (double)m_rate.den);
+    m_thread = std::thread([this] { run(); });
+  }
+
+  virtual ~VblankClock() {
+    SetEvent(m_stopEvent);
+    m_thread.join();
+    CloseHandle(m_timer);
+    CloseHandle(m_stopEvent);
+  }
+
+  uint64_t getCount() const final { return m_count.load(std::memory_order_relaxed); }
+
+  RefreshRate getRate() const final { return m_rate; }
+};
+
+bool VblankClock::sleepUntil(Clock::time_point time) {
+  auto const duration = std::chrono::duration_cast<std::chrono::nanoseconds>(time - Clock::now()).count();
+  if (duration <= 0) return WaitForSingleObject(m_stopEvent, 0) != WAIT_OBJECT_0;
+
+  LARGE_INTEGER dueTime {.QuadPart = -(duration / 100)}; // negative: relative, 100ns units
+  SetWaitableTimer(m_timer, &dueTime, 0, nullptr, nullptr, FALSE);
+
+  HANDLE const handles[] = {m_stopEvent, m_timer};
+  return WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0;
+}
+
+void VblankClock::run() {
+  util::setThreadName("VBlank");
+  OPTICK_THREAD("VBlank");
+
+  auto const start       = Clock::now();
+  auto const getDeadline = [&](uint64_t count) { return start + std::chrono::nanoseconds(m_rate.getTimeNs(count)); };
+
+  for (uint64_t count = 1;; ++count) {
+    auto const deadline = getDeadline(count);
+    auto const wakeup   = deadline - std::chrono::nanoseconds(m_spinNs);
+    if (!sleepUntil(wakeup)) break;
+
+    auto const oversleep = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - wakeup).count();
+    if (oversleep + SPIN_MIN_NS > m_spinNs) {
+      m_spinNs = std::min(oversleep + SPIN_MIN_NS, SPIN_MAX_NS);
+    } else {
+      m_spinNs -= (m_spinNs - SPIN_MIN_NS) / 32;
+    }
+
+    while (Clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+
+    // Stalled past the next deadlines: skip them, the count stays in sync with the time
+    auto const now = Clock::now();
+    while (getDeadline(count + 1) <= now) {
+      ++count;
+    }
+
+    m_count.store(count, std::memory_order_relaxed);
+    m_callback(count, getDeadline(count));
+  }
+}
+} // namespace
+
+RefreshRate RefreshRate::fromHz(double hz) {
+  auto const rate = std::round(hz * 1.001);
+  if (std::abs(hz - rate / 1.001) < 0.005) return {(uint64_t)rate * 1000, 1001};
+  return {(uint64_t)std::round(hz * 1000.0), 1000};
+}
+
+uint64_t RefreshRate::getTimeNs(uint64_t count) const {
+  // count * den * 1e9 / num, split to stay in 64 bit
+  uint64_t const cycleNs = den * 1'000'000'000ull; // time of num vblanks
+  return (count / num) * cycleNs + (count % num) * cycleNs / num;
+}
+
+std::unique_ptr<IVblankClock> createVblankClock(RefreshRate rate, IVblankClock::callback_t&& callback) {
+  return std::make_unique<VblankClock>(rate, std::move(callback));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "utility/utility.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+/**
+ * @brief Refresh rate in num/den Hz, 59.94Hz is 60000/1001
+ *
+ */
+struct RefreshRate {
+  uint64_t num = 60000;
+  uint64_t den = 1001;
+
+  /**
+   * @brief 59.94, 119.88 etc. are mapped to their exact x000/1001 fraction
+   *
+   */
+  static RefreshRate fromHz(double hz);
+
+  /**
+   * @brief Time of the count-th vblank, exact (no accumulated rounding)
+   *
+   * @return ns since the start of the clock
+   */
+  uint64_t getTimeNs(uint64_t count) const;
+};
+
+/**
+ * @brief VBlank timing on its own thread. Deadlines are absolute on a monotonic clock: the thread sleeps until shortly before the deadline and
+ * spins the rest.
+ *
+ */
+class IVblankClock {
+  CLASS_NO_COPY(IVblankClock);
+  CLASS_NO_MOVE(IVblankClock);
+
+  protected:
+  IVblankClock() = default;
+
+  public:
+  /**
+   * @brief Called from the clock thread
+   *
+   * @param count vblanks since the start, skips the missed ones if the thread was stalled
+   * @param deadline the scheduled time of vblank count
+   */
+  using callback_t = std::function<void(uint64_t count, std::chrono::steady_clock::time_point deadline)>;
+
+  virtual ~IVblankClock() = default;
+
+  virtual uint64_t getCount() const = 0;
+
+  virtual RefreshRate getRate() const = 0;
+};
+
+/**
+ * @brief Starts the clock, destruction stops it
+ *
+ */
+std::unique_ptr<IVblankClock> createVblankClock(RefreshRate rate, IVblankClock::callback_t&& callback);
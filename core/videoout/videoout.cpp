@@ -4,137 +4,245 @@
 #include "intern.h"
 #undef __APICALL_EXTERN
 
-#include "core/imports/exports/gpuMemory_types.h"
+#include "core/hleStats/hleStats.h"
 #include "core/imports/exports/graphics.h"
-#include "core/imports/imports_func.h"
 #include "core/initParams/initParams.h"
 #include "core/kernel/eventqueue.h"
+#include "core/pm4Capture/pm4Capture.h"
 #include "core/systemContent/systemContent.h"
 #include "core/timer/timer.h"
 #include "logging.h"
 #include "modules/libSceVideoOut/codes.h"
 #include "modules/libSceVideoOut/types.h"
+#include "frameStats.h"
 #include "modules_include/common.h"
-#include "vulkan/vulkanHelper.h"
+#include "mpscQueue.h"
+#include "presenter.h"
+#include "screenShot.h"
+#include "vblankClock.h"
+#include "vulkan/vulkanSetup.h"
 
 #include <queue>
 
-#include <GLFW/glfw3.h>
 #include <algorithm>
 #include <array>
 #include <assert.h>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <format>
 #include <list>
 #include <magic_enum/magic_enum.hpp>
 #include <memory>
 #include <mutex>
 #include <optick.h>
+#include <stdio.h>
 #include <thread>
 
 LOG_DEFINE_MODULE(VideoOut);
 using namespace Kernel;
 
 namespace {
-size_t constexpr WindowsMAX = 2;
+struct VideoOutConfig {
+  SceVideoOutVblankStatus     vblankStatus;
+  SceVideoOutResolutionStatus resolution;
 
-std::pair<uint32_t, uint32_t> getDisplayBufferSize(uint32_t width, uint32_t height, uint32_t pitch, bool tile, bool neo) {
-  if (pitch == 3840) {
-    if (width == 3840 && height == 2160 && tile && !neo) {
-      return {33423360, 32768};
-    }
-    if (width == 3840 && height == 2160 && tile && neo) {
-      return {33423360, 65536};
-    }
-    if (width == 3840 && height == 2160 && !tile && !neo) {
-      return {33177600, 256};
-    }
-    if (width == 3840 && height == 2160 && !tile && neo) {
-      return {33177600, 256};
-    }
+  std::array<int32_t, 16> buffers; // index to bufferSets
+  uint8_t                 buffersSetsCount = 0;
+
+  VideoOutConfig() {
+    std::fill(buffers.begin(), buffers.end(), -1);
+
+    // The video mode titles see, independent of the output size
+    resolution = {.fullWidth = 1920, .fullHeight = 1080, .paneWidth = 1920, .paneHeight = 1080};
   }
+};
 
-  if (pitch == 1920) {
-    if (width == 1920 && height == 1080 && tile && !neo) {
-      return {8355840, 32768};
-    }
-    if (width == 1920 && height == 1080 && tile && neo) {
-      return {8847360, 65536};
-    }
-    if (width == 1920 && height == 1080 && !tile && !neo) {
-      return {8294400, 256};
-    }
-    if (width == 1920 && height == 1080 && !tile && neo) {
-      return {8294400, 256};
-    }
+enum class FlipRate {
+  _60Hz,
+  _30Hz,
+  _20Hz,
+};
+
+uint64_t getFlipInterval(FlipRate rate) {
+  switch (rate) {
+    case FlipRate::_60Hz: return 1;
+    case FlipRate::_30Hz: return 2;
+    case FlipRate::_20Hz: return 3;
   }
+  return 1;
+}
 
-  if (pitch == 1280) {
-    if (width == 1280 && height == 720 && tile && !neo) {
-      return {3932160, 32768};
-    }
-    if (width == 1280 && height == 720 && tile && neo) {
-      return {3932160, 65536};
-    }
-    if (width == 1280 && height == 720 && !tile && !neo) {
-      return {3686400, 256};
+struct FlipRequest {
+  uint32_t setIndex     = 0;
+  uint32_t bufferIndex  = 0;
+  int64_t  flipArg      = 0;
+  uint64_t submitTsc    = 0;
+  uint64_t submitVblank = 0;    // vsync flips are shown at a later vblank
+  bool     onVblank     = true; // false: shown immediately
+  bool     fromGpu      = false;
+
+  VkSemaphore waitSema  = nullptr; // gpu flips: the copy waits for waitValue
+  size_t      waitValue = 0;
+};
+
+/**
+ * @brief Flip status fields written by the VideoOut thread (and registerBuffers), read without a lock.
+ * Seqlock: a writer keeps the sequence odd while it updates, readers retry if it was odd or has changed.
+ */
+class FlipStatusSeqlock {
+  std::atomic<uint32_t> m_seq = 0;
+
+  std::atomic<uint64_t> m_count         = 0;
+  std::atomic<uint64_t> m_processTime   = 0;
+  std::atomic<uint64_t> m_tsc           = 0;
+  std::atomic<int64_t>  m_flipArg       = 0;
+  std::atomic<uint64_t> m_submitTsc     = 0;
+  std::atomic<int32_t>  m_currentBuffer = 0;
+
+  void load(SceVideoOutFlipStatus& status) const {
+    status.count         = m_count.load(std::memory_order_relaxed);
+    status.processTime   = m_processTime.load(std::memory_order_relaxed);
+    status.tsc           = m_tsc.load(std::memory_order_relaxed);
+    status.flipArg       = m_flipArg.load(std::memory_order_relaxed);
+    status.submitTsc     = m_submitTsc.load(std::memory_order_relaxed);
+    status.currentBuffer = m_currentBuffer.load(std::memory_order_relaxed);
+  }
+
+  public:
+  /**
+   * @brief Writers are serialized by the sequence
+   *
+   * @param func modifies a copy of the status, gcQueueNum and flipPendingNum are ignored
+   */
+  template <typename Func>
+  void update(Func&& func) {
+    auto seq = m_seq.load(std::memory_order_relaxed);
+    while ((seq & 1) != 0 || !m_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+      if ((seq & 1) != 0) {
+        std::this_thread::yield();
+        seq = m_seq.load(std::memory_order_relaxed);
+      }
     }
-    if (width == 1280 && height == 720 && !tile && neo) {
-      return {3686400, 256};
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SceVideoOutFlipStatus status {};
+    load(status);
+    func(status);
+
+    m_count.store(status.count, std::memory_order_relaxed);
+    m_processTime.store(status.processTime, std::memory_order_relaxed);
+    m_tsc.store(status.tsc, std::memory_order_relaxed);
+    m_flipArg.store(status.flipArg, std::memory_order_relaxed);
+    m_submitTsc.store(status.submitTsc, std::memory_order_relaxed);
+    m_currentBuffer.store(status.currentBuffer, std::memory_order_relaxed);
+
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief A consistent snapshot, without gcQueueNum and flipPendingNum
+   *
+   */
+  void read(SceVideoOutFlipStatus& status) const {
+    while (true) {
+      auto const seq = m_seq.load(std::memory_order_acquire);
+      if ((seq & 1) == 0) {
+        load(status);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) == seq) return;
+      }
+      std::this_thread::yield();
     }
   }
-  return {0, 0};
-}
+};
 
-struct VideoOutConfig {
-  SceVideoOutFlipStatus       flipStatus;
-  SceVideoOutVblankStatus     vblankStatus;
-  SceVideoOutResolutionStatus resolution;
+/**
+ * @brief Wakes threads waiting for a change of a counter. notify() only takes the mutex if a thread sleeps,
+ * the thread that waits takes it while it goes to sleep.
+ */
+class Wakeup {
+  std::atomic<uint32_t> m_count    = 0;
+  std::atomic<uint32_t> m_sleepers = 0;
 
-  std::array<vulkan::SwapchainData, 16>          bufferSets;
-  std::array<int32_t, 16>                        buffers; // index to bufferSets
-  std::array<std::weak_ptr<IGpuImageObject>, 16> displayBuffers;
-  uint8_t                                        buffersSetsCount = 0;
+  std::mutex              m_mutex;
+  std::condition_variable m_cond;
 
-  double fps = 0.0;
+  public:
+  /**
+   * @brief Before checking for work
+   *
+   */
+  uint32_t prepare() const { return m_count.load(); }
 
-  VideoOutConfig() { std::fill(buffers.begin(), buffers.end(), -1); }
-};
+  /**
+   * @brief Returns immediately if notify() was called after prepare()
+   *
+   */
+  void wait(uint32_t prepared) {
+    std::unique_lock lock(m_mutex);
+    m_sleepers.fetch_add(1);
+    m_cond.wait(lock, [&] { return m_count.load() != prepared; });
+    m_sleepers.fetch_sub(1);
+  }
 
-enum class FlipRate {
-  _60Hz,
-  _30Hz,
-  _20Hz,
+  void notify() {
+    m_count.fetch_add(1);
+    if (m_sleepers.load() == 0) return;
+
+    { std::unique_lock const lock(m_mutex); } // the sleeper is in wait() now
+    m_cond.notify_all();
+  }
 };
 
 struct Context {
-  int      userId   = -1;
-  FlipRate fliprate = FlipRate::_60Hz;
+  int                   userId   = -1;
+  std::atomic<FlipRate> fliprate = FlipRate::_60Hz;
 
   VideoOutConfig config;
-  GLFWwindow*    window;
-  VkSurfaceKHR   surface;
+
+  std::unique_ptr<MpscQueue<FlipRequest>> submitted;          // submitFlip, eventDoFlip -> VideoOut thread
+  std::atomic<int32_t>                    flipPendingNum = 0; // submitted and not shown yet, reserved before the push
+  std::atomic<int32_t>                    gcQueueNum     = 0;
+  FlipStatusSeqlock                       flipStatus;
+  Wakeup                                  flipShown; // gpu flips waiting for a free slot
+
+  // VideoOut thread only
+  std::deque<FlipRequest>               flipQueue;          // waiting for their vblank
+  uint64_t                              lastFlipVblank = 0; // vblank of the last vsync flip
+  std::chrono::steady_clock::time_point lastFlipTime;       // frame time, epoch: no flip yet
+  // -
+
+  FrameStats stats;
+
+  VideoOutFlipTimes flipTimes;
 
   std::list<EventQueue::IKernelEqueue_t> eventFlip;
   std::list<EventQueue::IKernelEqueue_t> eventVblank;
 };
 
-enum class MessageType { open, close, flip };
+enum class MessageType { open, close };
 
 struct Message {
   MessageType type;
   int         windowIndex = -1;
   bool*       done        = nullptr;
-  uint32_t    index       = 0;
 };
 
-std::string getTitle(int handle, uint64_t frame, size_t fps, FlipRate maxFPS) {
+// Window title, shows the VideoOut handle (index + 1)
+std::string getTitle(int index, VideoOutStats const& stats, FlipRate maxFPS) {
   static auto title = [] {
     auto title = accessSystemContent().getString("TITLE");
     if (title) return title.value().data();
     return "psOFF";
   }();
 
-  return std::format("{}({}): frame={} fps={}(locked:{})", title, handle, frame, fps, magic_enum::enum_name(maxFPS).data());
+  auto ret = std::format("{}({}): frame={} fps={:.1f}(locked:{}) frametime={:.2f}ms(max:{:.2f}) latency={:.2f}ms missed={}", title, index + 1,
+                         stats.numFlips, stats.fps, magic_enum::enum_name(maxFPS).data(), stats.frameMs, stats.maxFrameMs, stats.latencyMs,
+                         stats.vblankMisses);
+  if (hleStats::isEnabled()) ret += std::format(" hle={:.0f}/s", stats.hleCallsPerS);
+  return ret;
 }
 
 } // namespace
@@ -142,50 +250,76 @@ std::string getTitle(int handle, uint64_t frame, size_t fps, FlipRate maxFPS) {
 class VideoOut: public IVideoOut, private IEventsGraphics {
   std::array<Context, WindowsMAX> m_windows;
 
-  uint32_t const m_widthTotal = 1920, m_heightTotal = 1080; // todo: make config
+  uint32_t m_outputWidth = 1920, m_outputHeight = 1080; // window, the display buffers are scaled to it
 
-  mutable std::mutex m_mutexInt;
-  vulkan::VulkanObj* m_vulkanObj = nullptr;
+  mutable std::mutex          m_mutexInt;
+  std::unique_ptr<IPresenter> m_presenter;
+  vulkan::VulkanObj*          m_vulkanObj = nullptr; // nullptr: headless
 
   std::unique_ptr<IGraphics> m_graphics;
   std::thread                m_threadGlfw;
-  std::condition_variable    m_condGlfw;
   std::condition_variable    m_condDone;
   bool                       m_stop = false;
-  std::queue<Message>        m_messages;
+  std::queue<Message>        m_messages; // open, close
 
-  uint64_t m_vblankTime = (uint64_t)(1e6 / 59.0); // in us
+  Wakeup m_wakeup; // VideoOut thread: messages, submitted flips and vblanks
 
-  void vblankEnd(int handle, uint64_t curTime, uint64_t curProcTime);
+  uint32_t m_flipQueueDepth = 16;
+  bool     m_vsync          = true;
 
-  // Callback Graphics
-  void eventDoFlip(int handle, int index, int64_t flipArg, VkSemaphore waitSema, size_t waitValue) final {
-    OPTICK_EVENT();
-    m_graphics->submited();
-    transferDisplay(handle, index, waitSema, waitValue);
+  std::chrono::milliseconds             m_statsInterval {500}; // 0: off
+  bool                                  m_statsLog = false;
+  std::chrono::steady_clock::time_point m_statsTime; // last update, init() at first
+  uint64_t                              m_statsHleCalls = 0;
 
-    std::unique_lock lock(m_mutexInt);
-    auto&            window   = m_windows[handle - 1];
-    uint32_t const   setIndex = window.config.buffers[index];
+  std::atomic<uint64_t>         m_vblankCount = 0;
+  std::unique_ptr<IVblankClock> m_vblankClock; // last: stopped before the windows are gone
 
-    auto& flipStatus = m_windows[index].config.flipStatus;
-    ++flipStatus.gcQueueNum;
-    flipStatus.flipArg = flipArg;
+  void vblank(uint64_t count);
 
-    auto&      timer   = accessTimer();
-    auto const curTime = (uint64_t)(1e9 * timer.getTimeS());
+  /**
+   * @brief Takes a slot of the flip queue
+   *
+   * @param wait true: until a slot is free
+   * @return false: flipQueueDepth flips are pending
+   */
+  bool reserveFlip(Context& window, bool wait);
+  void pushFlip(Context& window, FlipRequest const& flip);
+
+  // VideoOut thread
+  void processMessages();
+  void processFlips();
+  void processStats();
+  void doFlip(int index, FlipRequest const& flip, uint64_t missedVblanks);
+  void dropFlips(int index);
+  // -
 
-    flipStatus.submitTsc = curTime;
-    // window.config.flipStatus.currentBuffer = index; // set after flip, before vblank
+  // Callback Graphics
+  void eventDoFlip(int handle, int index, int64_t flipArg, VkSemaphore waitSema, size_t waitValue) final {
+    OPTICK_EVENT();
+    m_graphics->submited();
 
-    m_messages.push({MessageType::flip, handle - 1, nullptr, setIndex});
-    lock.unlock();
-    m_condGlfw.notify_one();
+    auto&          window   = m_windows[handle - 1];
+    uint32_t const setIndex = window.config.buffers[index];
+
+    // No error path for the gpu, wait for a free slot
+    reserveFlip(window, true);
+    window.gcQueueNum.fetch_add(1, std::memory_order_relaxed);
+    window.stats.onSubmit(true);
+
+    pushFlip(window, FlipRequest {.setIndex     = setIndex,
+                                  .bufferIndex  = (uint32_t)index,
+                                  .flipArg      = flipArg,
+                                  .submitTsc    = accessTimer().queryPerformance(),
+                                  .submitVblank = m_vblankCount.load(std::memory_order_acquire),
+                                  .onVblank     = m_vsync,
+                                  .fromGpu      = true,
+                                  .waitSema     = waitSema,
+                                  .waitValue    = waitValue});
   }
 
   std::pair<VkQueue, uint32_t> getQueue(vulkan::QueueType type) final;
   // -
-  void transferDisplay(int handle, int index, VkSemaphore waitSema, size_t waitValue); // -> Renderer
 
   std::thread createGlfwThread();
 
@@ -203,21 +337,14 @@ class VideoOut: public IVideoOut, private IEventsGraphics {
   void setFliprate(int handle, int rate) final {
     LOG_USE_MODULE(VideoOut);
     LOG_INFO(L"Fliprate:%d", rate);
-    std::unique_lock const lock(m_mutexInt);
     m_windows[handle - 1].fliprate = (FlipRate)rate;
-
-    switch ((FlipRate)rate) {
-      case FlipRate::_60Hz: m_vblankTime = (uint64_t)(1e6 / 59.0); break;
-      case FlipRate::_30Hz: m_vblankTime = (uint64_t)(1e6 / 29.0); break;
-      case FlipRate::_20Hz: m_vblankTime = (uint64_t)(1e6 / 19.0); break;
-    }
   }
 
-  vulkan::DeviceInfo* getDeviceInfo() final { return &m_vulkanObj->deviceInfo; }
+  vulkan::DeviceInfo* getDeviceInfo() final { return m_vulkanObj != nullptr ? &m_vulkanObj->deviceInfo : nullptr; }
 
   int  addEvent(int handle, EventQueue::KernelEqueueEvent const& event, Kernel::EventQueue::IKernelEqueue_t eq) final;
   void removeEvent(int handle, Kernel::EventQueue::IKernelEqueue_t eq, int const ident) final;
-  void submitFlip(int handle, int index, int64_t flipArg) final; // -> Renderer
+  int  submitFlip(int handle, int index, int flipMode, int64_t flipArg) final; // -> Renderer
 
   void getFlipStatus(int handle, void* status) final;
   void getVBlankStatus(int handle, void* status) final;
@@ -229,13 +356,15 @@ class VideoOut: public IVideoOut, private IEventsGraphics {
 
   int registerBuffers(int handle, int startIndex, void* const* addresses, int numBuffer, const void* attribute) final;
 
-  int getPendingFlips(int handle) final {
-    std::unique_lock const lock(m_mutexInt);
+  int getPendingFlips(int handle) final { return m_windows[handle - 1].flipPendingNum.load(std::memory_order_acquire); }
 
-    auto& flipStatus = m_windows[handle - 1].config.flipStatus;
-    return flipStatus.gcQueueNum;
+  VideoOutFlipTimes getFlipTimes(int handle) final {
+    std::unique_lock const lock(m_mutexInt);
+    return m_windows[handle - 1].flipTimes;
   }
 
+  VideoOutStats getStats(int handle) final { return m_windows[handle - 1].stats.get(); }
+
   IGraphics* getGraphics() final {
     assert(m_graphics);
     return m_graphics.get();
@@ -251,14 +380,45 @@ IVideoOut& accessVideoOut() {
 
 void VideoOut::init() {
   LOG_USE_MODULE(VideoOut);
+
+  m_flipQueueDepth = accessInitParams()->getFlipQueueDepth();
+  m_vsync          = accessInitParams()->useVSYNC();
+  if (m_flipQueueDepth > 1024) {
+    LOG_ERR(L"flipQueueDepth %u out of range, using 1024", m_flipQueueDepth);
+    m_flipQueueDepth = 1024;
+  }
+  for (auto& window: m_windows) {
+    window.submitted = std::make_unique<MpscQueue<FlipRequest>>(m_flipQueueDepth);
+  }
+
+  m_statsInterval = std::chrono::milliseconds(accessInitParams()->getStatsInterval());
+  m_statsLog      = accessInitParams()->logStats();
+  m_statsTime     = std::chrono::steady_clock::now();
+
   LOG_DEBUG(L"createGlfwThread()");
   m_threadGlfw = createGlfwThread();
 
+  uint32_t   width = 0, height = 0;
+  auto const resolution = accessInitParams()->getResolution();
+  if (sscanf(resolution.c_str(), "%ux%u", &width, &height) == 2 && width > 0 && height > 0 && width <= 16384 && height <= 16384) {
+    m_outputWidth  = width;
+    m_outputHeight = height;
+  } else {
+    LOG_ERR(L"resolution %S invalid, using 1920x1080", resolution.c_str());
+  }
+
+  auto refreshRate = accessInitParams()->getRefreshRate();
+  if (refreshRate < 1.0 || refreshRate > 1000.0) {
+    LOG_ERR(L"refreshRate %f out of range, using 59.94", refreshRate);
+    refreshRate = 59.94;
+  }
+  m_vblankClock = createVblankClock(RefreshRate::fromHz(refreshRate), [this](uint64_t count, auto) { vblank(count); });
+
   std::unique_lock lock(m_mutexInt);
   static bool      done = false;
   m_messages.push(Message {MessageType::open, 0, &done});
   lock.unlock();
-  m_condGlfw.notify_one();
+  m_wakeup.notify();
 
   lock.lock();
   m_condDone.wait(lock, [=] { return done; });
@@ -275,8 +435,7 @@ int VideoOut::open(int userId) {
     for (int n = 0; n < m_windows.size(); ++n) {
       if (m_windows[n].userId < 0) {
         m_windows[n].userId              = userId;
-        m_windows[n].config.flipStatus   = {};
-        m_windows[n].config.vblankStatus = {};
+        m_windows[n].config.vblankStatus = {}; // flip status: reset by the close
         return n;
       }
     }
@@ -291,7 +450,7 @@ int VideoOut::open(int userId) {
   static bool done = false;
   m_messages.push(Message {MessageType::open, windowIndex, &done});
   lock.unlock();
-  m_condGlfw.notify_one();
+  m_wakeup.notify();
 
   lock.lock();
   m_condDone.wait(lock, [=] { return done; });
@@ -320,10 +479,11 @@ void VideoOut::close(int handle) {
   window.eventFlip.clear();
   window.eventVblank.clear();
 
+  // The VideoOut thread drops the queued flips
   static bool done = false;
-  m_messages.push(Message {MessageType::close, handle, &done});
+  m_messages.push(Message {MessageType::close, handle - 1, &done});
   lock.unlock();
-  m_condGlfw.notify_one();
+  m_wakeup.notify();
 
   lock.lock();
   m_condDone.wait(lock, [=] { return done; });
@@ -369,67 +529,66 @@ void VideoOut::removeEvent(int handle, Kernel::EventQueue::IKernelEqueue_t eq, i
   }
 }
 
-void VideoOut::transferDisplay(int handle, int index, VkSemaphore waitSema, size_t waitValue) {
+int VideoOut::submitFlip(int handle, int index, int flipMode, int64_t flipArg) {
+  OPTICK_EVENT();
   LOG_USE_MODULE(VideoOut);
 
   auto&          window   = m_windows[handle - 1];
   uint32_t const setIndex = window.config.buffers[index];
 
-  auto& swapchain         = window.config.bufferSets[setIndex];
-  auto& displayBufferMeta = swapchain.buffers[index];
-  if (window.config.displayBuffers[index].expired()) {
-    auto image = getDisplayBuffer(displayBufferMeta.bufferVaddr);
-    if (image) {
-      window.config.displayBuffers[index] = image;
-      vulkan::transfer2Display(displayBufferMeta.transferBuffer, m_vulkanObj, swapchain, image->getImage(), image.get(), index);
-      vulkan::submitDisplayTransfer(displayBufferMeta.transferBuffer, m_vulkanObj, displayBufferMeta.semPresentReady, displayBufferMeta.semDisplayReady,
-                                    waitSema, waitValue);
-    } else {
-      LOG_ERR(L"No Display for 0x%08llx:%u", displayBufferMeta.bufferVaddr, displayBufferMeta.bufferSize);
-    }
-  } else {
-    auto image = window.config.displayBuffers[index].lock();
-    vulkan::transfer2Display(displayBufferMeta.transferBuffer, m_vulkanObj, swapchain, image->getImage(), image.get(), index);
-    vulkan::submitDisplayTransfer(displayBufferMeta.transferBuffer, m_vulkanObj, displayBufferMeta.semPresentReady, displayBufferMeta.semDisplayReady, waitSema,
-                                  waitValue);
-  }
-}
-
-void VideoOut::submitFlip(int handle, int index, int64_t flipArg) {
-  OPTICK_EVENT();
-  LOG_USE_MODULE(VideoOut);
+  LOG_TRACE(L"submitFlip(%d):%u %d mode:%d", handle, setIndex, index, flipMode);
+  bool const reserved = reserveFlip(window, false);
+  window.stats.onSubmit(reserved);
+  if (!reserved) return ::Err::VIDEO_OUT_ERROR_FLIP_QUEUE_FULL;
 
   m_graphics->submited(); // increase internal counter (wait for flip)
 
-  auto&          window   = m_windows[handle - 1];
-  uint32_t const setIndex = window.config.buffers[index];
-
-  LOG_TRACE(L"submitFlip(%d):%u %d", handle, setIndex, index);
-  std::unique_lock lock(m_mutexInt);
-
-  transferDisplay(handle, index, nullptr, 0);
+  auto const mode     = (SceVideoOutFlipMode)flipMode;
+  bool const onVblank =
+      m_vsync && (mode == SceVideoOutFlipMode::VSYNC || mode == SceVideoOutFlipMode::VSYNC_MULTI || mode == SceVideoOutFlipMode::VSYNC_MULTI_2);
+
+  pushFlip(window, FlipRequest {.setIndex     = setIndex,
+                                .bufferIndex  = (uint32_t)index,
+                                .flipArg      = flipArg,
+                                .submitTsc    = accessTimer().queryPerformance(),
+                                .submitVblank = m_vblankCount.load(std::memory_order_acquire),
+                                .onVblank     = onVblank});
+  return Ok;
+}
 
-  auto& flipStatus = m_windows[index].config.flipStatus;
-  ++flipStatus.gcQueueNum;
-  flipStatus.flipArg = flipArg;
+bool VideoOut::reserveFlip(Context& window, bool wait) {
+  while (true) {
+    auto const prepared = window.flipShown.prepare();
 
-  auto&      timer   = accessTimer();
-  auto const curTime = (uint64_t)(1e9 * timer.getTimeS());
+    auto pending = window.flipPendingNum.load(std::memory_order_relaxed);
+    while (pending < (int32_t)m_flipQueueDepth) {
+      if (window.flipPendingNum.compare_exchange_weak(pending, pending + 1, std::memory_order_relaxed)) return true;
+    }
 
-  flipStatus.submitTsc = curTime;
-  // window.config.flipStatus.currentBuffer = index; // set after flip, before vblank
+    if (!wait) return false;
+    window.flipShown.wait(prepared);
+  }
+}
 
-  m_messages.push({MessageType::flip, handle - 1, nullptr, setIndex});
-  lock.unlock();
-  m_condGlfw.notify_one();
+void VideoOut::pushFlip(Context& window, FlipRequest const& flip) {
+  // Never full: the queue holds flipQueueDepth flips and the slot is reserved
+  [[maybe_unused]] bool const pushed = window.submitted->push(flip);
+  assert(pushed);
+  m_wakeup.notify();
 }
 
 void VideoOut::getFlipStatus(int handle, void* status) {
   LOG_USE_MODULE(VideoOut);
   LOG_TRACE(L"%S(%d)", __FUNCTION__, handle);
 
-  std::unique_lock const lock(m_mutexInt);
-  *(SceVideoOutFlipStatus*)status = m_windows[handle - 1].config.flipStatus;
+  auto& window = m_windows[handle - 1];
+
+  SceVideoOutFlipStatus flipStatus {};
+  window.flipStatus.read(flipStatus);
+  flipStatus.gcQueueNum     = window.gcQueueNum.load(std::memory_order_acquire);
+  flipStatus.flipPendingNum = window.flipPendingNum.load(std::memory_order_acquire);
+
+  *(SceVideoOutFlipStatus*)status = flipStatus;
 }
 
 void VideoOut::getVBlankStatus(int handle, void* status) {
@@ -443,21 +602,33 @@ void VideoOut::getVBlankStatus(int handle, void* status) {
   *(SceVideoOutVblankStatus*)status = vblank;
 }
 
-void VideoOut::vblankEnd(int handle, uint64_t curTime, uint64_t curProcTime) {
+void VideoOut::vblank(uint64_t count) {
   OPTICK_EVENT();
 
-  auto& window = m_windows[handle - 1];
-  auto& vblank = window.config.vblankStatus;
+  auto&      timer    = accessTimer();
+  auto const curTime  = (uint64_t)(1e6 * timer.getTimeS());
+  auto const procTime = timer.queryPerformance();
 
-  // vblank.processTime = 0;
+  {
+    std::unique_lock const lock(m_mutexInt);
 
-  vblank.tsc         = curProcTime;
-  vblank.processTime = curTime;
-  ++vblank.count;
+    auto const numVblanks = count - m_vblankCount.load(std::memory_order_relaxed); // > 1: clock thread was stalled
+    for (auto& window: m_windows) {
+      auto& vblank = window.config.vblankStatus;
 
-  for (auto& item: window.eventFlip) {
-    (void)item->triggerEvent(VIDEO_OUT_EVENT_VBLANK, EventQueue::KERNEL_EVFILT_VIDEO_OUT, reinterpret_cast<void*>(window.config.vblankStatus.count));
+      vblank.tsc         = procTime;
+      vblank.processTime = curTime;
+      vblank.count += numVblanks;
+
+      for (auto& item: window.eventVblank) {
+        (void)item->triggerEvent(VIDEO_OUT_EVENT_VBLANK, EventQueue::KERNEL_EVFILT_VIDEO_OUT, reinterpret_cast<void*>(vblank.count));
+      }
+    }
   }
+
+  // After the vblank events: the VideoOut thread shows the vsync flips that waited for it
+  m_vblankCount.store(count, std::memory_order_release);
+  m_wakeup.notify();
 }
 
 void VideoOut::getResolution(int handle, void* status) {
@@ -473,10 +644,8 @@ void VideoOut::getBufferAttribute(void* attribute, uint32_t pixel_format, int32_
   LOG_USE_MODULE(VideoOut);
   LOG_TRACE(L"%S", __FUNCTION__);
 
-  auto [displayFormat, _] = vulkan::getDisplayFormat(m_vulkanObj);
-
   *(SceVideoOutBufferAttribute*)attribute = SceVideoOutBufferAttribute {
-      .pixelFormat  = SceVideoOutPixelFormat::PIXEL_FORMAT_A8R8G8B8_SRGB, // todo get vulkan pixel_format?
+      .pixelFormat  = (SceVideoOutPixelFormat)pixel_format, // the layout depends on it, the swapchain format is used for the copy
       .tilingMode   = tiling_mode,
       .aspectRatio  = aspect_ratio,
       .width        = width,
@@ -497,31 +666,15 @@ int VideoOut::registerBuffers(int handle, int startIndex, void* const* addresses
     return ::Err::VIDEO_OUT_ERROR_NO_EMPTY_SLOT;
   }
 
-  auto& bufferSet = config.bufferSets[setIndex];
-  bufferSet.buffers.resize(numBuffer);
-
   for (int i = startIndex; i < startIndex + numBuffer; ++i) {
     if (config.buffers[i] >= 0) return ::Err::VIDEO_OUT_ERROR_SLOT_OCCUPIED;
     config.buffers[i] = setIndex;
   }
 
-  auto const* _att = (SceVideoOutBufferAttribute const*)attribute;
-
-  for (size_t n = 0; n < numBuffer; ++n) {
-    bufferSet.buffers[n].bufferVaddr           = (uintptr_t)addresses[n];
-    auto const [displaySize, displaySizeAlign] = getDisplayBufferSize(_att->width, _att->height, _att->pitchInPixel, _att->tilingMode, false);
-
-    bufferSet.buffers[n].bufferSize  = displaySize;
-    bufferSet.buffers[n].bufferAlign = displaySizeAlign;
-    LOG_INFO(L"+bufferset[%d] buffer:%d vaddr:0x%08llx", setIndex, n, (uint64_t)addresses[n]);
-
-    auto [format, colorSpace] = vulkan::getDisplayFormat(m_vulkanObj);
-    if (!registerDisplayBuffer(bufferSet.buffers[n].bufferVaddr, VkExtent2D {.width = _att->width, .height = _att->height}, _att->pitchInPixel, format))
-      return -1;
-  }
+  auto const curBuffer = m_presenter->registerBuffers(handle - 1, setIndex, addresses, numBuffer, *(SceVideoOutBufferAttribute const*)attribute);
+  if (curBuffer < 0) return -1;
 
-  config.flipStatus.currentBuffer =
-      createData(m_vulkanObj, m_windows[handle - 1].surface, bufferSet, _att->width, _att->height, accessInitParams()->useVSYNC());
+  m_windows[handle - 1].flipStatus.update([curBuffer](SceVideoOutFlipStatus& status) { status.currentBuffer = curBuffer; });
   return setIndex;
 }
 
@@ -544,139 +697,231 @@ std::pair<VkQueue, uint32_t> VideoOut::getQueue(vulkan::QueueType type) {
   return std::make_pair(bestIt->queue, bestIt->family);
 }
 
-void cbWindow_close(GLFWwindow* window) {
-  // glfwDestroyWindow(window.window);
-  // Todo submit close event, cleanup
-  // m_stop = true;
-  // lock.unlock();
-  // m_condGlfw.notify_one();
-  // m_threadGlfw.join();
-  // // accessGraphics().stop();
-  // m_graphics.reset();
-  // deinitVulkan(m_vulkanObj);
-
-  exit(0); // just hard exit for now.
-           // todo clean shutdown (file syncs etc.)
-}
-
 std::thread VideoOut::createGlfwThread() {
   return std::thread([this] {
     util::setThreadName("VideoOut");
     OPTICK_THREAD("VideoOut");
 
     LOG_USE_MODULE(VideoOut);
-    LOG_DEBUG(L"Init glfw");
 
-    glfwInit();
+    auto const scaling = getOutputScaling(accessInitParams()->getScaling());
+    if (accessInitParams()->isHeadless()) {
+      LOG_INFO(L"headless, no window and gpu");
+      m_presenter = createNullPresenter(accessInitParams()->getFrameDumpDir(), accessInitParams()->getFrameDumpEvery(), scaling);
+    } else {
+      m_presenter = createVulkanPresenter(scaling);
+    }
+    accessScreenShot().setSupported(m_presenter->canCapture());
 
     while (!m_stop) {
-      std::unique_lock lock(m_mutexInt);
-      m_condGlfw.wait_for(lock, std::chrono::microseconds(m_vblankTime), [this] { return m_stop || !m_messages.empty(); });
-      if (m_stop) break;
+      auto const prepared = m_wakeup.prepare();
+
+      processMessages();
+      processFlips();
+      processStats();
+
+      {
+        std::unique_lock const lock(m_mutexInt);
+        m_presenter->pollEvents(); // once for all flips since the last wakeup, at least every vblank
+      }
+
+      // Until something was pushed or a vblank passed since prepare()
+      m_wakeup.wait(prepared);
+    }
+    m_presenter.reset();
+  });
+}
+
+void VideoOut::processMessages() {
+  LOG_USE_MODULE(VideoOut);
+  std::unique_lock const lock(m_mutexInt);
+
+  for (; !m_messages.empty(); m_messages.pop()) {
+    auto const  item   = m_messages.front();
+    auto const  index  = item.windowIndex;
+    auto const& window = m_windows[index];
 
-      // Handle VBlank
-      if (m_messages.empty()) {
-        using namespace std::chrono;
+    switch (item.type) {
+      case MessageType::open: {
 
-        auto&      timer    = accessTimer();
-        auto const curTime  = (uint64_t)(1e6 * timer.getTimeS());
-        auto const procTime = timer.queryPerformance();
-        for (size_t n = 0; n < m_windows.size(); ++n) {
+        auto const title = getTitle(index, {}, window.fliprate);
 
-          vblankEnd(1 + n, curTime, procTime);
+        auto const [width, height] = m_presenter->open(index, title, m_outputWidth, m_outputHeight);
+
+        LOG_INFO(L"--> VideoOut Open(%S)| %u:%u", title.c_str(), width, height);
+        if (!m_graphics) {
+          m_vulkanObj = m_presenter->getVulkan();
+          m_graphics  = pm4Capture::wrap(m_presenter->createGraphics(*this));
         }
-        continue;
-      }
-      // -
-
-      auto       item   = m_messages.front();
-      auto const index  = item.windowIndex;
-      auto&      window = m_windows[index];
-
-      switch (item.type) {
-        case MessageType::open: {
-
-          auto const title = getTitle(index, 0, 0, window.fliprate);
-
-          glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-          glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-          glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-          window.window = glfwCreateWindow(m_widthTotal, m_heightTotal, title.c_str(), nullptr, nullptr);
-
-          glfwMakeContextCurrent(window.window);
-          glfwShowWindow(window.window);
-
-          glfwGetWindowSize(window.window, (int*)(&window.config.resolution.paneWidth), (int*)(&window.config.resolution.paneHeight));
-
-          LOG_INFO(L"--> VideoOut Open(%S)| %d:%d", title.c_str(), window.config.resolution.paneWidth, window.config.resolution.paneHeight);
-          if (m_vulkanObj == nullptr) {
-            m_vulkanObj = vulkan::initVulkan(window.window, window.surface, accessInitParams()->enableValidation());
-            auto& info  = m_vulkanObj->deviceInfo;
-
-            m_graphics = createGraphics(*this, info.device, info.physicalDevice, info.instance);
-          } else {
-            vulkan::createSurface(m_vulkanObj, window.window, window.surface);
-          }
-
-          glfwSetWindowCloseCallback(window.window, cbWindow_close);
-
-          *item.done = true;
-          m_condDone.notify_one();
-        } break;
-        case MessageType::close: {
-          glfwDestroyWindow(window.window);
-          *item.done = true;
-          m_condDone.notify_one();
-        } break;
-        case MessageType::flip: {
-          LOG_TRACE(L"-> flip(%d) set:%u buffer:%u", index, item.index, window.config.flipStatus.currentBuffer);
-          OPTICK_FRAME("VideoOut");
-          auto& flipStatus = window.config.flipStatus;
-          using namespace std::chrono;
-
-          lock.unlock();
-          {
-            OPTICK_EVENT("Present");
-            presentImage(m_vulkanObj, window.config.bufferSets[item.index], (uint32_t&)window.config.flipStatus.currentBuffer);
-          }
-          m_graphics->submitDone();
-          lock.lock();
-
-          auto&      timer      = accessTimer();
-          auto const curTime    = (uint64_t)(1e6 * timer.getTimeS());
-          auto const procTime   = timer.queryPerformance();
-          auto       elapsed_us = curTime - flipStatus.processTime;
-
-          flipStatus.tsc         = procTime;
-          flipStatus.processTime = curTime;
-          ++flipStatus.count;
-          --flipStatus.gcQueueNum;
-          vblankEnd(1 + index, curTime, procTime);
-
-          // Trigger Event Flip
-          for (auto& item: window.eventFlip) {
-            (void)item->triggerEvent(VIDEO_OUT_EVENT_FLIP, EventQueue::KERNEL_EVFILT_VIDEO_OUT, reinterpret_cast<void*>(window.config.flipStatus.flipArg));
-          }
-          // - Flip event
-
-          double const fps   = (window.config.fps * 5.0 + (1e6 / (double)elapsed_us)) / 6.0;
-          auto         title = getTitle(index + 1, flipStatus.count, round(fps), window.fliprate);
-
-          window.config.fps = fps;
-
-          glfwSetWindowTitle(window.window, title.c_str());
-          glfwPollEvents();
-          LOG_TRACE(L"<- flip(%d) set:%u buffer:%u", index, item.index, window.config.flipStatus.currentBuffer);
-        } break;
+
+        *item.done = true;
+        m_condDone.notify_one();
+      } break;
+      case MessageType::close: {
+        dropFlips(index);
+        m_presenter->close(index);
+        *item.done = true;
+        m_condDone.notify_one();
+      } break;
+    }
+  }
+}
+
+void VideoOut::processFlips() {
+  auto const vblankCount = m_vblankCount.load(std::memory_order_acquire);
+
+  for (int n = 0; n < m_windows.size(); ++n) {
+    auto& window = m_windows[n];
+
+    FlipRequest flip;
+    while (window.submitted->pop(flip)) {
+      window.flipQueue.push_back(flip);
+    }
+
+    while (!window.flipQueue.empty()) {
+      auto const& front = window.flipQueue.front();
+
+      uint64_t missedVblanks = 0;
+      if (front.onVblank) {
+        // One vsync flip per vblank after its submit, at most every fliprate-th
+        auto const interval = getFlipInterval(window.fliprate);
+        if (vblankCount <= front.submitVblank || vblankCount - window.lastFlipVblank < interval) break;
+
+        missedVblanks         = vblankCount - std::max(front.submitVblank + 1, window.lastFlipVblank + interval);
+        window.lastFlipVblank = vblankCount;
       }
-      m_messages.pop();
+
+      doFlip(n, front, missedVblanks);
+      window.flipQueue.pop_front();
     }
-    glfwTerminate();
+  }
+}
+
+void VideoOut::dropFlips(int index) {
+  auto& window = m_windows[index];
+
+  FlipRequest flip;
+  while (window.submitted->pop(flip)) {
+    window.flipQueue.push_back(flip);
+  }
+
+  int32_t numGpu = 0;
+  for (auto const& item: window.flipQueue) {
+    m_graphics->submitDone();
+    if (item.fromGpu) ++numGpu;
+  }
+  window.gcQueueNum.fetch_sub(numGpu, std::memory_order_release);
+  window.flipPendingNum.fetch_sub((int32_t)window.flipQueue.size(), std::memory_order_release);
+  window.flipShown.notify();
+  window.flipQueue.clear();
+
+  window.flipStatus.update([](SceVideoOutFlipStatus& status) { status = {}; });
+  window.lastFlipVblank = 0;
+  window.lastFlipTime   = {};
+}
+
+void VideoOut::processStats() {
+  LOG_USE_MODULE(VideoOut);
+  using namespace std::chrono;
+
+  // At a fixed rate instead of every flip: the title is a round trip to the window system
+  auto const now = steady_clock::now();
+  if (m_statsInterval.count() == 0 || now - m_statsTime < m_statsInterval) return;
+
+  auto const hleCalls     = hleStats::getNumCalls();
+  auto const hleCallsPerS = (double)(hleCalls - m_statsHleCalls) / duration<double>(now - m_statsTime).count();
+
+  m_statsTime     = now;
+  m_statsHleCalls = hleCalls;
+
+  std::unique_lock const lock(m_mutexInt);
+  for (int n = 0; n < m_windows.size(); ++n) {
+    auto& window = m_windows[n];
+    if (window.userId < 0) continue;
+
+    auto const stats = window.stats.publish(now, hleCallsPerS);
+    m_presenter->setTitle(n, getTitle(n, stats, window.fliprate));
+
+    if (m_statsLog) {
+      LOG_INFO(L"stats(%d) fps:%.1f frame:%.2fms(max:%.2f) latency:%.2fms(max:%.2f) submits:%.1f/s rejected:%llu missed vblanks:%llu(%.1f/s) hle:%.0f/s", n,
+               stats.fps, stats.frameMs, stats.maxFrameMs, stats.latencyMs, stats.maxLatencyMs, stats.submitsPerS, stats.numRejected, stats.vblankMisses,
+               stats.vblankMissesPerS, stats.hleCallsPerS);
+    }
+  }
+}
+
+void VideoOut::doFlip(int index, FlipRequest const& flip, uint64_t missedVblanks) {
+  OPTICK_FRAME("VideoOut");
+  LOG_USE_MODULE(VideoOut);
+  LOG_TRACE(L"-> flip(%d) set:%u buffer:%u", index, flip.setIndex, flip.bufferIndex);
+  using namespace std::chrono;
+
+  auto& window = m_windows[index];
+
+  SceVideoOutFlipStatus prevStatus {};
+  window.flipStatus.read(prevStatus);
+
+  auto const flipStart = steady_clock::now();
+
+  m_presenter->present(index, flip.setIndex, flip.bufferIndex, flip.waitSema, flip.waitValue);
+  auto const presentEnd = steady_clock::now();
+
+  // Before the flip event, the buffer may be reused after it
+  if (auto frame = accessScreenShot().beginCapture(index + 1, prevStatus.count + 1)) {
+    bool const captured = m_presenter->capture(index, flip.setIndex, flip.bufferIndex, *frame);
+    accessScreenShot().endCapture(std::move(frame), captured);
+  }
+  m_graphics->submitDone();
+
+  auto&      timer    = accessTimer();
+  auto const curTime  = (uint64_t)(1e6 * timer.getTimeS());
+  auto const procTime = timer.queryPerformance();
+
+  window.flipStatus.update([&](SceVideoOutFlipStatus& status) {
+    status.flipArg       = flip.flipArg;
+    status.submitTsc     = flip.submitTsc;
+    status.currentBuffer = flip.bufferIndex;
+    status.tsc           = procTime;
+    status.processTime   = curTime;
+    ++status.count;
   });
+  if (flip.fromGpu) window.gcQueueNum.fetch_sub(1, std::memory_order_release);
+  window.flipPendingNum.fetch_sub(1, std::memory_order_release);
+  window.flipShown.notify();
+
+  auto const frameNs   = window.lastFlipTime.time_since_epoch().count() > 0 ? duration_cast<nanoseconds>(presentEnd - window.lastFlipTime).count() : 0;
+  auto const latencyNs = (double)(procTime - flip.submitTsc) * 1e9 / (double)timer.getFrequency();
+  window.stats.onFlip(frameNs, (uint64_t)latencyNs, missedVblanks);
+  window.lastFlipTime = presentEnd;
+
+  std::unique_lock const lock(m_mutexInt);
+
+  // Trigger Event Flip
+  for (auto& eq: window.eventFlip) {
+    (void)eq->triggerEvent(VIDEO_OUT_EVENT_FLIP, EventQueue::KERNEL_EVFILT_VIDEO_OUT, reinterpret_cast<void*>(flip.flipArg));
+  }
+  // - Flip event
+
+  auto&      flipTimes = window.flipTimes;
+  auto const flipNs    = duration_cast<nanoseconds>(steady_clock::now() - flipStart).count();
+  ++flipTimes.numFlips;
+  flipTimes.flipNs += flipNs;
+  flipTimes.presentNs += duration_cast<nanoseconds>(presentEnd - flipStart).count();
+  flipTimes.maxFlipNs = std::max<uint64_t>(flipTimes.maxFlipNs, flipNs);
+  if (flipTimes.numFlips % 1024 == 0) {
+    LOG_DEBUG(L"flip(%d) thread time avg:%.1fus (present:%.1fus) max:%.1fus", index, 1e-3 * (double)flipTimes.flipNs / (double)flipTimes.numFlips,
+              1e-3 * (double)flipTimes.presentNs / (double)flipTimes.numFlips, 1e-3 * (double)flipTimes.maxFlipNs);
+  }
+
+  LOG_TRACE(L"<- flip(%d) set:%u buffer:%u latency:%lluus", index, flip.setIndex, flip.bufferIndex,
+            (procTime - flip.submitTsc) * 1000000 / timer.getFrequency());
 }
 
 uint64_t getImageAlignment(VkFormat format, VkExtent3D const& extent) {
-  auto device = ((VideoOut&)accessVideoOut()).getDeviceInfo()->device;
+  auto deviceInfo = ((VideoOut&)accessVideoOut()).getDeviceInfo();
+  if (deviceInfo == nullptr) return 64 * 1024; // headless, alignment of tiled display buffers
+
+  auto device = deviceInfo->device;
 
   VkImageCreateInfo const imageInfo {
       .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
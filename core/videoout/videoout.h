@@ -3,6 +3,7 @@
 #include "core/kernel/eventqueue_types.h"
 
 #include <mutex>
+#include <stdint.h>
 #include <utility/utility.h>
 
 namespace vulkan {
@@ -14,6 +15,39 @@ constexpr int VIDEO_OUT_EVENT_VBLANK = 1;
 
 class IGLFW {};
 
+/**
+ * @brief Time the VideoOut thread spent on the flips of a window
+ *
+ */
+struct VideoOutFlipTimes {
+  uint64_t numFlips  = 0;
+  uint64_t flipNs    = 0; // whole flip: present, screenshot copy, status and events
+  uint64_t presentNs = 0; // part spent in the presenter: copy, present and waits for a swapchain image
+  uint64_t maxFlipNs = 0;
+};
+
+/**
+ * @brief Flip statistics of a window, updated every --statsInterval ms by the VideoOut thread
+ *
+ */
+struct VideoOutStats {
+  uint64_t numFlips     = 0;
+  uint64_t numSubmits   = 0; // cpu and gpu flips
+  uint64_t numRejected  = 0; // flip queue full
+  uint64_t vblankMisses = 0; // vblanks the vsync flips were shown after their due one
+
+  // Interval before the last update
+  double intervalS        = 0.0;
+  double fps              = 0.0;
+  double frameMs          = 0.0; // flip to flip
+  double maxFrameMs       = 0.0;
+  double latencyMs        = 0.0; // submit to shown
+  double maxLatencyMs     = 0.0;
+  double submitsPerS      = 0.0;
+  double vblankMissesPerS = 0.0;
+  double hleCallsPerS     = 0.0; // all threads, --hleStats only
+};
+
 class IGraphics;
 
 class IVideoOut {
@@ -48,10 +82,10 @@ class IVideoOut {
   virtual void close(int handle) = 0;
 
   /**
-   * @brief Set the fps to use
+   * @brief Set the fps to use, vsync flips are shown every 1/2/3 vblanks
    *
    * @param handle
-   * @param rate
+   * @param rate 0: 60Hz, 1: 30Hz, 2: 20Hz
    */
   virtual void setFliprate(int handle, int rate) = 0;
 
@@ -75,15 +109,17 @@ class IVideoOut {
   virtual void removeEvent(int handle, Kernel::EventQueue::IKernelEqueue_t eq, int const ident) = 0;
 
   /**
-   * @brief Submit flip video buffers to the queue
+   * @brief Submit flip video buffers to the queue. Lock-free, doesn't wait for the VideoOut thread
    *
    * @param index
+   * @param flipMode SceVideoOutFlipMode, vsync modes wait for their vblank, the others are shown immediately
    * @param flipArg used by the flip event
+   * @return int VIDEO_OUT_ERROR_FLIP_QUEUE_FULL if flipQueueDepth flips are pending
    */
-  virtual void submitFlip(int handle, int index, int64_t flipArg) = 0;
+  virtual int submitFlip(int handle, int index, int flipMode, int64_t flipArg) = 0;
 
   /**
-   * @brief Get the Flip Status
+   * @brief Get the Flip Status. Lock-free, published by the VideoOut thread after every flip
    *
    * @param handle
    * @param status
@@ -91,7 +127,7 @@ class IVideoOut {
   virtual void getFlipStatus(int handle, void* status) = 0;
 
   /**
-   * @brief Get the VBlank Status (currently faked by a timer)
+   * @brief Get the VBlank Status
    *
    * @param handle
    * @param status
@@ -107,13 +143,29 @@ class IVideoOut {
   virtual void getResolution(int handle, void* status) = 0;
 
   /**
-   * @brief Get the number of unhandled flip submits
+   * @brief Get the number of flips submitted and not shown yet
    *
    * @param handle
    * @return int
    */
   virtual int getPendingFlips(int handle) = 0;
 
+  /**
+   * @brief Get the time spent per flip on the VideoOut thread
+   *
+   * @param handle
+   * @return VideoOutFlipTimes
+   */
+  virtual VideoOutFlipTimes getFlipTimes(int handle) = 0;
+
+  /**
+   * @brief Get the flip statistics of the last update, doesn't wait for the VideoOut thread
+   *
+   * @param handle
+   * @return VideoOutStats
+   */
+  virtual VideoOutStats getStats(int handle) = 0;
+
   /**
    * @brief Get the video Buffer Attributes
    *
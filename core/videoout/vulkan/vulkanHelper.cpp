@@ -45,20 +45,59 @@ std::pair<VkFormat, VkColorSpaceKHR> getDisplayFormat(VulkanObj* obj) {
   return {format, imageColorSpace};
 }
 
-uint32_t createData(VulkanObj* obj, VkSurfaceKHR surface, vulkan::SwapchainData& swapchainData, uint32_t width, uint32_t height, bool enableVsync) {
+VkPresentModeKHR getPresentMode(VulkanObj* obj, VkPresentModeKHR requested) {
   LOG_USE_MODULE(vulkanHelper);
 
-  uint32_t const numBuffers = swapchainData.buffers.size();
+  auto const& modes = obj->surfaceCapabilities.presentModes;
+  if (std::find(modes.begin(), modes.end(), requested) != modes.end()) return requested;
 
-  if (numBuffers > obj->surfaceCapabilities.capabilities.maxImageCount || numBuffers < obj->surfaceCapabilities.capabilities.minImageCount) {
-    LOG_CRIT(L"numBuffers:%d outside %d:%d", numBuffers, obj->surfaceCapabilities.capabilities.minImageCount,
-             obj->surfaceCapabilities.capabilities.maxImageCount);
+  LOG_WARN(L"present mode %S not supported, using fifo", string_VkPresentModeKHR(requested));
+  return VK_PRESENT_MODE_FIFO_KHR; // always supported
+}
+
+namespace {
+void destroyImages(VulkanObj* obj, SwapchainData& swapchainData) {
+  auto device = obj->deviceInfo.device;
+  for (auto& item: swapchainData.images) {
+    for (auto& transfer: item.transfers) {
+      if (transfer.cmdBuffer != nullptr) vkFreeCommandBuffers(device, swapchainData.commandPool, 1, &transfer.cmdBuffer);
+    }
+    vkDestroySemaphore(device, item.semPresentReady, nullptr);
+  }
+  for (auto sem: swapchainData.semAcquire) {
+    vkDestroySemaphore(device, sem, nullptr);
+  }
+
+  swapchainData.images.clear();
+  swapchainData.semAcquire.clear();
+  swapchainData.nextAcquire   = 0;
+  swapchainData.acquiredImage = SwapchainData::NO_IMAGE;
+  swapchainData.acquiredSema  = nullptr;
+}
+
+/**
+ * @brief Swapchain for the current surface size, replaces (and destroys) the old one
+ *
+ * @return false if the surface has no size or on error
+ */
+bool createSwapchain(VulkanObj* obj, VkSurfaceKHR surface, SwapchainData& swapchainData, uint32_t width, uint32_t height) {
+  LOG_USE_MODULE(vulkanHelper);
+
+  auto const device = obj->deviceInfo.device;
+  auto&      caps   = obj->surfaceCapabilities.capabilities;
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(obj->deviceInfo.physicalDevice, surface, &caps); // extent follows the window
+
+  if (caps.currentExtent.width != UINT32_MAX) {
+    swapchainData.extent2d = caps.currentExtent;
+  } else {
+    swapchainData.extent2d.width  = std::clamp(width, caps.minImageExtent.width, caps.maxImageExtent.width);
+    swapchainData.extent2d.height = std::clamp(height, caps.minImageExtent.height, caps.maxImageExtent.height);
   }
+  if (swapchainData.extent2d.width == 0 || swapchainData.extent2d.height == 0) return false; // minimized
 
-  swapchainData.extent2d.width =
-      std::clamp(width, obj->surfaceCapabilities.capabilities.minImageExtent.width, obj->surfaceCapabilities.capabilities.maxImageExtent.width);
-  swapchainData.extent2d.height =
-      std::clamp(height, obj->surfaceCapabilities.capabilities.minImageExtent.height, obj->surfaceCapabilities.capabilities.maxImageExtent.height);
+  // Images are decoupled from the display buffers, their count only has to be in the limits of the surface
+  uint32_t numImages = std::max((uint32_t)swapchainData.buffers.size(), caps.minImageCount);
+  if (caps.maxImageCount > 0) numImages = std::min(numImages, caps.maxImageCount);
 
   auto [displayFormat, displayColorSpace] = getDisplayFormat(obj);
   swapchainData.format                    = displayFormat;
@@ -68,7 +107,7 @@ uint32_t createData(VulkanObj* obj, VkSurfaceKHR surface, vulkan::SwapchainData&
       .pNext                 = nullptr,
       .flags                 = 0,
       .surface               = surface,
-      .minImageCount         = numBuffers,
+      .minImageCount         = numImages,
       .imageFormat           = swapchainData.format,
       .imageColorSpace       = displayColorSpace,
       .imageExtent           = swapchainData.extent2d,
@@ -77,36 +116,64 @@ uint32_t createData(VulkanObj* obj, VkSurfaceKHR surface, vulkan::SwapchainData&
       .imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 0,
       .pQueueFamilyIndices   = nullptr,
-      .preTransform          = obj->surfaceCapabilities.capabilities.currentTransform,
+      .preTransform          = caps.currentTransform,
       .compositeAlpha        = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-      .presentMode           = enableVsync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR,
+      .presentMode           = swapchainData.presentMode,
       .clipped               = VK_TRUE,
-      .oldSwapchain          = nullptr,
+      .oldSwapchain          = swapchainData.swapchain,
   };
 
-  vkCreateSwapchainKHR(obj->deviceInfo.device, &createInfo, nullptr, &swapchainData.swapchain);
+  if (swapchainData.swapchain != nullptr) {
+    // The old images may still be used by transfers and presents
+    vkQueueWaitIdle(obj->queues.items[getIndex(QueueType::graphics)][0].queue);
+    vkQueueWaitIdle(obj->queues.items[getIndex(QueueType::present)][0].queue);
+  }
 
-  uint32_t numImages = numBuffers;
-  vkGetSwapchainImagesKHR(obj->deviceInfo.device, swapchainData.swapchain, &numImages, nullptr);
-  BOOST_ASSERT_MSG(numImages == numBuffers, "Swapchain created more images");
+  VkSwapchainKHR swapchain = nullptr;
+  if (auto result = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain); result != VK_SUCCESS) {
+    LOG_ERR(L"Couldn't create swapchain: %S", string_VkResult(result));
+    return false;
+  }
 
-  { // Create Semaphore + imageView
-    std::vector<VkImage> images(numImages);
-    vkGetSwapchainImagesKHR(obj->deviceInfo.device, swapchainData.swapchain, &numImages, images.data());
+  invalidateTransfers(swapchainData); // recorded for the old images
+  destroyImages(obj, swapchainData);
+  if (swapchainData.swapchain != nullptr) vkDestroySwapchainKHR(device, swapchainData.swapchain, nullptr);
+  swapchainData.swapchain = swapchain;
 
-    VkSemaphoreCreateInfo const semCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = 0,
-        .flags = 0,
-    };
+  vkGetSwapchainImagesKHR(device, swapchain, &numImages, nullptr);
+  std::vector<VkImage> images(numImages);
+  vkGetSwapchainImagesKHR(device, swapchain, &numImages, images.data());
 
-    for (uint8_t i = 0; i < numImages; ++i) {
-      swapchainData.buffers[i].image = images[i];
-      vkCreateSemaphore(obj->deviceInfo.device, &semCreateInfo, nullptr, &swapchainData.buffers[i].semDisplayReady);
-      vkCreateSemaphore(obj->deviceInfo.device, &semCreateInfo, nullptr, &swapchainData.buffers[i].semPresentReady);
-    }
+  VkSemaphoreCreateInfo const semCreateInfo {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = 0,
+      .flags = 0,
+  };
+
+  swapchainData.images.resize(numImages);
+  for (uint32_t i = 0; i < numImages; ++i) {
+    auto& item = swapchainData.images[i];
+    item.image = images[i];
+    vkCreateSemaphore(device, &semCreateInfo, nullptr, &item.semPresentReady);
   }
 
+  swapchainData.semAcquire.resize(numImages + 1);
+  for (auto& sem: swapchainData.semAcquire) {
+    vkCreateSemaphore(device, &semCreateInfo, nullptr, &sem);
+  }
+
+  swapchainData.outOfDate = false;
+  LOG_INFO(L"swapchain %ux%u images:%u mode:%S", swapchainData.extent2d.width, swapchainData.extent2d.height, numImages,
+           string_VkPresentModeKHR(swapchainData.presentMode));
+  return true;
+}
+} // namespace
+
+void createData(VulkanObj* obj, VkSurfaceKHR surface, vulkan::SwapchainData& swapchainData, uint32_t width, uint32_t height, VkPresentModeKHR presentMode) {
+  LOG_USE_MODULE(vulkanHelper);
+
+  swapchainData.presentMode = presentMode;
+
   // Flip data
   {
     VkCommandPoolCreateInfo const poolInfo {
@@ -119,41 +186,47 @@ uint32_t createData(VulkanObj* obj, VkSurfaceKHR surface, vulkan::SwapchainData&
       LOG_CRIT(L"Couldn't create commandpool(graphics): %d", result);
     }
   }
-  {
-    VkCommandBufferAllocateInfo const allocInfo {
-        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool        = swapchainData.commandPool,
-        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
+  // - Flip Data
 
-    for (uint8_t i = 0; i < numImages; ++i) {
-      if (auto result = vkAllocateCommandBuffers(obj->deviceInfo.device, &allocInfo, &swapchainData.buffers[i].transferBuffer); result != VK_SUCCESS) {
-        LOG_CRIT(L"Couldn't create commandbuffers(graphics): %d", result);
-      }
-    }
+  if (!createSwapchain(obj, surface, swapchainData, width, height)) {
+    swapchainData.outOfDate = true; // retried before the first present
+    return;
   }
-  // - Flip Data
 
-  uint32_t curBufferIndex = 0;
-  // Get first display buffer
-  while (true) {
-    auto result = vkAcquireNextImageKHR(obj->deviceInfo.device, swapchainData.swapchain, UINT64_MAX, swapchainData.buffers[curBufferIndex].semDisplayReady,
-                                        VK_NULL_HANDLE, &curBufferIndex);
-    if (result != VK_SUCCESS) {
-      if (result == VK_NOT_READY) {
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(100ms); // Not init yet or whatever
-        continue;
-      } else
-        LOG_CRIT(L"vkAcquireNextImageKHR err:%S", string_VkResult(result));
-    }
-    break;
+  // First image, the next ones are acquired after each present
+  acquireImage(obj, swapchainData, UINT64_MAX);
+}
+
+bool recreateSwapchain(VulkanObj* obj, VkSurfaceKHR surface, SwapchainData& swapchainData, uint32_t width, uint32_t height) {
+  OPTICK_EVENT();
+  if (!createSwapchain(obj, surface, swapchainData, width, height)) return false;
+
+  ++swapchainData.presentStats.numRecreations;
+  return true;
+}
+
+bool acquireImage(VulkanObj* obj, SwapchainData& swapchain, uint64_t timeoutNs) {
+  LOG_USE_MODULE(vulkanHelper);
+
+  if (swapchain.acquiredImage != SwapchainData::NO_IMAGE) return true;
+  if (swapchain.swapchain == nullptr || swapchain.outOfDate) return false;
+
+  auto const sema   = swapchain.semAcquire[swapchain.nextAcquire];
+  uint32_t   index  = 0;
+  auto const result = vkAcquireNextImageKHR(obj->deviceInfo.device, swapchain.swapchain, timeoutNs, sema, VK_NULL_HANDLE, &index);
+  switch (result) {
+    case VK_SUCCESS:
+    case VK_SUBOPTIMAL_KHR: break; // still usable, present() reports it again
+    case VK_NOT_READY:
+    case VK_TIMEOUT: return false;
+    case VK_ERROR_OUT_OF_DATE_KHR: swapchain.outOfDate = true; return false;
+    default: LOG_ERR(L"vkAcquireNextImageKHR err:%S", string_VkResult(result)); return false;
   }
-  // -
-  BOOST_ASSERT_MSG(curBufferIndex == 0, "AcquireNextImage init returned unexpected value");
 
-  return curBufferIndex;
+  swapchain.acquiredImage = index;
+  swapchain.acquiredSema  = sema;
+  swapchain.nextAcquire   = (swapchain.nextAcquire + 1) % swapchain.semAcquire.size();
+  return true;
 }
 
 void submitDisplayTransfer(VkCommandBuffer cmdBuffer, VulkanObj* obj, VkSemaphore semPresentReady, VkSemaphore displayReady, VkSemaphore waitSema,
@@ -192,10 +265,43 @@ void submitDisplayTransfer(VkCommandBuffer cmdBuffer, VulkanObj* obj, VkSemaphor
   }
 }
 
-void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::SwapchainData& swapchain, VkImage displayImage, IGpuImageObject* image,
-                      uint32_t index) {
+VkCommandBuffer transfer2Display(VulkanObj* obj, vulkan::SwapchainData& swapchain, VkImage displayImage, IGpuImageObject* image, uint32_t bufferIndex,
+                                 uint32_t imageIndex, VkRect2D const& dstRect) {
   LOG_USE_MODULE(vulkanHelper);
 
+  auto& target = swapchain.images[imageIndex];
+  if (bufferIndex >= target.transfers.size()) target.transfers.resize(bufferIndex + 1);
+  auto& transfer = target.transfers[bufferIndex];
+
+  if (transfer.cmdBuffer == nullptr) {
+    VkCommandBufferAllocateInfo const allocInfo {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = swapchain.commandPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    if (auto result = vkAllocateCommandBuffers(obj->deviceInfo.device, &allocInfo, &transfer.cmdBuffer); result != VK_SUCCESS) {
+      LOG_ERR(L"Couldn't create commandbuffers(graphics): %d", result);
+      transfer.cmdBuffer = nullptr;
+      return nullptr;
+    }
+  }
+
+  auto const cmdBuffer = transfer.cmdBuffer;
+  auto const srcLayout = image->getImageLayout();
+  image->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+  if (transfer.recordedSrc == displayImage && transfer.recordedSrcLayout == srcLayout && transfer.recordedDst.offset.x == dstRect.offset.x &&
+      transfer.recordedDst.offset.y == dstRect.offset.y && transfer.recordedDst.extent.width == dstRect.extent.width &&
+      transfer.recordedDst.extent.height == dstRect.extent.height) {
+    ++swapchain.transferStats.numReused;
+    return cmdBuffer;
+  }
+
+  OPTICK_EVENT("RecordTransfer");
+  auto const start = std::chrono::steady_clock::now();
+
   vkResetCommandBuffer(cmdBuffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
 
   // Transfer
@@ -214,7 +320,7 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
                                         .pNext               = nullptr,
                                         .srcAccessMask       = 0,
                                         .dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT,
-                                        .oldLayout           = image->getImageLayout(),
+                                        .oldLayout           = srcLayout,
                                         .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
                                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -223,7 +329,6 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
                                         .subresourceRange = image->getSubresource()};
 
     vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    image->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
   }
 
   {
@@ -237,12 +342,36 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 
-        .image            = swapchain.buffers[index].image,
+        .image            = target.image,
         .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
 
     vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
   }
 
+  bool const coversTarget = dstRect.offset.x <= 0 && dstRect.offset.y <= 0 && dstRect.offset.x + (int64_t)dstRect.extent.width >= swapchain.extent2d.width &&
+                            dstRect.offset.y + (int64_t)dstRect.extent.height >= swapchain.extent2d.height;
+  if (!coversTarget) {
+    // Black bars: clear all, the blit overwrites the inside
+    VkClearColorValue const       black {};
+    VkImageSubresourceRange const range {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1};
+    vkCmdClearColorImage(cmdBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+
+    VkImageMemoryBarrier const barrier {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = nullptr,
+        .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+
+        .image            = target.image,
+        .subresourceRange = range};
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  }
+
   VkImageBlit const blit {
       .srcSubresource =
           {
@@ -251,7 +380,7 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
               .baseArrayLayer = 0,
               .layerCount     = 1,
           },
-      .srcOffsets = {{0, 0, 0}, {(int32_t)swapchain.extent2d.width, (int32_t)swapchain.extent2d.height, 1}},
+      .srcOffsets = {{0, 0, 0}, {(int32_t)image->getExtent().width, (int32_t)image->getExtent().height, 1}},
       .dstSubresource =
           {
               .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -259,11 +388,11 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
               .baseArrayLayer = 0,
               .layerCount     = 1,
           },
-      .dstOffsets = {{0, 0, 0}, {(int32_t)swapchain.extent2d.width, (int32_t)swapchain.extent2d.height, 1}},
+      .dstOffsets = {{dstRect.offset.x, dstRect.offset.y, 0},
+                     {dstRect.offset.x + (int32_t)dstRect.extent.width, dstRect.offset.y + (int32_t)dstRect.extent.height, 1}},
   };
 
-  vkCmdBlitImage(cmdBuffer, displayImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain.buffers[index].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
-                 VK_FILTER_LINEAR);
+  vkCmdBlitImage(cmdBuffer, displayImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
 
   {
     // Change to Present Layout
@@ -277,7 +406,7 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 
-        .image            = swapchain.buffers[index].image,
+        .image            = target.image,
         .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
 
     vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
@@ -289,34 +418,60 @@ void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::Swapcha
     LOG_CRIT(L"Couldn't end commandbuffer");
   }
   // -
+
+  transfer.recordedSrc       = displayImage;
+  transfer.recordedSrcLayout = srcLayout;
+  transfer.recordedDst       = dstRect;
+
+  auto& stats = swapchain.transferStats;
+  ++stats.numRecorded;
+  stats.recordNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return cmdBuffer;
+}
+
+void invalidateTransfers(SwapchainData& swapchain) {
+  for (auto& item: swapchain.images) {
+    for (auto& transfer: item.transfers) {
+      transfer.recordedSrc = nullptr;
+    }
+  }
 }
 
-void presentImage(VulkanObj* obj, vulkan::SwapchainData& swapchain, uint32_t& index) {
+void presentImage(VulkanObj* obj, vulkan::SwapchainData& swapchain) {
   LOG_USE_MODULE(vulkanHelper);
 
+  uint32_t const index = swapchain.acquiredImage;
+
   VkPresentInfoKHR const presentInfo {
       .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .pNext              = nullptr,
       .waitSemaphoreCount = 1,
-      .pWaitSemaphores    = &swapchain.buffers[index].semPresentReady,
+      .pWaitSemaphores    = &swapchain.images[index].semPresentReady,
       .swapchainCount     = 1,
       .pSwapchains        = &swapchain.swapchain,
       .pImageIndices      = &index,
       .pResults           = nullptr,
   };
 
+  VkResult result;
   {
     OPTICK_GPU_FLIP(&swapchain.swapchain);
     OPTICK_CATEGORY("Present", Optick::Category::Wait);
-    vkQueuePresentKHR(obj->queues.items[getIndex(QueueType::present)][0].queue, &presentInfo);
+    result = vkQueuePresentKHR(obj->queues.items[getIndex(QueueType::present)][0].queue, &presentInfo);
   }
 
-  uint32_t swapchainIndex = ++index;
-  if (swapchainIndex >= swapchain.buffers.size()) swapchainIndex = 0;
-  auto result =
-      vkAcquireNextImageKHR(obj->deviceInfo.device, swapchain.swapchain, UINT64_MAX, swapchain.buffers[swapchainIndex].semDisplayReady, VK_NULL_HANDLE, &index);
+  swapchain.acquiredImage = SwapchainData::NO_IMAGE;
+  swapchain.acquiredSema  = nullptr;
+  ++swapchain.presentStats.numPresents;
+
+  if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR) {
+    swapchain.outOfDate = true;
+  } else if (result != VK_SUCCESS) {
+    LOG_ERR(L"vkQueuePresentKHR err:%S", string_VkResult(result));
+  }
 
-  BOOST_ASSERT_MSG(swapchainIndex == index, "AcquireNextImage returned unexpected value");
+  // Next image without waiting. If none is free yet, the next present waits for it
+  acquireImage(obj, swapchain, 0);
 }
 } // namespace vulkan
 
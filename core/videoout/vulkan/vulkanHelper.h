@@ -8,10 +8,35 @@ namespace vulkan {
 void submitDisplayTransfer(VkCommandBuffer cmdBuffer, VulkanObj* obj, VkSemaphore semPresentReady, VkSemaphore displayReady, VkSemaphore waitSema,
                            size_t waitValue);
 
-void transfer2Display(VkCommandBuffer cmdBuffer, VulkanObj* obj, vulkan::SwapchainData& swapchain, VkImage displayImage, IGpuImageObject* image,
-                      uint32_t index);
+/**
+ * @brief Copy of display buffer bufferIndex (displayImage) to swapchain image imageIndex, scaled to dstRect. The rest of the image is black.
+ * Every (display buffer, swapchain image) pair has its own command buffer, it is only recorded if the image, its layout or dstRect
+ * changed since the last use of the pair
+ *
+ * @return the command buffer to submit, nullptr on error
+ */
+VkCommandBuffer transfer2Display(VulkanObj* obj, vulkan::SwapchainData& swapchain, VkImage displayImage, IGpuImageObject* image, uint32_t bufferIndex,
+                                 uint32_t imageIndex, VkRect2D const& dstRect);
 
-void presentImage(VulkanObj* obj, SwapchainData& swapchain, uint32_t& index);
+/**
+ * @brief Drops the recorded transfers (the command buffers are kept), call when the display buffers or the swapchain images change
+ *
+ */
+void invalidateTransfers(SwapchainData& swapchain);
+
+/**
+ * @brief Acquires the next swapchain image into acquiredImage (and acquiredSema), unless one is acquired already
+ *
+ * @param timeoutNs 0: don't wait
+ * @return false if none is free in time or the swapchain is out of date
+ */
+bool acquireImage(VulkanObj* obj, SwapchainData& swapchain, uint64_t timeoutNs);
+
+/**
+ * @brief Presents acquiredImage and tries to acquire the next one without waiting
+ *
+ */
+void presentImage(VulkanObj* obj, SwapchainData& swapchain);
 
 void waitFlipped(VulkanObj* obj); /// Call before submit
 } // namespace vulkan
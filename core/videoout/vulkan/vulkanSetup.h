@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <stdint.h>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -42,24 +43,60 @@ struct Queues {
 };
 
 struct SwapchainData {
-  VkSwapchainKHR swapchain = nullptr;
-  VkFormat       format    = VK_FORMAT_UNDEFINED;
-  VkExtent2D     extent2d  = {};
+  static constexpr uint32_t NO_IMAGE = UINT32_MAX;
+
+  VkSwapchainKHR   swapchain   = nullptr;
+  VkFormat         format      = VK_FORMAT_UNDEFINED;
+  VkExtent2D       extent2d    = {};
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
   struct DisplayBuffers {
     uint64_t bufferVaddr = 0;
     uint32_t bufferSize  = 0;
     uint32_t bufferAlign = 0;
+  };
 
-    VkImage     image;
-    VkSemaphore semDisplayReady;
+  struct Transfer {
+    VkCommandBuffer cmdBuffer = nullptr; // copy of one display buffer to one swapchain image, allocated on first use
+
+    VkImage       recordedSrc       = nullptr; // cmdBuffer holds the copy from this image, nullptr: record on next use
+    VkImageLayout recordedSrcLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkRect2D      recordedDst       = {};
+  };
+
+  struct Images {
+    VkImage     image           = nullptr;
+    VkSemaphore semPresentReady = nullptr;
+
+    std::vector<Transfer> transfers; // by display buffer index
+  };
 
-    VkCommandBuffer transferBuffer;
-    VkSemaphore     semPresentReady;
+  struct TransferStats {
+    uint64_t numRecorded = 0;
+    uint64_t numReused   = 0;
+    uint64_t recordNs    = 0; // cpu time spent recording
   };
 
-  VkCommandPool               commandPool;
-  std::vector<DisplayBuffers> buffers;
+  struct PresentStats {
+    uint64_t numPresents    = 0;
+    uint64_t numStalls      = 0; // next image wasn't acquired in advance
+    uint64_t stallNs        = 0; // time spent waiting for it
+    uint64_t numRecreations = 0;
+  };
+
+  VkCommandPool               commandPool = nullptr;
+  std::vector<DisplayBuffers> buffers; // registered display buffers
+  std::vector<Images>         images;  // swapchain images, their count and order are up to the presentation engine
+
+  std::vector<VkSemaphore> semAcquire;               // ring, one more than images: a semaphore is only reused once its transfer is done
+  uint32_t                 nextAcquire   = 0;        // next semAcquire to use
+  uint32_t                 acquiredImage = NO_IMAGE; // acquired in advance, not presented yet
+  VkSemaphore              acquiredSema  = nullptr;  // signaled when acquiredImage is ready for the transfer
+
+  bool outOfDate = false; // recreate before the next present
+
+  TransferStats transferStats;
+  PresentStats  presentStats;
 };
 
 struct SurfaceCapabilities {
@@ -91,5 +128,24 @@ VkInstance const getVkInstance();
 std::string_view const getGPUName();
 
 std::pair<VkFormat, VkColorSpaceKHR> getDisplayFormat(VulkanObj* obj);
-uint32_t createData(VulkanObj* obj, VkSurfaceKHR surface, SwapchainData& swapchainData, uint32_t width, uint32_t height, bool enableVsync); // Swapchain
+
+/**
+ * @brief The requested mode if the surface supports it, FIFO otherwise
+ *
+ */
+VkPresentModeKHR getPresentMode(VulkanObj* obj, VkPresentModeKHR requested);
+
+/**
+ * @brief Creates the swapchain, its images and their transfer data and acquires the first image.
+ * If that fails (minimized window), outOfDate is set and recreateSwapchain() retries it
+ *
+ */
+void createData(VulkanObj* obj, VkSurfaceKHR surface, SwapchainData& swapchainData, uint32_t width, uint32_t height, VkPresentModeKHR presentMode);
+
+/**
+ * @brief New swapchain for the current surface size (after a resize or when it is out of date). Waits for the pending transfers and presents
+ *
+ * @return false if the surface has no size (minimized) or on error, outOfDate stays set
+ */
+bool recreateSwapchain(VulkanObj* obj, VkSurfaceKHR surface, SwapchainData& swapchainData, uint32_t width, uint32_t height);
 } // namespace vulkan
\ No newline at end of file
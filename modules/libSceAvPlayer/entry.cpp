@@ -110,8 +110,7 @@ EXPORT SYSV_ABI int32_t sceAvPlayerPrintf(const char* format, ...) {
 
 EXPORT SYSV_ABI int32_t sceAvPlayerVprintf(const char* str, va_list args) {
   LOG_USE_MODULE(libSceAvPlayer);
-  std::string format(str);
-  LOG_DEBUG(std::wstring(format.begin(), format.end()).c_str(), args);
+  LOG_DEBUG(L"%S", str);
   return Ok;
 }
 }
\ No newline at end of file
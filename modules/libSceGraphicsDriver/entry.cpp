@@ -1,12 +1,18 @@
 #include "common.h"
 #include "core/imports/exports/graphics.h"
 #include "core/imports/exports/pm4_custom.h"
+#include "core/initParams/initParams.h"
 #include "core/kernel/eventqueue_types.h"
 #include "core/memory/memory.h"
 #include "core/timer/timer.h"
+#include "core/trace/trace.h"
 #include "core/videoout/videoout.h"
 #include "logging.h"
 #include "types.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <array>
 
 LOG_DEFINE_MODULE(libSceGraphicsDriver);
 
@@ -27,6 +33,31 @@ void event_delete_func(Kernel::EventQueue::IKernelEqueue_t eq, Kernel::EventQueu
   accessVideoOut().getGraphics()->removeEvent(eq, event->event.ident);
 }
 
+/**
+ * @brief Logs all errors of a submit
+ *
+ * @return false if invalid
+ */
+bool validateSubmit(uint32_t count, void* const dcbs[], uint32_t const dcbSizes[], void* const ccbs[], uint32_t const ccbSizes[]) {
+  LOG_USE_MODULE(libSceGraphicsDriver);
+
+  std::array<Validation::Error, 16> errors;
+
+  auto const numErrors = Validation::validate(count, dcbs, dcbSizes, ccbs, ccbSizes, errors);
+  for (uint32_t n = 0; n < std::min(numErrors, (uint32_t)errors.size()); ++n) {
+    auto const& err = errors[n];
+    LOG_ERR(L"Validation %S[%u] @0x%x header:0x%08x detail:0x%llx| %S", err.isConst ? "CCB" : "DCB", err.buffer, err.offset * 4, err.header, err.detail,
+            Validation::getName(err.code));
+  }
+  if (numErrors > errors.size()) LOG_ERR(L"Validation| %u more errors", numErrors - (uint32_t)errors.size());
+  return numErrors == 0;
+}
+
+bool isValidationEnabled() {
+  static bool const enabled = accessInitParams()->enableGnmValidation();
+  return enabled;
+}
+
 static memory::_t_hook _hook_setVsShader;
 
 static SYSV_ABI void hook_setVsShader(void* buffer) {
@@ -91,8 +122,7 @@ int SYSV_ABI sceGnmSetPsShader(uint32_t* cmdOut, uint64_t size, const uint32_t*
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S 0x%08llx", __FUNCTION__, (uint64_t)cmdOut);
   if (ps_regs == nullptr) {
-    cmdOut[0] = Pm4::create(size, Pm4::R_PS_EMBEDDED);
-    cmdOut[1] = 0;
+    Pm4::PsEmbeddedPacket::emit(cmdOut, size, 0);
   } else {
     cmdOut[0] = Pm4::create(size, Pm4::R_PS);
     memcpy(&cmdOut[1], ps_regs, 8 + size);
@@ -105,8 +135,7 @@ int SYSV_ABI sceGnmSetPsShader350(uint32_t* cmdOut, uint64_t size, const uint32_
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S 0x%08llx", __FUNCTION__, (uint64_t)cmdOut);
   if (ps_regs == nullptr) {
-    cmdOut[0] = Pm4::create(size, Pm4::R_PS_EMBEDDED);
-    cmdOut[1] = 0;
+    Pm4::PsEmbeddedPacket::emit(cmdOut, size, 0);
   } else {
     cmdOut[0] = Pm4::create(size, Pm4::R_PS);
     memcpy(&cmdOut[1], ps_regs, 8 + size);
@@ -156,9 +185,7 @@ int SYSV_ABI sceGnmSetEmbeddedVsShader(uint32_t* cmdOut, uint64_t size, uint32_t
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S 0x%08llx", __FUNCTION__, (uint64_t)cmdOut);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_VS_EMBEDDED);
-  cmdOut[1] = shader_modifier;
-  cmdOut[2] = id;
+  Pm4::VsEmbeddedPacket::emit(cmdOut, size, shader_modifier, id);
   return Ok;
 }
 
@@ -166,12 +193,8 @@ int SYSV_ABI sceGnmDrawIndex(uint32_t* cmdOut, uint64_t size, uint32_t index_cou
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S 0x%08llx", __FUNCTION__, (uint64_t)cmdOut);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_DRAW_INDEX);
-  cmdOut[1] = index_count;
-  cmdOut[2] = static_cast<uint32_t>(reinterpret_cast<uint64_t>(index_addr) & 0xffffffffu);
-  cmdOut[3] = static_cast<uint32_t>((reinterpret_cast<uint64_t>(index_addr) >> 32u) & 0xffffffffu);
-  cmdOut[4] = flags;
-  cmdOut[5] = type;
+  auto const addr = reinterpret_cast<uint64_t>(index_addr);
+  Pm4::DrawIndexPacket::emit(cmdOut, size, index_count, addr & 0xffffffffu, addr >> 32u, flags, type);
   return Ok;
 }
 
@@ -179,27 +202,21 @@ int SYSV_ABI sceGnmDrawIndexAuto(uint32_t* cmdOut, uint64_t size, uint32_t index
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S 0x%08llx", __FUNCTION__, (uint64_t)cmdOut);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_DRAW_INDEX_AUTO);
-  cmdOut[1] = index_count;
-  cmdOut[2] = flags;
+  Pm4::DrawIndexAutoPacket::emit(cmdOut, size, index_count, flags);
 
   return Ok;
 }
 
 int32_t SYSV_ABI sceGnmValidateDrawCommandBuffers(uint32_t count, void* dcbGpuAddrs[], uint32_t* dcbSizesInBytes, void* ccbGpuAddrs[],
                                                   uint32_t* ccbSizesInBytes) {
-#if DEBUG
-  LOG_USE_MODULE(libSceGraphicsDriver);
-  for (uint32_t n = 0; n < count; ++n) {
-    if (dcbGpuAddrs != nullptr) LOG_DEBUG(L"Validate DCB[%d] 0x%08llx(0x%u)", n, (uint64_t)dcbGpuAddrs[n], dcbSizesInBytes[n]);
-    if (ccbGpuAddrs != nullptr) LOG_DEBUG(L"Validate CCB[%d] 0x%08llx(0x%u)", n, (uint64_t)ccbGpuAddrs[n], ccbSizesInBytes[n]);
-  }
-#endif
-  return Err::VALIDATION_NOT_ENABLED;
+  if (!isValidationEnabled()) return Err::VALIDATION_NOT_ENABLED;
+  return validateSubmit(count, dcbGpuAddrs, dcbSizesInBytes, ccbGpuAddrs, ccbSizesInBytes) ? Ok : Err::FAILURE;
 }
 
 int SYSV_ABI sceGnmSubmitCommandBuffers(uint32_t count, void** dcb_gpu_addrs, const uint32_t* dcb_sizes_in_bytes, void** ccb_gpu_addrs,
                                         const uint32_t* ccb_sizes_in_bytes) {
+  TRACE_SPAN("gpu", "submit");
+  if (isValidationEnabled()) validateSubmit(count, dcb_gpu_addrs, dcb_sizes_in_bytes, ccb_gpu_addrs, ccb_sizes_in_bytes);
   accessVideoOut().getGraphics()->submitCmdBuffer(count, (uint32_t const**)dcb_gpu_addrs, dcb_sizes_in_bytes, (uint32_t const**)ccb_gpu_addrs,
                                                   ccb_sizes_in_bytes, 0, 0, 0, 0, false);
   return Ok;
@@ -207,6 +224,8 @@ int SYSV_ABI sceGnmSubmitCommandBuffers(uint32_t count, void** dcb_gpu_addrs, co
 
 int SYSV_ABI sceGnmSubmitCommandBuffersForWorkload(uint64_t workload, uint32_t count, void** dcb_gpu_addrs, const uint32_t* dcb_sizes_in_bytes,
                                                    void** ccb_gpu_addrs, const uint32_t* ccb_sizes_in_bytes) {
+  TRACE_SPAN("gpu", "submit");
+  if (isValidationEnabled()) validateSubmit(count, dcb_gpu_addrs, dcb_sizes_in_bytes, ccb_gpu_addrs, ccb_sizes_in_bytes);
   accessVideoOut().getGraphics()->submitCmdBuffer(count, (uint32_t const**)dcb_gpu_addrs, dcb_sizes_in_bytes, (uint32_t const**)ccb_gpu_addrs,
                                                   ccb_sizes_in_bytes, 0, 0, 0, 0, false);
   return Ok;
@@ -214,6 +233,8 @@ int SYSV_ABI sceGnmSubmitCommandBuffersForWorkload(uint64_t workload, uint32_t c
 
 int SYSV_ABI sceGnmSubmitAndFlipCommandBuffers(uint32_t count, void** dcb_gpu_addrs, const uint32_t* dcb_sizes_in_bytes, void** ccb_gpu_addrs,
                                                const uint32_t* ccb_sizes_in_bytes, int handle, int index, int flip_mode, int64_t flip_arg) {
+  TRACE_SPAN("gpu", "submitAndFlip");
+  if (isValidationEnabled()) validateSubmit(count, dcb_gpu_addrs, dcb_sizes_in_bytes, ccb_gpu_addrs, ccb_sizes_in_bytes);
   accessVideoOut().getGraphics()->submitCmdBuffer(count, (uint32_t const**)dcb_gpu_addrs, dcb_sizes_in_bytes, (uint32_t const**)ccb_gpu_addrs,
                                                   ccb_sizes_in_bytes, handle, index, flip_mode, flip_arg, true);
   return Ok;
@@ -222,6 +243,8 @@ int SYSV_ABI sceGnmSubmitAndFlipCommandBuffers(uint32_t count, void** dcb_gpu_ad
 int SYSV_ABI sceGnmSubmitAndFlipCommandBuffersForWorkload(uint64_t workload, uint32_t count, void** dcb_gpu_addrs, const uint32_t* dcb_sizes_in_bytes,
                                                           void** ccb_gpu_addrs, const uint32_t* ccb_sizes_in_bytes, int handle, int index, int flip_mode,
                                                           int64_t flip_arg) {
+  TRACE_SPAN("gpu", "submitAndFlip");
+  if (isValidationEnabled()) validateSubmit(count, dcb_gpu_addrs, dcb_sizes_in_bytes, ccb_gpu_addrs, ccb_sizes_in_bytes);
   accessVideoOut().getGraphics()->submitCmdBuffer(count, (uint32_t const**)dcb_gpu_addrs, dcb_sizes_in_bytes, (uint32_t const**)ccb_gpu_addrs,
                                                   ccb_sizes_in_bytes, handle, index, flip_mode, flip_arg, true);
   return Ok;
@@ -251,9 +274,7 @@ int SYSV_ABI sceGnmSetVgtControl(uint32_t* cmdOut, uint64_t size, uint32_t primG
   LOG_TRACE(L"%S", __FUNCTION__);
 
   if (size == 3 && primGroupSizeMinusOne < 0x100 && ((wdSwitchOnlyOnEopMode | partialVsWaveMode) < 2)) {
-    cmdOut[0] = Pm4::create(size, Pm4::R_VGT_CONTROL);
-    cmdOut[1] = 0x2aa;
-    cmdOut[2] = ((partialVsWaveMode & 1) << 16) or (primGroupSizeMinusOne & 0xffff);
+    Pm4::VgtControlPacket::emit(cmdOut, size, 0x2aa, ((partialVsWaveMode & 1) << 16) | (primGroupSizeMinusOne & 0xffff));
     return Ok;
   }
   return -1;
@@ -264,9 +285,7 @@ int SYSV_ABI sceGnmResetVgtControl(uint32_t* cmdOut, int32_t param) {
   LOG_TRACE(L"%S", __FUNCTION__);
 
   if (param == 3) {
-    cmdOut[0] = Pm4::create(3, Pm4::R_VGT_CONTROL);
-    cmdOut[1] = 0x2aa;
-    cmdOut[2] = 0xff;
+    Pm4::VgtControlPacket::emit(cmdOut, Pm4::VgtControlPacket::LENGTH, 0x2aa, 0xff);
 
     return Ok;
   }
@@ -277,7 +296,7 @@ uint32_t SYSV_ABI sceGnmDrawInitDefaultHardwareState(uint32_t* cmdOut, uint64_t
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_DEBUG(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(2, Pm4::R_DRAW_RESET);
+  Pm4::DrawResetPacket::emit(cmdOut, Pm4::DrawResetPacket::LENGTH, 0);
   return 2;
 }
 
@@ -285,7 +304,7 @@ uint32_t SYSV_ABI sceGnmDrawInitDefaultHardwareState175(uint32_t* cmdOut, uint64
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_DEBUG(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(2, Pm4::R_DRAW_RESET);
+  Pm4::DrawResetPacket::emit(cmdOut, Pm4::DrawResetPacket::LENGTH, 0);
 
   return 2;
 }
@@ -294,7 +313,7 @@ uint32_t SYSV_ABI sceGnmDrawInitDefaultHardwareState200(uint32_t* cmdOut, uint64
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_DEBUG(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(2, Pm4::R_DRAW_RESET);
+  Pm4::DrawResetPacket::emit(cmdOut, Pm4::DrawResetPacket::LENGTH, 0);
 
   return 2;
 }
@@ -303,7 +322,7 @@ uint32_t SYSV_ABI sceGnmDrawInitDefaultHardwareState350(uint32_t* cmdOut, uint64
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_DEBUG(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(2, Pm4::R_DRAW_RESET);
+  Pm4::DrawResetPacket::emit(cmdOut, Pm4::DrawResetPacket::LENGTH, 0);
   return 2;
 }
 
@@ -311,7 +330,7 @@ uint32_t SYSV_ABI sceGnmDispatchInitDefaultHardwareState(uint32_t* cmdOut, uint6
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_DEBUG(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(2, Pm4::R_DISPATCH_RESET);
+  Pm4::DispatchResetPacket::emit(cmdOut, Pm4::DispatchResetPacket::LENGTH, 0);
 
   return 2;
 }
@@ -320,9 +339,7 @@ int SYSV_ABI sceGnmInsertWaitFlipDone(uint32_t* cmdOut, uint64_t size, uint32_t
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_WAIT_FLIP_DONE);
-  cmdOut[1] = video_out_handle;
-  cmdOut[2] = display_buffer_index;
+  Pm4::WaitFlipDonePacket::emit(cmdOut, size, video_out_handle, display_buffer_index);
 
   return Ok;
 }
@@ -331,11 +348,7 @@ int SYSV_ABI sceGnmDispatchDirect(uint32_t* cmdOut, uint64_t size, uint32_t thre
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_DISPATCH_DIRECT);
-  cmdOut[1] = thread_group_x;
-  cmdOut[2] = thread_group_y;
-  cmdOut[3] = thread_group_z;
-  cmdOut[4] = mode;
+  Pm4::DispatchDirectPacket::emit(cmdOut, size, thread_group_x, thread_group_y, thread_group_z, mode);
 
   return Ok;
 }
@@ -354,12 +367,8 @@ int SYSV_ABI sceGnmComputeWaitOnAddress(uint32_t* cmdOut, uint64_t size, uint32_
   LOG_USE_MODULE(libSceGraphicsDriver);
   LOG_TRACE(L"%S", __FUNCTION__);
 
-  cmdOut[0] = Pm4::create(size, Pm4::R_DISPATCH_WAIT_MEM);
-  cmdOut[1] = static_cast<uint32_t>(reinterpret_cast<uint64_t>(gpu_addr) & 0xffffffffu);
-  cmdOut[2] = static_cast<uint32_t>((reinterpret_cast<uint64_t>(gpu_addr) >> 32u) & 0xffffffffu);
-  cmdOut[3] = mask;
-  cmdOut[4] = func;
-  cmdOut[5] = ref;
+  auto const addr = reinterpret_cast<uint64_t>(gpu_addr);
+  Pm4::DispatchWaitMemPacket::emit(cmdOut, size, addr & 0xffffffffu, addr >> 32u, mask, func, ref);
   return Ok;
 }
 
@@ -0,0 +1,197 @@
+#include "validation.h"
+
+#include "core/imports/exports/pm4_custom.h"
+#include "core/imports/exports/pm4_parser.h"
+#include "core/memory/memory.h"
+#include "utility/utility.h"
+
+#include <array>
+
+namespace Validation {
+namespace {
+constexpr uint32_t OP_INDIRECT_BUFFER_CONST = 0x33;
+constexpr uint32_t OP_INDIRECT_BUFFER       = 0x3F;
+
+struct RegisterSpace {
+  uint32_t opcode;
+  uint32_t begin;
+  uint32_t end;
+};
+
+constexpr std::array REGISTER_SPACES = {
+    RegisterSpace {0x68, 0x2000, 0x2C00},  // SET_CONFIG_REG
+    RegisterSpace {0x69, 0xA000, 0xA400},  // SET_CONTEXT_REG
+    RegisterSpace {0x76, 0x2C00, 0x3000},  // SET_SH_REG
+    RegisterSpace {0x79, 0xC000, 0x10000}, // SET_UCONFIG_REG
+};
+
+// Fields written by the sceGnm* functions, with header
+constexpr std::array<uint32_t, Pm4::R_NUM_COMMANDS> CUSTOM_MIN_LENGTH = {
+    0,                                  // unused
+    2,                                  // R_VS
+    2,                                  // R_PS
+    Pm4::DrawIndexPacket::LENGTH,       // R_DRAW_INDEX
+    Pm4::DrawIndexAutoPacket::LENGTH,   // R_DRAW_INDEX_AUTO
+    Pm4::DrawResetPacket::LENGTH,       // R_DRAW_RESET
+    Pm4::WaitFlipDonePacket::LENGTH,    // R_WAIT_FLIP_DONE
+    2,                                  // R_CS
+    Pm4::DispatchDirectPacket::LENGTH,  // R_DISPATCH_DIRECT
+    Pm4::DispatchResetPacket::LENGTH,   // R_DISPATCH_RESET
+    Pm4::DispatchWaitMemPacket::LENGTH, // R_DISPATCH_WAIT_MEM
+    2,                                  // R_PUSH_MARKER
+    2,                                  // R_POP_MARKER
+    Pm4::VsEmbeddedPacket::LENGTH,      // R_VS_EMBEDDED
+    Pm4::PsEmbeddedPacket::LENGTH,      // R_PS_EMBEDDED
+    2,                                  // R_VS_UPDATE
+    2,                                  // R_PS_UPDATE
+    Pm4::VgtControlPacket::LENGTH,      // R_VGT_CONTROL
+};
+
+class Checker {
+  std::span<Error> m_errors;
+  uint32_t         m_numErrors = 0;
+
+  bool     m_isConst = false;
+  uint32_t m_buffer  = 0;
+
+  uint64_t m_readableBegin = 0, m_readableEnd = 0; // last queried region, most references hit it
+
+  bool isReadable(uint64_t addr, uint64_t size);
+
+  void checkCustom(Pm4::Packet const& packet, uint32_t offset);
+  void checkType3(Pm4::Packet const& packet, uint32_t offset);
+
+  public:
+  Checker(std::span<Error> errors): m_errors(errors) {}
+
+  void add(ErrorCode code, uint32_t offset, uint32_t header, uint64_t detail) {
+    if (m_numErrors < m_errors.size()) {
+      m_errors[m_numErrors] = Error {.code = code, .isConst = m_isConst, .buffer = m_buffer, .offset = offset, .header = header, .detail = detail};
+    }
+    ++m_numErrors;
+  }
+
+  void checkBuffer(bool isConst, uint32_t index, void const* buffer, uint32_t numBytes);
+
+  uint32_t getNumErrors() const { return m_numErrors; }
+};
+
+bool Checker::isReadable(uint64_t addr, uint64_t size) {
+  if (addr >= m_readableBegin && addr + size <= m_readableEnd) return true;
+
+  for (uint64_t pos = addr; pos < addr + size;) {
+    uintptr_t start = 0, end = 0;
+    int       prot  = 0;
+    if (memory::queryAlloc(pos, &start, &end, &prot) < 0 || (prot & SceProtRead) == 0) return false;
+    if (pos == addr) m_readableBegin = start;
+    m_readableEnd = end;
+    pos           = end;
+  }
+  return true;
+}
+
+void Checker::checkCustom(Pm4::Packet const& packet, uint32_t offset) {
+  if (packet.op == 0 || packet.op >= Pm4::R_NUM_COMMANDS) {
+    add(ErrorCode::UnknownCustom, offset, packet.data[0], packet.op);
+    return;
+  }
+  if (packet.len < CUSTOM_MIN_LENGTH[packet.op]) {
+    add(ErrorCode::TooShort, offset, packet.data[0], packet.len);
+    return;
+  }
+
+  switch (packet.op) {
+    case Pm4::R_DRAW_INDEX: { // index size is set separately, 16 bit is the lower bound
+      auto const addr = util::getAddress(&packet.data[2]);
+      if (!isReadable(addr, (uint64_t)packet.data[1] * sizeof(uint16_t))) add(ErrorCode::Unmapped, offset, packet.data[0], addr);
+    } break;
+    case Pm4::R_DISPATCH_WAIT_MEM: {
+      auto const addr = util::getAddress(&packet.data[1]);
+      if (!isReadable(addr, sizeof(uint32_t))) add(ErrorCode::Unmapped, offset, packet.data[0], addr);
+    } break;
+    default: break;
+  }
+}
+
+void Checker::checkType3(Pm4::Packet const& packet, uint32_t offset) {
+  if (packet.op == OP_INDIRECT_BUFFER || packet.op == OP_INDIRECT_BUFFER_CONST) {
+    if (packet.len < 4) {
+      add(ErrorCode::TooShort, offset, packet.data[0], packet.len);
+      return;
+    }
+    auto const addr = ((uint64_t)(packet.data[2] & 0xffffu) << 32u) | (packet.data[1] & ~3u);
+    auto const size = (uint64_t)(packet.data[3] & 0xfffffu) * sizeof(uint32_t);
+    if (!isReadable(addr, size)) add(ErrorCode::Unmapped, offset, packet.data[0], addr);
+    return;
+  }
+
+  for (auto const& space: REGISTER_SPACES) {
+    if (packet.op != space.opcode) continue;
+
+    if (packet.len < 3) {
+      add(ErrorCode::TooShort, offset, packet.data[0], packet.len);
+      return;
+    }
+    auto const reg = space.begin + (packet.data[1] & 0xffffu);
+    if (reg + (packet.len - 2) > space.end) add(ErrorCode::RegisterRange, offset, packet.data[0], reg);
+    return;
+  }
+}
+
+void Checker::checkBuffer(bool isConst, uint32_t index, void const* buffer, uint32_t numBytes) {
+  m_isConst = isConst;
+  m_buffer  = index;
+  if (numBytes == 0) return;
+
+  if (((uint64_t)buffer | numBytes) % sizeof(uint32_t) != 0) {
+    add(ErrorCode::Misaligned, 0, 0, (uint64_t)buffer);
+    return;
+  }
+  if (buffer == nullptr || !isReadable((uint64_t)buffer, numBytes)) {
+    add(ErrorCode::Unmapped, 0, 0, (uint64_t)buffer);
+    return;
+  }
+
+  auto const cmds  = (uint32_t const*)buffer;
+  auto       visit = [&](Pm4::Packet const& packet) {
+    auto const offset = (uint32_t)(packet.data - cmds);
+    switch (packet.type) {
+      case Pm4::PacketType::Type0: {
+        auto const reg = packet.op;
+        if (reg + (packet.len - 1) > 0x10000) add(ErrorCode::RegisterRange, offset, packet.data[0], reg);
+      } break;
+      case Pm4::PacketType::Custom: checkCustom(packet, offset); break;
+      case Pm4::PacketType::Type3: checkType3(packet, offset); break;
+      default: break;
+    }
+    return true;
+  };
+
+  size_t     stopDw = 0;
+  auto const result = Pm4::parse(cmds, numBytes / sizeof(uint32_t), visit, &stopDw);
+
+  if (result == Pm4::ParseResult::Truncated) add(ErrorCode::Truncated, (uint32_t)stopDw, cmds[stopDw], numBytes);
+}
+} // namespace
+
+uint32_t validate(uint32_t count, void* const dcbs[], uint32_t const dcbSizes[], void* const ccbs[], uint32_t const ccbSizes[], std::span<Error> errors) {
+  Checker checker(errors);
+  for (uint32_t n = 0; n < count; ++n) {
+    if (dcbs != nullptr && dcbSizes != nullptr) checker.checkBuffer(false, n, dcbs[n], dcbSizes[n]);
+    if (ccbs != nullptr && ccbSizes != nullptr) checker.checkBuffer(true, n, ccbs[n], ccbSizes[n]);
+  }
+  return checker.getNumErrors();
+}
+
+char const* getName(ErrorCode code) {
+  switch (code) {
+    case ErrorCode::Misaligned: return "misaligned";
+    case ErrorCode::Unmapped: return "unmapped memory";
+    case ErrorCode::Truncated: return "truncated packet";
+    case ErrorCode::UnknownCustom: return "unknown custom packet";
+    case ErrorCode::TooShort: return "packet too short";
+    case ErrorCode::RegisterRange: return "register out of range";
+  }
+  return "?";
+}
+} // namespace Validation
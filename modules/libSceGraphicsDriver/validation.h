@@ -0,0 +1,37 @@
+#pragma once
+#include <span>
+#include <stdint.h>
+
+/**
+ * @brief CPU checks of submitted command buffers: packet sizes, register ranges, referenced memory and custom packets
+ *
+ */
+namespace Validation {
+enum class ErrorCode : uint8_t {
+  Misaligned,    // buffer address or size not dword aligned
+  Unmapped,      // buffer or referenced memory not readable
+  Truncated,     // packet exceeds its buffer
+  UnknownCustom, // custom packet with an unknown R_* id
+  TooShort,      // packet without all of its fields
+  RegisterRange, // register write outside of its register space
+};
+
+struct Error {
+  ErrorCode code;
+  bool      isConst; // buffer is a ccb
+  uint32_t  buffer;  // index in the submit
+  uint32_t  offset;  // of the packet, dwords
+  uint32_t  header;  // of the packet
+  uint64_t  detail;  // register or memory address
+};
+
+/**
+ * @brief Checks all dcbs and ccbs of a submit
+ *
+ * @param errors receives the first errors.size() errors
+ * @return number of errors found, may exceed errors.size()
+ */
+uint32_t validate(uint32_t count, void* const dcbs[], uint32_t const dcbSizes[], void* const ccbs[], uint32_t const ccbSizes[], std::span<Error> errors);
+
+char const* getName(ErrorCode code);
+} // namespace Validation
@@ -1,6 +1,7 @@
 #include "common.h"
 #include "core/imports/imports_runtime.h"
 #include "logging.h"
+#include "printf.h"
 #include "types.h"
 
 #include <cstdlib>
@@ -32,35 +33,14 @@ EXPORT SYSV_ABI void __NID(_ZNSt8ios_base4InitC1Ev)() {}
  */
 EXPORT SYSV_ABI void __NID(_ZNSt6_WinitC1Ev)() {}
 
-EXPORT SYSV_ABI int __NID(vprintf)(const char* str, va_list args) {
-  LOG_USE_MODULE(libSceLibcInternal);
-
-  std::string format(str);
-  LOG_DEBUG(std::wstring(format.begin(), format.end()).c_str(), args);
-
-  return Ok;
-}
-
-EXPORT SYSV_ABI int __NID(snprintf)(char* s, size_t n, const char* format, va_list args) {
-  return std::snprintf(s, n, format, args);
-}
-
 EXPORT SYSV_ABI int __NID(fflush)(FILE* stream) {
+  if (stream == nullptr || stream == (FILE*)&__NID(_Stdout)) {
+    flushStdout();
+    if (stream != nullptr) return Ok;
+  }
   return std::fflush(stream);
 }
 
-EXPORT SYSV_ABI void* __NID(memset)(void* s, int c, size_t n) {
-  return std::memset(s, c, n);
-}
-
-EXPORT SYSV_ABI void* __NID(memcpy)(void* d, void* s, size_t n) {
-  return std::memcpy(d, s, n);
-}
-
-EXPORT SYSV_ABI void* __NID(memmove)(void* dst, void const* src, size_t n) {
-  return std::memmove(dst, src, n);
-}
-
 EXPORT SYSV_ABI int __NID(__cxa_atexit)(void (*func)(void*), void* arg, int moduleId) {
   LOG_USE_MODULE(libSceLibcInternal);
   LOG_TRACE(L"%S", __FUNCTION__);
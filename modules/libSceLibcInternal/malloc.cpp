@@ -0,0 +1,280 @@
+#include "common.h"
+#include "core/imports/exports/procParam.h"
+#include "core/imports/imports_runtime.h"
+#include "core/memory/heap.h"
+#include "logging.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+LOG_DEFINE_MODULE(malloc);
+
+namespace {
+using malloc_init_t        = SYSV_ABI int (*)();
+using malloc_t             = SYSV_ABI void* (*)(size_t size);
+using free_t               = SYSV_ABI void (*)(void* ptr);
+using calloc_t             = SYSV_ABI void* (*)(size_t n, size_t size);
+using realloc_t            = SYSV_ABI void* (*)(void* ptr, size_t size);
+using memalign_t           = SYSV_ABI void* (*)(size_t alignment, size_t size);
+using reallocalign_t       = SYSV_ABI void* (*)(void* ptr, size_t size, size_t alignment);
+using posix_memalign_t     = SYSV_ABI int (*)(void** ptr, size_t alignment, size_t size);
+using malloc_stats_t       = SYSV_ABI int (*)(SceLibcMallocManagedSize* mmsize);
+using malloc_usable_size_t = SYSV_ABI size_t (*)(void* ptr);
+
+using new_t            = SYSV_ABI void* (*)(size_t size);
+using new_nothrow_t    = SYSV_ABI void* (*)(size_t size, void const* nothrow);
+using delete_t         = SYSV_ABI void (*)(void* ptr);
+using delete_nothrow_t = SYSV_ABI void (*)(void* ptr, void const* nothrow);
+
+/**
+ * @brief Replacement tables of the title (procParam -> libcParam), zero entries use the default heap
+ *
+ */
+struct Replace {
+  SceMallocReplace  mallocReplace {};
+  SceLibcNewReplace newReplace {};
+};
+
+// Both tables start with their size
+template <typename T>
+void copyTable(T* dst, T const* src) {
+  if (src == nullptr) return;
+
+  auto const size = std::min((size_t)*(uint64_t const*)src, sizeof(T));
+  *dst            = {};
+  std::memcpy(dst, src, size);
+}
+
+void loadTitleReplace(Replace& replace) {
+  LOG_USE_MODULE(malloc);
+
+  auto const procParam = (ProcParam const*)accessRuntimeExport()->mainModuleInfo().procParamAddr;
+  if (procParam == nullptr || procParam->header.size < offsetof(ProcParam, PSceLibcParam) + sizeof(procParam->PSceLibcParam)) return;
+
+  auto const libcParam = (SceLibcParam1 const*)procParam->PSceLibcParam;
+  if (libcParam == nullptr || libcParam->entry_count <= 1) return;
+
+  copyTable(&replace.mallocReplace, libcParam->_sceLibcMallocReplace);
+  copyTable(&replace.newReplace, libcParam->_sceLibcNewReplace);
+
+  LOG_INFO(L"malloc replace:%S new replace:%S", util::getBoolStr(libcParam->_sceLibcMallocReplace != nullptr),
+           util::getBoolStr(libcParam->_sceLibcNewReplace != nullptr));
+}
+
+/**
+ * @brief Without a title replacement, the heap the libc registered with the kernel (if any) replaces the default heap.
+ * All or nothing: blocks must be freed by the heap that allocated them.
+ */
+void loadApplicationHeap(Replace& replace) {
+  LOG_USE_MODULE(malloc);
+
+  auto const api = heap::getApplicationHeapAPI();
+  if (api == nullptr) return;
+  if (replace.mallocReplace.malloc != nullptr) {
+    LOG_INFO(L"application heap api unused, replaced by the title");
+    return;
+  }
+  if (api->malloc == nullptr || api->free == nullptr) {
+    LOG_WARN(L"application heap api without malloc/free, unused");
+    return;
+  }
+
+  auto& dst          = replace.mallocReplace;
+  dst.malloc         = api->malloc;
+  dst.free           = api->free;
+  dst.calloc         = api->calloc;
+  dst.realloc        = api->realloc;
+  dst.memalign       = api->memalign;
+  dst.reallocalign   = api->reallocalign;
+  dst.posix_memalign = api->posix_memalign;
+  LOG_INFO(L"malloc -> application heap api");
+}
+
+Replace loadReplace() {
+  Replace replace;
+  loadTitleReplace(replace);
+  loadApplicationHeap(replace);
+  return replace;
+}
+
+Replace const& getReplace() {
+  static Replace const inst = loadReplace();
+
+  // malloc_init may call malloc itself
+  static std::once_flag initFlag;
+  thread_local bool     inInit = false;
+  if (!inInit) {
+    std::call_once(initFlag, [] {
+      if (inst.mallocReplace.malloc_init != nullptr) {
+        inInit = true;
+        ((malloc_init_t)inst.mallocReplace.malloc_init)();
+        inInit = false;
+      }
+    });
+  }
+  return inst;
+}
+
+void getDefaultStats(SceLibcMallocManagedSize* mmsize) {
+  auto const stats = heap::getStats();
+
+  mmsize->maxSystemSize     = stats.systemSize;
+  mmsize->currentSystemSize = stats.systemSize;
+  mmsize->maxInuseSize      = stats.maxInUse;
+  mmsize->currentInuseSize  = stats.inUse;
+}
+} // namespace
+
+extern "C" {
+
+EXPORT SYSV_ABI void* __NID(malloc)(size_t size) {
+  if (auto func = getReplace().mallocReplace.malloc; func != nullptr) return ((malloc_t)func)(size);
+  return heap::malloc(size);
+}
+
+EXPORT SYSV_ABI void __NID(free)(void* ptr) {
+  if (auto func = getReplace().mallocReplace.free; func != nullptr) return ((free_t)func)(ptr);
+  heap::free(ptr);
+}
+
+EXPORT SYSV_ABI void* __NID(calloc)(size_t n, size_t size) {
+  if (auto func = getReplace().mallocReplace.calloc; func != nullptr) return ((calloc_t)func)(n, size);
+  return heap::calloc(n, size);
+}
+
+EXPORT SYSV_ABI void* __NID(realloc)(void* ptr, size_t size) {
+  if (auto func = getReplace().mallocReplace.realloc; func != nullptr) return ((realloc_t)func)(ptr, size);
+  return heap::realloc(ptr, size);
+}
+
+EXPORT SYSV_ABI void* __NID(memalign)(size_t alignment, size_t size) {
+  if (auto func = getReplace().mallocReplace.memalign; func != nullptr) return ((memalign_t)func)(alignment, size);
+  return heap::memalign(alignment, size);
+}
+
+EXPORT SYSV_ABI void* __NID(reallocalign)(void* ptr, size_t size, size_t alignment) {
+  if (auto func = getReplace().mallocReplace.reallocalign; func != nullptr) return ((reallocalign_t)func)(ptr, size, alignment);
+
+  if (ptr == nullptr) return heap::memalign(alignment, size);
+  if (((uint64_t)ptr & (alignment - 1)) == 0) return heap::realloc(ptr, size);
+
+  auto dst = heap::memalign(alignment, size);
+  if (dst == nullptr) return nullptr;
+
+  std::memcpy(dst, ptr, std::min(size, heap::usableSize(ptr)));
+  heap::free(ptr);
+  return dst;
+}
+
+EXPORT SYSV_ABI int __NID(posix_memalign)(void** ptr, size_t alignment, size_t size) {
+  if (auto func = getReplace().mallocReplace.posix_memalign; func != nullptr) return ((posix_memalign_t)func)(ptr, alignment, size);
+
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return (int)ErrCode::_EINVAL;
+
+  *ptr = heap::memalign(alignment, size);
+  return *ptr == nullptr ? (int)ErrCode::_ENOMEM : Ok;
+}
+
+EXPORT SYSV_ABI size_t __NID(malloc_usable_size)(void* ptr) {
+  auto const& replace = getReplace().mallocReplace;
+  if (auto func = replace.malloc_usable_size; func != nullptr) return ((malloc_usable_size_t)func)(ptr);
+  if (replace.malloc != nullptr) return 0; // not a block of the default heap
+  return heap::usableSize(ptr);
+}
+
+EXPORT SYSV_ABI int __NID(malloc_stats)(SceLibcMallocManagedSize* mmsize) {
+  if (auto func = getReplace().mallocReplace.malloc_stats; func != nullptr) return ((malloc_stats_t)func)(mmsize);
+
+  if (mmsize == nullptr || mmsize->size != sizeof(SceLibcMallocManagedSize)) return (int)ErrCode::_EINVAL;
+  getDefaultStats(mmsize);
+  return Ok;
+}
+
+EXPORT SYSV_ABI int __NID(malloc_stats_fast)(SceLibcMallocManagedSize* mmsize) {
+  if (auto func = getReplace().mallocReplace.malloc_stats_fast; func != nullptr) return ((malloc_stats_t)func)(mmsize);
+
+  if (mmsize == nullptr || mmsize->size != sizeof(SceLibcMallocManagedSize)) return (int)ErrCode::_EINVAL;
+  getDefaultStats(mmsize);
+  return Ok;
+}
+
+/**
+ * @brief operator new(size_t)
+ *
+ */
+EXPORT SYSV_ABI void* __NID(_Znwm)(size_t size) {
+  if (auto func = getReplace().newReplace.user_new; func != nullptr) return ((new_t)func)(size);
+
+  auto ptr = __NID(malloc)(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    LOG_USE_MODULE(malloc);
+    LOG_CRIT(L"operator new: out of memory size:0x%08llx", size);
+  }
+  return ptr;
+}
+
+/**
+ * @brief operator new(size_t, std::nothrow_t const&)
+ *
+ */
+EXPORT SYSV_ABI void* __NID(_ZnwmRKSt9nothrow_t)(size_t size, void const* nothrow) {
+  if (auto func = getReplace().newReplace.user_new_nothrow; func != nullptr) return ((new_nothrow_t)func)(size, nothrow);
+  return __NID(malloc)(size == 0 ? 1 : size);
+}
+
+/**
+ * @brief operator new[](size_t)
+ *
+ */
+EXPORT SYSV_ABI void* __NID(_Znam)(size_t size) {
+  if (auto func = getReplace().newReplace.user_new_array; func != nullptr) return ((new_t)func)(size);
+  return __NID(_Znwm)(size);
+}
+
+/**
+ * @brief operator new[](size_t, std::nothrow_t const&)
+ *
+ */
+EXPORT SYSV_ABI void* __NID(_ZnamRKSt9nothrow_t)(size_t size, void const* nothrow) {
+  if (auto func = getReplace().newReplace.user_new_array_nothrow; func != nullptr) return ((new_nothrow_t)func)(size, nothrow);
+  return __NID(_ZnwmRKSt9nothrow_t)(size, nothrow);
+}
+
+/**
+ * @brief operator delete(void*)
+ *
+ */
+EXPORT SYSV_ABI void __NID(_ZdlPv)(void* ptr) {
+  if (auto func = getReplace().newReplace.user_delete; func != nullptr) return ((delete_t)func)(ptr);
+  __NID(free)(ptr);
+}
+
+/**
+ * @brief operator delete(void*, std::nothrow_t const&)
+ *
+ */
+EXPORT SYSV_ABI void __NID(_ZdlPvRKSt9nothrow_t)(void* ptr, void const* nothrow) {
+  if (auto func = getReplace().newReplace.user_delete_nothrow; func != nullptr) return ((delete_nothrow_t)func)(ptr, nothrow);
+  __NID(free)(ptr);
+}
+
+/**
+ * @brief operator delete[](void*)
+ *
+ */
+EXPORT SYSV_ABI void __NID(_ZdaPv)(void* ptr) {
+  if (auto func = getReplace().newReplace.user_delete_array; func != nullptr) return ((delete_t)func)(ptr);
+  __NID(_ZdlPv)(ptr);
+}
+
+/**
+ * @brief operator delete[](void*, std::nothrow_t const&)
+ *
+ */
+EXPORT SYSV_ABI void __NID(_ZdaPvRKSt9nothrow_t)(void* ptr, void const* nothrow) {
+  if (auto func = getReplace().newReplace.user_delete_array_nothrow; func != nullptr) return ((delete_nothrow_t)func)(ptr, nothrow);
+  __NID(_ZdlPvRKSt9nothrow_t)(ptr, nothrow);
+}
+}
@@ -1,30 +1,86 @@
 #include "common.h"
+#include "core/memory/heap.h"
 #include "logging.h"
+#include "tlsf.h"
 #include "types.h"
 
-#include <boost/pool/simple_segregated_storage.hpp>
+#include <algorithm>
+#include <cstring>
 #include <memory>
-#include <windows.h>
+#include <mutex>
+#include <string>
+#include <vector>
 
 LOG_DEFINE_MODULE(mspace);
 
 namespace {
+constexpr uint32_t MSPACE_THREAD_UNSAFE = 0x1;
+
 struct MSpaceData {
-  boost::simple_segregated_storage<std::size_t> storage;
+  void* base; // never 0, a zero in the first member marks the internal mspace
+
+  std::string name;
+  uint32_t    flags;
+  bool        ownsMemory = false;
+
+  std::mutex mutex;
+  Tlsf       tlsf;
+
+  std::unique_lock<std::mutex> lock() {
+    if ((flags & MSPACE_THREAD_UNSAFE) != 0) return {};
+    return std::unique_lock(mutex);
+  }
 };
 
 using MSpaceData_t = MSpaceData*;
+
+// MallocUsableSize doesn't get the mspace -> search by address
+std::mutex               g_mutexSpaces;
+std::vector<MSpaceData*> g_spaces;
+
+MSpaceData* findSpace(void const* ptr) {
+  std::unique_lock const lock(g_mutexSpaces);
+
+  auto it = std::find_if(g_spaces.begin(), g_spaces.end(), [ptr](MSpaceData* mspace) { return mspace->tlsf.contains(ptr); });
+  return it != g_spaces.end() ? *it : nullptr;
+}
+
+void getStats(MSpaceData_t mspace, SceLibcMallocManagedSize* mmsize) {
+  auto const lock  = mspace->lock();
+  auto const stats = mspace->tlsf.getStats();
+
+  mmsize->maxSystemSize     = stats.capacity;
+  mmsize->currentSystemSize = stats.capacity;
+  mmsize->maxInuseSize      = stats.maxInUse;
+  mmsize->currentInuseSize  = stats.inUse;
+}
 } // namespace
 
 extern "C" {
 EXPORT SYSV_ABI MSpaceData_t sceLibcMspaceCreate(const char* name, void* base, size_t capacity, uint32_t flag) {
   LOG_USE_MODULE(mspace);
 
-  auto* mspace = std::make_unique<MSpaceData>().release();
-  LOG_DEBUG(L"+ mspace name:%S ptr:0x%08llx base:0x%08llx size:0x%08llx", name, (uint64_t)mspace, (uint64_t)base, capacity);
-  mspace->storage.add_block(base, capacity, 32);
+  auto mspace = std::make_unique<MSpaceData>();
 
-  return mspace;
+  mspace->name  = name != nullptr ? name : "";
+  mspace->flags = flag;
+  if (base == nullptr) {
+    base               = heap::memalign(Tlsf::ALIGN_SIZE, capacity);
+    mspace->ownsMemory = true;
+  }
+  mspace->base = base;
+
+  if (base == nullptr || !mspace->tlsf.init(base, capacity)) {
+    LOG_ERR(L"+ mspace failed name:%S base:0x%08llx size:0x%08llx", name, (uint64_t)base, capacity);
+    if (mspace->ownsMemory) heap::free(base);
+    return nullptr;
+  }
+
+  LOG_DEBUG(L"+ mspace name:%S ptr:0x%08llx base:0x%08llx size:0x%08llx", name, (uint64_t)mspace.get(), (uint64_t)base, capacity);
+
+  std::unique_lock const lock(g_mutexSpaces);
+  g_spaces.push_back(mspace.get());
+  return mspace.release();
 }
 
 EXPORT SYSV_ABI int sceLibcMspaceDestroy(MSpaceData_t mspace) {
@@ -33,6 +89,13 @@ EXPORT SYSV_ABI int sceLibcMspaceDestroy(MSpaceData_t mspace) {
     return Ok;
     // -
   }
+
+  {
+    std::unique_lock const lock(g_mutexSpaces);
+    std::erase(g_spaces, mspace);
+  }
+
+  if (mspace->ownsMemory) heap::free(mspace->base);
   delete mspace;
   return Ok;
 }
@@ -40,12 +103,13 @@ EXPORT SYSV_ABI int sceLibcMspaceDestroy(MSpaceData_t mspace) {
 EXPORT SYSV_ABI int sceLibcMspaceFree(MSpaceData_t mspace, void* block) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    ::free(block);
+    heap::free(block);
     return Ok;
     // -
   }
 
-  mspace->storage.free(block);
+  auto const lock = mspace->lock();
+  mspace->tlsf.free(block);
   return Ok;
 }
 
@@ -53,99 +117,136 @@ EXPORT SYSV_ABI void* sceLibcMspaceMalloc(MSpaceData_t mspace, size_t size) {
   LOG_USE_MODULE(mspace);
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    return ::malloc(size);
+    return heap::malloc(size);
     // -
   }
 
-  auto addr = mspace->storage.malloc_n(1 + (size / 32), 32);
-  LOG_DEBUG(L"mspace ptr:0x%08llx alloc size:0x%08llx @0x%08llx", (uint64_t)mspace, size, addr);
+  auto const lock = mspace->lock();
+  auto const addr = mspace->tlsf.malloc(size);
+  LOG_TRACE(L"mspace ptr:0x%08llx alloc size:0x%08llx @0x%08llx", (uint64_t)mspace, size, addr);
   return addr;
 }
 
 EXPORT SYSV_ABI int sceLibcMspaceIsHeapEmpty(MSpaceData_t mspace) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    HANDLE hHeap = GetProcessHeap();
-    return ::HeapSize(hHeap, 0, nullptr);
+    return heap::getStats().inUse == 0 ? 1 : 0;
     // -
   }
 
-  LOG_USE_MODULE(mspace);
-  LOG_ERR(L"todo %S", __FUNCTION__);
-  return Ok; // todo
+  auto const lock = mspace->lock();
+  return mspace->tlsf.getStats().numAllocated == 0 ? 1 : 0;
 }
 
 EXPORT SYSV_ABI void* sceLibcMspaceMemalign(MSpaceData_t mspace, uint64_t alignment, uint64_t size) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    return ::_aligned_malloc(size, alignment);
+    return heap::memalign(alignment, size);
     // -
   }
 
-  LOG_USE_MODULE(mspace);
-  LOG_ERR(L"todo %S", __FUNCTION__);
-  return (void*)((uint64_t)mspace->storage.malloc_n(1, alignment + size) & ~(alignment - 1));
+  auto const lock = mspace->lock();
+  return mspace->tlsf.memalign(alignment, size);
 }
 
 EXPORT SYSV_ABI void* sceLibcMspaceCalloc(MSpaceData_t mspace, uint64_t n, uint64_t size) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    return ::calloc(n, size);
+    return heap::calloc(n, size);
     // -
   }
 
-  return mspace->storage.malloc_n(n, size);
+  if (size != 0 && n > SIZE_MAX / size) return nullptr;
+
+  void* addr = nullptr;
+  {
+    auto const lock = mspace->lock();
+    addr            = mspace->tlsf.malloc(n * size);
+  }
+
+  if (addr != nullptr) std::memset(addr, 0, n * size);
+  return addr;
 }
 
 EXPORT SYSV_ABI void* sceLibcMspaceReallocalign(MSpaceData_t mspace, void* src, uint64_t alignment, uint64_t size) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    return ::_aligned_realloc(src, alignment, size);
+    if (src == nullptr || ((uint64_t)src & (alignment - 1)) == 0) return src == nullptr ? heap::memalign(alignment, size) : heap::realloc(src, size);
+
+    auto dst = heap::memalign(alignment, size);
+    if (dst != nullptr) {
+      std::memcpy(dst, src, std::min(size, heap::usableSize(src)));
+      heap::free(src);
+    }
+    return dst;
     // -
   }
-  LOG_USE_MODULE(mspace);
-  LOG_ERR(L"todo %S", __FUNCTION__);
-  return nullptr;
+
+  auto const lock = mspace->lock();
+  return mspace->tlsf.reallocalign(src, alignment, size);
 }
 
 EXPORT SYSV_ABI void* sceLibcMspaceRealloc(MSpaceData_t mspace, void* src, uint64_t size) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    return ::realloc(src, size);
+    return heap::realloc(src, size);
     // -
   }
 
-  auto dst = mspace->storage.malloc_n(1, size);
-  if (dst == nullptr) return 0;
-
-  if (src != nullptr) {
-    memcpy(dst, src, size);
-    mspace->storage.free(src);
-  }
-  return dst;
+  auto const lock = mspace->lock();
+  return mspace->tlsf.realloc(src, size);
 }
 
 EXPORT SYSV_ABI int sceLibcMspacePosixMemalign(MSpaceData_t mspace, void** ptr, uint64_t alignment, uint64_t size) {
   if (*(uintptr_t*)mspace == 0) {
     // internal mspace
-    *ptr = ::_aligned_malloc(size, alignment);
+    *ptr = heap::memalign(alignment, size);
     return *ptr == nullptr ? 12 : Ok;
     // -
   }
-  LOG_USE_MODULE(mspace);
-  LOG_ERR(L"todo %S", __FUNCTION__);
-  return 12;
+
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return (int)ErrCode::_EINVAL;
+
+  auto const lock = mspace->lock();
+
+  *ptr = mspace->tlsf.memalign(alignment, size);
+  return *ptr == nullptr ? (int)ErrCode::_ENOMEM : Ok;
 }
 
-EXPORT SYSV_ABI int sceLibcMspaceMallocStats(MSpaceData_t mspace) {
+EXPORT SYSV_ABI int sceLibcMspaceMallocStats(MSpaceData_t mspace, SceLibcMallocManagedSize* mmsize) {
+  if (mmsize == nullptr || mmsize->size != sizeof(SceLibcMallocManagedSize)) return (int)ErrCode::_EINVAL;
+
+  if (*(uintptr_t*)mspace == 0) {
+    // internal mspace
+    auto const stats = heap::getStats();
+
+    mmsize->maxSystemSize     = stats.systemSize;
+    mmsize->currentSystemSize = stats.systemSize;
+    mmsize->maxInuseSize      = stats.maxInUse;
+    mmsize->currentInuseSize  = stats.inUse;
+    return Ok;
+    // -
+  }
+
+  getStats(mspace, mmsize);
   return Ok;
 }
 
-EXPORT SYSV_ABI int sceLibcMspaceMallocStatsFast(MSpaceData_t mspace) {
-  return Ok;
+EXPORT SYSV_ABI int sceLibcMspaceMallocStatsFast(MSpaceData_t mspace, SceLibcMallocManagedSize* mmsize) {
+  return sceLibcMspaceMallocStats(mspace, mmsize);
 }
 
 EXPORT SYSV_ABI size_t sceLibcMspaceMallocUsableSize(void* ptr) {
-  return 100000; // todo
+  if (ptr == nullptr) return 0;
+
+  auto mspace = findSpace(ptr);
+  if (mspace == nullptr) {
+    // internal mspace
+    return heap::usableSize(ptr);
+    // -
+  }
+
+  auto const lock = mspace->lock();
+  return Tlsf::usableSize(ptr);
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,889 @@
+#include "printf.h"
+
+#include "common.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+LOG_DEFINE_MODULE(printf);
+
+namespace {
+constexpr uint32_t GP_SAVE_END = 6 * 8;
+constexpr uint32_t FP_SAVE_END = GP_SAVE_END + 8 * 16;
+
+constexpr int MAX_POS_ARGS = 64;
+
+enum Flags : uint32_t {
+  FLAG_LEFT  = 1 << 0, // '-'
+  FLAG_PLUS  = 1 << 1, // '+'
+  FLAG_SPACE = 1 << 2, // ' '
+  FLAG_ALT   = 1 << 3, // '#'
+  FLAG_ZERO  = 1 << 4, // '0'
+};
+
+enum class Length : uint8_t { None, Char, Short, Long, LongLong, IntMax, Size, PtrDiff, LongDouble };
+
+enum class ArgType : uint8_t { None, Int, Double, LongDouble };
+
+struct Spec {
+  uint32_t flags    = 0;
+  int      width    = 0;
+  int      widthPos = -1; // -1: no '*', 0: next argument, else the position
+  int      prec     = -1;
+  int      precPos  = -1;
+  int      argPos   = 0;
+  Length   length   = Length::None;
+  char     conv     = '\0';
+};
+
+union ArgValue {
+  uint64_t i;
+  double   d;
+};
+
+double x87ToDouble(uint64_t mantissa, uint16_t signExp) {
+  auto const exp = signExp & 0x7fff;
+
+  double value = 0;
+  if (exp == 0x7fff) {
+    value = (mantissa << 1) == 0 ? INFINITY : NAN;
+  } else {
+    value = std::ldexp((double)mantissa, exp - 16383 - 63);
+  }
+  return (signExp & 0x8000) != 0 ? -value : value;
+}
+
+/**
+ * @brief va_arg for the guest's va_list
+ *
+ */
+class VaReader {
+  SysvVaList* m_va;
+
+  public:
+  explicit VaReader(SysvVaList* va): m_va(va) {}
+
+  uint64_t nextInt() {
+    if (m_va->gp_offset < GP_SAVE_END) {
+      auto const value = *(uint64_t const*)(m_va->reg_save_area + m_va->gp_offset);
+      m_va->gp_offset += 8;
+      return value;
+    }
+    return *m_va->overflow_arg_area++;
+  }
+
+  double nextDouble() {
+    double value;
+    if (m_va->fp_offset < FP_SAVE_END) {
+      std::memcpy(&value, m_va->reg_save_area + m_va->fp_offset, sizeof(double));
+      m_va->fp_offset += 16;
+    } else {
+      std::memcpy(&value, m_va->overflow_arg_area++, sizeof(double));
+    }
+    return value;
+  }
+
+  // long double is the 80 bit x87 format, always passed on the stack (16 byte aligned)
+  double nextLongDouble() {
+    auto area = (uint64_t const*)util::alignUp((uint64_t)m_va->overflow_arg_area, 16);
+
+    m_va->overflow_arg_area = (uint64_t*)area + 2;
+    return x87ToDouble(area[0], (uint16_t)area[1]);
+  }
+
+  double next(ArgType type) { return type == ArgType::LongDouble ? nextLongDouble() : nextDouble(); }
+};
+
+/**
+ * @brief Arguments in call order or, with positional arguments, from a table read in advance
+ *
+ */
+class ArgSource {
+  VaReader        m_reader;
+  ArgValue const* m_table = nullptr;
+  int             m_next  = 0;
+
+  public:
+  explicit ArgSource(SysvVaList* va): m_reader(va) {}
+
+  VaReader& reader() { return m_reader; }
+
+  void setTable(ArgValue const* table) { m_table = table; }
+
+  uint64_t getInt(int pos) {
+    if (m_table == nullptr) return m_reader.nextInt();
+    return m_table[(pos != 0 ? pos : ++m_next) - 1].i;
+  }
+
+  double getDouble(int pos, Length length) {
+    auto const type = length == Length::LongDouble ? ArgType::LongDouble : ArgType::Double;
+    if (m_table == nullptr) return m_reader.next(type);
+    return m_table[(pos != 0 ? pos : ++m_next) - 1].d;
+  }
+};
+
+int parseNum(char const*& p) {
+  int value = 0;
+  for (; *p >= '0' && *p <= '9'; ++p) {
+    value = value > (INT_MAX - 9) / 10 ? INT_MAX : value * 10 + (*p - '0');
+  }
+  return value;
+}
+
+// After '*': "n$" or the next argument
+int parseStarPos(char const*& p) {
+  auto q = p;
+  if (*q < '1' || *q > '9') return 0;
+
+  auto const pos = parseNum(q);
+  if (*q != '$') return 0;
+  p = q + 1;
+  return pos;
+}
+
+/**
+ * @brief Parses everything after '%'. p points behind the conversion afterwards.
+ *
+ */
+void parseSpec(char const*& p, Spec& spec) {
+  if (*p >= '1' && *p <= '9') {
+    auto       q   = p;
+    auto const pos = parseNum(q);
+    if (*q == '$') {
+      spec.argPos = pos;
+      p           = q + 1;
+    }
+  }
+
+  for (;; ++p) {
+    switch (*p) {
+      case '-': spec.flags |= FLAG_LEFT; continue;
+      case '+': spec.flags |= FLAG_PLUS; continue;
+      case ' ': spec.flags |= FLAG_SPACE; continue;
+      case '#': spec.flags |= FLAG_ALT; continue;
+      case '0': spec.flags |= FLAG_ZERO; continue;
+      case '\'': continue; // no grouping in the C locale
+      default: break;
+    }
+    break;
+  }
+
+  if (*p == '*') {
+    ++p;
+    spec.widthPos = parseStarPos(p);
+  } else {
+    spec.width = parseNum(p);
+  }
+
+  if (*p == '.') {
+    ++p;
+    if (*p == '*') {
+      ++p;
+      spec.precPos = parseStarPos(p);
+    } else {
+      spec.prec = parseNum(p);
+    }
+  }
+
+  switch (*p) {
+    case 'h':
+      ++p;
+      if (*p == 'h') {
+        ++p;
+        spec.length = Length::Char;
+      } else {
+        spec.length = Length::Short;
+      }
+      break;
+    case 'l':
+      ++p;
+      if (*p == 'l') {
+        ++p;
+        spec.length = Length::LongLong;
+      } else {
+        spec.length = Length::Long;
+      }
+      break;
+    case 'q':
+      ++p;
+      spec.length = Length::LongLong;
+      break;
+    case 'j':
+      ++p;
+      spec.length = Length::IntMax;
+      break;
+    case 'z':
+      ++p;
+      spec.length = Length::Size;
+      break;
+    case 't':
+      ++p;
+      spec.length = Length::PtrDiff;
+      break;
+    case 'L':
+      ++p;
+      spec.length = Length::LongDouble;
+      break;
+    default: break;
+  }
+
+  spec.conv = *p;
+  if (*p != '\0') ++p;
+}
+
+ArgType getArgType(Spec const& spec) {
+  switch (spec.conv) {
+    case 'd':
+    case 'i':
+    case 'D':
+    case 'o':
+    case 'O':
+    case 'u':
+    case 'U':
+    case 'x':
+    case 'X':
+    case 'c':
+    case 'C':
+    case 's':
+    case 'S':
+    case 'p':
+    case 'n': return ArgType::Int;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': return spec.length == Length::LongDouble ? ArgType::LongDouble : ArgType::Double;
+    default: return ArgType::None;
+  }
+}
+
+/**
+ * @brief Collects the argument types of a format with positional arguments and reads all arguments in order
+ *
+ * @return false: no positional arguments or too many
+ */
+bool loadPositional(char const* format, VaReader& reader, ArgValue* table, bool* error) {
+  std::array<ArgType, MAX_POS_ARGS> types {};
+
+  int  maxPos     = 0;
+  int  next       = 0;
+  bool positional = false;
+
+  auto setType = [&](int pos, ArgType type) {
+    if (pos == 0) {
+      pos = ++next;
+    } else {
+      positional = true;
+    }
+
+    if (pos > MAX_POS_ARGS) return false;
+    types[pos - 1] = type;
+    maxPos         = std::max(maxPos, pos);
+    return true;
+  };
+
+  for (auto p = format; *p != '\0';) {
+    if (*p++ != '%') continue;
+
+    Spec spec;
+    parseSpec(p, spec);
+    if (spec.widthPos >= 0 && !setType(spec.widthPos, ArgType::Int)) return (*error = true);
+    if (spec.precPos >= 0 && !setType(spec.precPos, ArgType::Int)) return (*error = true);
+
+    if (auto const type = getArgType(spec); type != ArgType::None && !setType(spec.argPos, type)) return (*error = true);
+  }
+  if (!positional) return false;
+
+  // Unused positions are taken as int
+  for (int n = 0; n < maxPos; ++n) {
+    if (types[n] == ArgType::Double || types[n] == ArgType::LongDouble) {
+      table[n].d = reader.next(types[n]);
+    } else {
+      table[n].i = reader.nextInt();
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Writes prefix, zeros and body padded to the width
+ *
+ */
+void writeField(FormatBuffer& out, Spec const& spec, bool zeroPad, char const* prefix, size_t prefixLen, size_t zeros, char const* body, size_t bodyLen) {
+  auto const len = prefixLen + zeros + bodyLen;
+  auto const pad = (size_t)spec.width > len ? (size_t)spec.width - len : 0;
+
+  bool const left = (spec.flags & FLAG_LEFT) != 0;
+  zeroPad         = zeroPad && !left;
+
+  if (!left && !zeroPad) out.fill(' ', pad);
+  out.write(prefix, prefixLen);
+  if (zeroPad) out.fill('0', pad);
+  out.fill('0', zeros);
+  out.write(body, bodyLen);
+  if (left) out.fill(' ', pad);
+}
+
+void writeInteger(FormatBuffer& out, Spec const& spec, uint64_t value, char sign, int base, bool upper) {
+  static char const digitsLower[] = "0123456789abcdef";
+  static char const digitsUpper[] = "0123456789ABCDEF";
+
+  auto const digits = upper ? digitsUpper : digitsLower;
+
+  std::array<char, 24> buf;
+  auto const           end = buf.data() + buf.size();
+  auto                 p   = end;
+
+  bool const isZero = value == 0;
+  if (!isZero || spec.prec != 0) {
+    switch (base) {
+      case 10:
+        do {
+          *--p = (char)('0' + value % 10);
+          value /= 10;
+        } while (value != 0);
+        break;
+      case 16:
+        do {
+          *--p = digits[value & 0xf];
+          value >>= 4;
+        } while (value != 0);
+        break;
+      default:
+        do {
+          *--p = (char)('0' + (value & 0x7));
+          value >>= 3;
+        } while (value != 0);
+        break;
+    }
+  }
+
+  // '#' for octal: first digit is a zero
+  if (base == 8 && (spec.flags & FLAG_ALT) != 0 && (p == end || *p != '0')) *--p = '0';
+
+  std::array<char, 2> prefix;
+  size_t              prefixLen = 0;
+  if (sign != '\0') {
+    prefix[prefixLen++] = sign;
+  } else if (base == 16 && (spec.flags & FLAG_ALT) != 0 && (!isZero || spec.conv == 'p')) {
+    prefix[prefixLen++] = '0';
+    prefix[prefixLen++] = upper ? 'X' : 'x';
+  }
+
+  auto const numDigits = (size_t)(end - p);
+  auto const zeros     = spec.prec > 0 && (size_t)spec.prec > numDigits ? (size_t)spec.prec - numDigits : 0;
+  writeField(out, spec, (spec.flags & FLAG_ZERO) != 0 && spec.prec < 0, prefix.data(), prefixLen, zeros, p, numDigits);
+}
+
+int64_t toSigned(uint64_t value, Length length) {
+  switch (length) {
+    case Length::None: return (int32_t)value;
+    case Length::Char: return (int8_t)value;
+    case Length::Short: return (int16_t)value;
+    default: return (int64_t)value;
+  }
+}
+
+uint64_t toUnsigned(uint64_t value, Length length) {
+  switch (length) {
+    case Length::None: return (uint32_t)value;
+    case Length::Char: return (uint8_t)value;
+    case Length::Short: return (uint16_t)value;
+    default: return value;
+  }
+}
+
+// Guest wchar_t is UTF-16
+size_t encodeUtf8(uint32_t cp, char* dst) {
+  if (cp < 0x80) {
+    dst[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    dst[0] = (char)(0xc0 | (cp >> 6));
+    dst[1] = (char)(0x80 | (cp & 0x3f));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    dst[0] = (char)(0xe0 | (cp >> 12));
+    dst[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    dst[2] = (char)(0x80 | (cp & 0x3f));
+    return 3;
+  }
+  dst[0] = (char)(0xf0 | (cp >> 18));
+  dst[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+  dst[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+  dst[3] = (char)(0x80 | (cp & 0x3f));
+  return 4;
+}
+
+/**
+ * @brief Converts at most maxBytes, multibyte sequences are never cut
+ *
+ */
+std::string wideToUtf8(wchar_t const* str, size_t maxBytes) {
+  std::string result;
+  for (auto p = (char16_t const*)str; *p != 0; ++p) {
+    uint32_t cp = *p;
+    if (cp >= 0xd800 && cp < 0xdc00 && p[1] >= 0xdc00 && p[1] < 0xe000) {
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (p[1] - 0xdc00);
+      ++p;
+    }
+
+    char       buf[4];
+    auto const len = encodeUtf8(cp, buf);
+    if (result.size() + len > maxBytes) break;
+    result.append(buf, len);
+  }
+  return result;
+}
+
+/**
+ * @brief %a like FreeBSD: normalized to a leading 1 (subnormals too), without precision only the digits needed
+ *
+ */
+void writeHexFloat(FormatBuffer& out, Spec const& spec, double value, char sign, bool upper) {
+  static char const digitsLower[] = "0123456789abcdef";
+  static char const digitsUpper[] = "0123456789ABCDEF";
+
+  auto const digits = upper ? digitsUpper : digitsLower;
+
+  constexpr int FRAC_DIGITS = 13; // 52 bits
+
+  auto const bits = std::bit_cast<uint64_t>(value);
+  uint64_t   lead = 1;
+  uint64_t   frac = bits & ((1ull << 52) - 1);
+  int        exp  = (int)((bits >> 52) & 0x7ff) - 1023;
+  if (exp == -1023) {
+    if (frac == 0) {
+      lead = 0;
+      exp  = 0;
+    } else {
+      for (exp = -1022; (frac & (1ull << 52)) == 0; --exp)
+        frac <<= 1;
+      frac &= (1ull << 52) - 1;
+    }
+  }
+
+  // frac holds numDigits hex digits
+  int numDigits = FRAC_DIGITS;
+  if (spec.prec >= 0 && spec.prec < FRAC_DIGITS) {
+    // Round to nearest even, 0x1.f -> 0x2
+    auto const shift = (FRAC_DIGITS - spec.prec) * 4;
+    auto const full  = (lead << 52) | frac;
+    auto const rem   = full & ((1ull << shift) - 1);
+    auto const half  = 1ull << (shift - 1);
+
+    auto rounded = full >> shift;
+    if (rem > half || (rem == half && (rounded & 1) != 0)) ++rounded;
+
+    numDigits = spec.prec;
+    lead      = rounded >> (numDigits * 4);
+    frac      = rounded & ((1ull << (numDigits * 4)) - 1);
+  } else if (spec.prec < 0) {
+    for (; numDigits > 0 && (frac & 0xf) == 0; --numDigits)
+      frac >>= 4;
+  }
+
+  std::string body;
+  body += digits[lead];
+  if (numDigits > 0 || spec.prec > 0 || (spec.flags & FLAG_ALT) != 0) body += '.';
+  for (int n = numDigits; n-- > 0;)
+    body += digits[(frac >> (n * 4)) & 0xf];
+  if (spec.prec > numDigits) body.append((size_t)(spec.prec - numDigits), '0');
+
+  body += upper ? 'P' : 'p';
+  body += exp < 0 ? '-' : '+';
+  body += std::to_string(std::abs(exp));
+
+  std::array<char, 3> prefix;
+  size_t              prefixLen = 0;
+  if (sign != '\0') prefix[prefixLen++] = sign;
+  prefix[prefixLen++] = '0';
+  prefix[prefixLen++] = upper ? 'X' : 'x';
+
+  writeField(out, spec, (spec.flags & FLAG_ZERO) != 0, prefix.data(), prefixLen, 0, body.data(), body.size());
+}
+
+void writeFloat(FormatBuffer& out, Spec const& spec, double value) {
+  bool const upper = spec.conv >= 'A' && spec.conv <= 'Z';
+  char const sign  = std::signbit(value) ? '-' : (spec.flags & FLAG_PLUS) != 0 ? '+' : (spec.flags & FLAG_SPACE) != 0 ? ' ' : '\0';
+
+  // Host CRTs differ here (1.#INF, -nan(ind)). FreeBSD: no zero padding, nan without sign
+  if (!std::isfinite(value)) {
+    bool const isNan = std::isnan(value);
+    writeField(out, spec, false, &sign, isNan || sign == '\0' ? 0 : 1, 0, isNan ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf"), 3);
+    return;
+  }
+
+  if (spec.conv == 'a' || spec.conv == 'A') {
+    writeHexFloat(out, spec, value, sign, upper);
+    return;
+  }
+
+  // The host does the decimal digits, flags are the same
+  std::array<char, 16> hostFormat;
+  auto                 f = hostFormat.data();
+
+  *f++ = '%';
+  if ((spec.flags & FLAG_LEFT) != 0) *f++ = '-';
+  if ((spec.flags & FLAG_PLUS) != 0) *f++ = '+';
+  if ((spec.flags & FLAG_SPACE) != 0) *f++ = ' ';
+  if ((spec.flags & FLAG_ALT) != 0) *f++ = '#';
+  if ((spec.flags & FLAG_ZERO) != 0) *f++ = '0';
+  *f++ = '*';
+  if (spec.prec >= 0) {
+    *f++ = '.';
+    *f++ = '*';
+  }
+  *f++ = spec.conv;
+  *f   = '\0';
+
+  std::array<char, 512> buf;
+
+  auto format = [&](char* dst, size_t size) {
+    return spec.prec >= 0 ? std::snprintf(dst, size, hostFormat.data(), spec.width, spec.prec, value)
+                          : std::snprintf(dst, size, hostFormat.data(), spec.width, value);
+  };
+
+  auto const len = format(buf.data(), buf.size());
+  if (len < 0) return;
+
+  if ((size_t)len < buf.size()) {
+    out.write(buf.data(), (size_t)len);
+  } else {
+    std::string large((size_t)len, '\0');
+    format(large.data(), large.size() + 1);
+    out.write(large.data(), large.size());
+  }
+}
+
+void writeCount(void* ptr, Length length, uint64_t count) {
+  switch (length) {
+    case Length::Char: *(int8_t*)ptr = (int8_t)count; break;
+    case Length::Short: *(int16_t*)ptr = (int16_t)count; break;
+    case Length::None: *(int32_t*)ptr = (int32_t)count; break;
+    default: *(int64_t*)ptr = (int64_t)count; break;
+  }
+}
+
+/**
+ * @brief Guest stdout, collected to whole lines
+ *
+ */
+class StdoutSink {
+  std::mutex            m_mutex;
+  std::array<char, 512> m_line;
+  size_t                m_size = 0;
+
+  void emit() {
+    LOG_USE_MODULE(printf);
+
+    m_line[m_size] = '\0';
+    LOG_DEBUG(L"%S", m_line.data());
+    m_size = 0;
+  }
+
+  void append(char const* data, size_t size) {
+    while (size > 0) {
+      auto const num = std::min(size, m_line.size() - 1 - m_size);
+      std::memcpy(m_line.data() + m_size, data, num);
+      m_size += num;
+      data += num;
+      size -= num;
+      if (m_size == m_line.size() - 1) emit();
+    }
+  }
+
+  public:
+  ~StdoutSink() { flush(); }
+
+  void write(char const* data, size_t size) {
+    std::unique_lock const lock(m_mutex);
+
+    while (size > 0) {
+      auto const newLine = (char const*)std::memchr(data, '\n', size);
+      if (newLine == nullptr) {
+        append(data, size);
+        break;
+      }
+
+      auto const len = (size_t)(newLine - data);
+      append(data, len);
+      emit();
+      data += len + 1;
+      size -= len + 1;
+    }
+  }
+
+  void flush() {
+    std::unique_lock const lock(m_mutex);
+    if (m_size > 0) emit();
+  }
+};
+
+StdoutSink& accessStdoutSink() {
+  static StdoutSink inst;
+  return inst;
+}
+
+void writeStdout(void*, char const* data, size_t size) {
+  accessStdoutSink().write(data, size);
+}
+} // namespace
+
+void FormatBuffer::write(char const* data, size_t size) {
+  m_count += size;
+  while (size > 0) {
+    if (m_pos == m_capacity) {
+      flush();
+      if (m_pos == m_capacity) return; // truncated
+    }
+
+    auto const num = std::min(size, m_capacity - m_pos);
+    std::memcpy(m_buf + m_pos, data, num);
+    m_pos += num;
+    data += num;
+    size -= num;
+  }
+}
+
+void FormatBuffer::fill(char c, size_t num) {
+  m_count += num;
+  while (num > 0) {
+    if (m_pos == m_capacity) {
+      flush();
+      if (m_pos == m_capacity) return; // truncated
+    }
+
+    auto const len = std::min(num, m_capacity - m_pos);
+    std::memset(m_buf + m_pos, c, len);
+    m_pos += len;
+    num -= len;
+  }
+}
+
+void FormatBuffer::flush() {
+  if (m_flush == nullptr || m_pos == 0) return;
+  m_flush(m_user, m_buf, m_pos);
+  m_pos = 0;
+}
+
+int formatString(FormatBuffer& out, char const* format, SysvVaList* va) {
+  ArgSource args(va);
+
+  std::array<ArgValue, MAX_POS_ARGS> table;
+  if (std::strchr(format, '$') != nullptr) {
+    bool error = false;
+    if (loadPositional(format, args.reader(), table.data(), &error)) args.setTable(table.data());
+    if (error) return -1;
+  }
+
+  for (auto p = format;;) {
+    auto const start = p;
+    while (*p != '\0' && *p != '%')
+      ++p;
+    out.write(start, (size_t)(p - start));
+    if (*p == '\0') break;
+    ++p;
+
+    Spec spec;
+    parseSpec(p, spec);
+
+    if (spec.widthPos >= 0) {
+      auto const width = (int32_t)args.getInt(spec.widthPos);
+      if (width < 0) {
+        // negative width: left aligned
+        spec.flags |= FLAG_LEFT;
+        spec.width = width == INT_MIN ? INT_MAX : -width;
+      } else {
+        spec.width = width;
+      }
+    }
+    if (spec.precPos >= 0) {
+      auto const prec = (int32_t)args.getInt(spec.precPos);
+      spec.prec       = prec < 0 ? -1 : prec;
+    }
+
+    switch (spec.conv) {
+      case '\0': return out.count() > INT_MAX ? -1 : (int)out.count();
+
+      case 'D': spec.length = Length::Long; [[fallthrough]];
+      case 'd':
+      case 'i': {
+        auto const value = toSigned(args.getInt(spec.argPos), spec.length);
+
+        char sign = '\0';
+        if (value < 0) {
+          sign = '-';
+        } else if ((spec.flags & FLAG_PLUS) != 0) {
+          sign = '+';
+        } else if ((spec.flags & FLAG_SPACE) != 0) {
+          sign = ' ';
+        }
+        writeInteger(out, spec, value < 0 ? 0 - (uint64_t)value : (uint64_t)value, sign, 10, false);
+      } break;
+
+      case 'U': spec.length = Length::Long; [[fallthrough]];
+      case 'u': writeInteger(out, spec, toUnsigned(args.getInt(spec.argPos), spec.length), '\0', 10, false); break;
+
+      case 'O': spec.length = Length::Long; [[fallthrough]];
+      case 'o': writeInteger(out, spec, toUnsigned(args.getInt(spec.argPos), spec.length), '\0', 8, false); break;
+
+      case 'x':
+      case 'X': writeInteger(out, spec, toUnsigned(args.getInt(spec.argPos), spec.length), '\0', 16, spec.conv == 'X'); break;
+
+      case 'p':
+        spec.flags |= FLAG_ALT;
+        writeInteger(out, spec, args.getInt(spec.argPos), '\0', 16, false);
+        break;
+
+      case 'C': spec.length = Length::Long; [[fallthrough]];
+      case 'c': {
+        auto const value = args.getInt(spec.argPos);
+        if (spec.length == Length::Long) {
+          char       buf[4];
+          auto const len = encodeUtf8((char16_t)value, buf);
+          writeField(out, spec, (spec.flags & FLAG_ZERO) != 0, nullptr, 0, 0, buf, len);
+        } else {
+          auto const c = (char)value;
+          writeField(out, spec, (spec.flags & FLAG_ZERO) != 0, nullptr, 0, 0, &c, 1);
+        }
+      } break;
+
+      case 'S': spec.length = Length::Long; [[fallthrough]];
+      case 's': {
+        auto const ptr     = (void const*)args.getInt(spec.argPos);
+        auto const maxSize = spec.prec >= 0 ? (size_t)spec.prec : SIZE_MAX;
+        bool const zeroPad = (spec.flags & FLAG_ZERO) != 0;
+
+        if (ptr == nullptr) {
+          static char const null[] = "(null)";
+          writeField(out, spec, zeroPad, nullptr, 0, 0, null, std::min(sizeof(null) - 1, maxSize));
+        } else if (spec.length == Length::Long) {
+          auto const str = wideToUtf8((wchar_t const*)ptr, maxSize);
+          writeField(out, spec, zeroPad, nullptr, 0, 0, str.data(), str.size());
+        } else {
+          auto const str = (char const*)ptr;
+          writeField(out, spec, zeroPad, nullptr, 0, 0, str, spec.prec >= 0 ? strnlen(str, maxSize) : std::strlen(str));
+        }
+      } break;
+
+      case 'n': {
+        auto const ptr = (void*)args.getInt(spec.argPos);
+        if (ptr != nullptr) writeCount(ptr, spec.length, out.count());
+      } break;
+
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A': writeFloat(out, spec, args.getDouble(spec.argPos, spec.length)); break;
+
+      default: {
+        // Unknown conversions (and "%%") are printed as the character itself
+        auto const c = spec.conv;
+        writeField(out, spec, (spec.flags & FLAG_ZERO) != 0, nullptr, 0, 0, &c, 1);
+      } break;
+    }
+  }
+
+  return out.count() > INT_MAX ? -1 : (int)out.count();
+}
+
+void flushStdout() {
+  accessStdoutSink().flush();
+}
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x)  STRINGIFY_(x)
+
+/**
+ * @brief Body of a variadic export. va_start isn't available for sysv_abi functions on Windows:
+ * spills the argument registers, builds a SysvVaList on the stack and calls target with it as argument (numFixed + 1).
+ *
+ */
+#define SYSV_VARARGS_THUNK(numFixed, vaListReg, target)                                                                                                        \
+  __asm__ volatile("push %rbp\n"                                                                                                                               \
+                   "mov %rsp, %rbp\n"                                                                                                                          \
+                   "sub $208, %rsp\n"                                                                                                                          \
+                   "mov %rdi, 0(%rsp)\n"                                                                                                                       \
+                   "mov %rsi, 8(%rsp)\n"                                                                                                                       \
+                   "mov %rdx, 16(%rsp)\n"                                                                                                                      \
+                   "mov %rcx, 24(%rsp)\n"                                                                                                                      \
+                   "mov %r8, 32(%rsp)\n"                                                                                                                       \
+                   "mov %r9, 40(%rsp)\n"                                                                                                                       \
+                   "test %al, %al\n"                                                                                                                           \
+                   "je 1f\n"                                                                                                                                   \
+                   "movaps %xmm0, 48(%rsp)\n"                                                                                                                  \
+                   "movaps %xmm1, 64(%rsp)\n"                                                                                                                  \
+                   "movaps %xmm2, 80(%rsp)\n"                                                                                                                  \
+                   "movaps %xmm3, 96(%rsp)\n"                                                                                                                  \
+                   "movaps %xmm4, 112(%rsp)\n"                                                                                                                 \
+                   "movaps %xmm5, 128(%rsp)\n"                                                                                                                 \
+                   "movaps %xmm6, 144(%rsp)\n"                                                                                                                 \
+                   "movaps %xmm7, 160(%rsp)\n"                                                                                                                 \
+                   "1:\n"                                                                                                                                      \
+                   "movl $" #numFixed "*8, 176(%rsp)\n"                                                                                                        \
+                   "movl $48, 180(%rsp)\n"                                                                                                                     \
+                   "lea 16(%rbp), %rax\n"                                                                                                                      \
+                   "mov %rax, 184(%rsp)\n"                                                                                                                     \
+                   "mov %rsp, 192(%rsp)\n"                                                                                                                     \
+                   "lea 176(%rsp), %" vaListReg "\n"                                                                                                           \
+                   "call " STRINGIFY(target) "\n"                                                                                                              \
+                   "leave\n"                                                                                                                                   \
+                   "ret\n")
+
+extern "C" {
+
+EXPORT SYSV_ABI int __NID(vsnprintf)(char* s, size_t n, const char* format, SysvVaList* args) {
+  FormatBuffer out(s, n > 0 ? n - 1 : 0);
+
+  auto const ret = formatString(out, format, args);
+  if (n > 0) s[out.size()] = '\0';
+  return ret;
+}
+
+EXPORT SYSV_ABI int __NID(vsprintf)(char* s, const char* format, SysvVaList* args) {
+  FormatBuffer out(s, SIZE_MAX);
+
+  auto const ret = formatString(out, format, args);
+  s[out.size()]  = '\0';
+  return ret;
+}
+
+EXPORT SYSV_ABI int __NID(vprintf)(const char* format, SysvVaList* args) {
+  std::array<char, 512> buf;
+  FormatBuffer          out(buf.data(), buf.size(), writeStdout, nullptr);
+
+  auto const ret = formatString(out, format, args);
+  out.flush();
+  return ret;
+}
+
+EXPORT SYSV_ABI __attribute__((naked)) int __NID(snprintf)(char* s, size_t n, const char* format, ...) {
+  SYSV_VARARGS_THUNK(3, "rcx", __NID(vsnprintf));
+}
+
+EXPORT SYSV_ABI __attribute__((naked)) int __NID(sprintf)(char* s, const char* format, ...) {
+  SYSV_VARARGS_THUNK(2, "rdx", __NID(vsprintf));
+}
+
+EXPORT SYSV_ABI __attribute__((naked)) int __NID(printf)(const char* format, ...) {
+  SYSV_VARARGS_THUNK(1, "rsi", __NID(vprintf));
+}
+}
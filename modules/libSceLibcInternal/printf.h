@@ -0,0 +1,74 @@
+#pragma once
+#include "types.h"
+#include "utility/utility.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Output of formatString(). Writes into a fixed buffer, a full buffer is handed to the flush callback.
+ * Without callback the output is truncated, count() still returns the full length.
+ *
+ */
+class FormatBuffer {
+  CLASS_NO_COPY(FormatBuffer);
+  CLASS_NO_MOVE(FormatBuffer);
+
+  public:
+  using flush_t = void (*)(void* user, char const* data, size_t size);
+
+  FormatBuffer(char* buf, size_t capacity): m_buf(buf), m_capacity(capacity) {}
+
+  FormatBuffer(char* buf, size_t capacity, flush_t flush, void* user): m_buf(buf), m_capacity(capacity), m_flush(flush), m_user(user) {}
+
+  void put(char c) {
+    if (m_pos == m_capacity) flush();
+    if (m_pos < m_capacity) m_buf[m_pos++] = c;
+    ++m_count;
+  }
+
+  void write(char const* data, size_t size);
+  void fill(char c, size_t num);
+
+  /**
+   * @brief Hands the buffered data to the callback
+   *
+   */
+  void flush();
+
+  /**
+   * @brief Bytes written into the buffer (since the last flush)
+   *
+   */
+  size_t size() const { return m_pos; }
+
+  /**
+   * @brief Total length of the output
+   *
+   */
+  uint64_t count() const { return m_count; }
+
+  private:
+  char*  m_buf;
+  size_t m_capacity;
+  size_t m_pos = 0;
+
+  flush_t m_flush = nullptr;
+  void*   m_user  = nullptr;
+
+  uint64_t m_count = 0;
+};
+
+/**
+ * @brief vfprintf of FreeBSD's libc (flags, width, precision, length modifiers, positional arguments and %n)
+ *
+ * @param args is consumed like va_arg does
+ * @return the length of the output or -1 on error
+ */
+int formatString(FormatBuffer& out, char const* format, SysvVaList* args);
+
+/**
+ * @brief Writes all buffered guest stdout
+ *
+ */
+void flushStdout();
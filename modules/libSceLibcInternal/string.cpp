@@ -0,0 +1,658 @@
+#include "common.h"
+#include "logging.h"
+#include "types.h"
+
+#include <bit>
+#include <cstring>
+#include <immintrin.h>
+#include <intrin.h>
+
+LOG_DEFINE_MODULE(libcString);
+
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx2,avx512f")))
+
+namespace {
+constexpr size_t NT_THRESHOLD = 4 * 1024 * 1024; // Larger copies bypass the cache
+constexpr size_t PAGE_SIZE    = 4096;
+
+using memcpy_t  = void* (*)(void* dst, void const* src, size_t n);
+using memset_t  = void* (*)(void* dst, int c, size_t n);
+using strlen_t  = size_t (*)(char const* str);
+using memcmp_t  = int (*)(void const* lhs, void const* rhs, size_t n);
+using strcmp_t  = int (*)(char const* lhs, char const* rhs);
+
+template <typename T>
+T loadu(void const* src) {
+  T value;
+  std::memcpy(&value, src, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void storeu(void* dst, T value) {
+  std::memcpy(dst, &value, sizeof(T));
+}
+
+// ### Sizes <= 32. Everything is loaded before the first store -> overlap safe
+inline void copySmall(uint8_t* d, uint8_t const* s, size_t n) {
+  if (n >= 16) {
+    auto const a = _mm_loadu_si128((__m128i const*)s);
+    auto const b = _mm_loadu_si128((__m128i const*)(s + n - 16));
+    _mm_storeu_si128((__m128i*)d, a);
+    _mm_storeu_si128((__m128i*)(d + n - 16), b);
+  } else if (n >= 8) {
+    auto const a = loadu<uint64_t>(s);
+    auto const b = loadu<uint64_t>(s + n - 8);
+    storeu(d, a);
+    storeu(d + n - 8, b);
+  } else if (n >= 4) {
+    auto const a = loadu<uint32_t>(s);
+    auto const b = loadu<uint32_t>(s + n - 4);
+    storeu(d, a);
+    storeu(d + n - 4, b);
+  } else if (n >= 2) {
+    auto const a = loadu<uint16_t>(s);
+    auto const b = loadu<uint16_t>(s + n - 2);
+    storeu(d, a);
+    storeu(d + n - 2, b);
+  } else if (n == 1) {
+    *d = *s;
+  }
+}
+
+inline void setSmall(uint8_t* d, uint8_t c, size_t n) {
+  auto const c64 = 0x0101010101010101ull * c;
+  if (n >= 16) {
+    auto const v = _mm_set1_epi8((char)c);
+    _mm_storeu_si128((__m128i*)d, v);
+    _mm_storeu_si128((__m128i*)(d + n - 16), v);
+  } else if (n >= 8) {
+    storeu(d, c64);
+    storeu(d + n - 8, c64);
+  } else if (n >= 4) {
+    storeu(d, (uint32_t)c64);
+    storeu(d + n - 4, (uint32_t)c64);
+  } else if (n >= 2) {
+    storeu(d, (uint16_t)c64);
+    storeu(d + n - 2, (uint16_t)c64);
+  } else if (n == 1) {
+    *d = c;
+  }
+}
+
+// ### SSE2 (baseline)
+
+/**
+ * @brief n > 64. Head and tail are stored unaligned, the middle with aligned stores
+ *
+ */
+void copyForwardSse2(uint8_t* d, uint8_t const* s, size_t n, bool allowNt) {
+  auto const head = _mm_loadu_si128((__m128i const*)s);
+  auto const tail = _mm_loadu_si128((__m128i const*)(s + n - 16));
+  auto const dst  = d;
+  auto const dEnd = d + n;
+
+  auto const skip = 16 - ((uintptr_t)d & 15);
+  d += skip;
+  s += skip;
+  n -= skip;
+
+  if (allowNt && n >= NT_THRESHOLD) {
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+      auto const a = _mm_loadu_si128((__m128i const*)s);
+      auto const b = _mm_loadu_si128((__m128i const*)(s + 16));
+      auto const c = _mm_loadu_si128((__m128i const*)(s + 32));
+      auto const e = _mm_loadu_si128((__m128i const*)(s + 48));
+      _mm_stream_si128((__m128i*)d, a);
+      _mm_stream_si128((__m128i*)(d + 16), b);
+      _mm_stream_si128((__m128i*)(d + 32), c);
+      _mm_stream_si128((__m128i*)(d + 48), e);
+    }
+    _mm_sfence();
+  } else {
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+      auto const a = _mm_loadu_si128((__m128i const*)s);
+      auto const b = _mm_loadu_si128((__m128i const*)(s + 16));
+      auto const c = _mm_loadu_si128((__m128i const*)(s + 32));
+      auto const e = _mm_loadu_si128((__m128i const*)(s + 48));
+      _mm_store_si128((__m128i*)d, a);
+      _mm_store_si128((__m128i*)(d + 16), b);
+      _mm_store_si128((__m128i*)(d + 32), c);
+      _mm_store_si128((__m128i*)(d + 48), e);
+    }
+  }
+
+  for (; n >= 16; n -= 16, d += 16, s += 16) {
+    _mm_store_si128((__m128i*)d, _mm_loadu_si128((__m128i const*)s));
+  }
+
+  _mm_storeu_si128((__m128i*)dst, head);
+  _mm_storeu_si128((__m128i*)(dEnd - 16), tail);
+}
+
+void copyBackwardSse2(uint8_t* d, uint8_t const* s, size_t n) {
+  auto const head = _mm_loadu_si128((__m128i const*)s);
+  auto const tail = _mm_loadu_si128((__m128i const*)(s + n - 16));
+  auto const dst  = d;
+  auto const dEnd = d + n;
+
+  auto const skip = (uintptr_t)dEnd & 15;
+  auto       pd   = dEnd - skip;
+  auto       ps   = s + n - skip;
+  n -= skip;
+
+  for (; n >= 64; n -= 64) {
+    pd -= 64;
+    ps -= 64;
+    auto const a = _mm_loadu_si128((__m128i const*)ps);
+    auto const b = _mm_loadu_si128((__m128i const*)(ps + 16));
+    auto const c = _mm_loadu_si128((__m128i const*)(ps + 32));
+    auto const e = _mm_loadu_si128((__m128i const*)(ps + 48));
+    _mm_store_si128((__m128i*)pd, a);
+    _mm_store_si128((__m128i*)(pd + 16), b);
+    _mm_store_si128((__m128i*)(pd + 32), c);
+    _mm_store_si128((__m128i*)(pd + 48), e);
+  }
+
+  for (; n >= 16; n -= 16) {
+    pd -= 16;
+    ps -= 16;
+    _mm_store_si128((__m128i*)pd, _mm_loadu_si128((__m128i const*)ps));
+  }
+
+  _mm_storeu_si128((__m128i*)dst, head);
+  _mm_storeu_si128((__m128i*)(dEnd - 16), tail);
+}
+
+/**
+ * @brief Copies n <= 64 with all loads first
+ *
+ */
+inline void copyUpTo64Sse2(uint8_t* d, uint8_t const* s, size_t n) {
+  if (n <= 32) return copySmall(d, s, n);
+
+  auto const a = _mm_loadu_si128((__m128i const*)s);
+  auto const b = _mm_loadu_si128((__m128i const*)(s + 16));
+  auto const c = _mm_loadu_si128((__m128i const*)(s + n - 32));
+  auto const e = _mm_loadu_si128((__m128i const*)(s + n - 16));
+  _mm_storeu_si128((__m128i*)d, a);
+  _mm_storeu_si128((__m128i*)(d + 16), b);
+  _mm_storeu_si128((__m128i*)(d + n - 32), c);
+  _mm_storeu_si128((__m128i*)(d + n - 16), e);
+}
+
+void* memcpySse2(void* dst, void const* src, size_t n) {
+  auto d = (uint8_t*)dst;
+  auto s = (uint8_t const*)src;
+
+  if (n <= 64) {
+    copyUpTo64Sse2(d, s, n);
+  } else {
+    copyForwardSse2(d, s, n, true);
+  }
+  return dst;
+}
+
+void* memmoveSse2(void* dst, void const* src, size_t n) {
+  auto d = (uint8_t*)dst;
+  auto s = (uint8_t const*)src;
+
+  if (n <= 64) {
+    copyUpTo64Sse2(d, s, n);
+  } else if ((uintptr_t)d - (uintptr_t)s >= n) {
+    // dst before src or no overlap
+    copyForwardSse2(d, s, n, (uintptr_t)s - (uintptr_t)d >= n);
+  } else {
+    copyBackwardSse2(d, s, n);
+  }
+  return dst;
+}
+
+void* memsetSse2(void* dst, int c, size_t n) {
+  auto d = (uint8_t*)dst;
+  if (n <= 32) {
+    setSmall(d, (uint8_t)c, n);
+    return dst;
+  }
+
+  auto const v    = _mm_set1_epi8((char)c);
+  auto const dEnd = d + n;
+  _mm_storeu_si128((__m128i*)d, v);
+  _mm_storeu_si128((__m128i*)(dEnd - 16), v);
+  if (n <= 64) {
+    _mm_storeu_si128((__m128i*)(d + 16), v);
+    _mm_storeu_si128((__m128i*)(dEnd - 32), v);
+    return dst;
+  }
+
+  auto const skip = 16 - ((uintptr_t)d & 15);
+  d += skip;
+  n -= skip;
+
+  if (n >= NT_THRESHOLD) {
+    for (; n >= 64; n -= 64, d += 64) {
+      _mm_stream_si128((__m128i*)d, v);
+      _mm_stream_si128((__m128i*)(d + 16), v);
+      _mm_stream_si128((__m128i*)(d + 32), v);
+      _mm_stream_si128((__m128i*)(d + 48), v);
+    }
+    _mm_sfence();
+  }
+  for (; n >= 16; n -= 16, d += 16) {
+    _mm_store_si128((__m128i*)d, v);
+  }
+  return dst;
+}
+
+size_t strlenSse2(char const* str) {
+  // Aligned loads never cross a page
+  auto const misalign = (uintptr_t)str & 15;
+  auto       p        = str - misalign;
+  auto const zero     = _mm_setzero_si128();
+
+  uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const*)p), zero)) >> misalign;
+  if (mask != 0) return std::countr_zero(mask);
+
+  for (;;) {
+    p += 16;
+    mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const*)p), zero));
+    if (mask != 0) return (size_t)(p - str) + std::countr_zero(mask);
+  }
+}
+
+int memcmpSse2(void const* lhs, void const* rhs, size_t n) {
+  auto a = (uint8_t const*)lhs;
+  auto b = (uint8_t const*)rhs;
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto const mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(a + i)), _mm_loadu_si128((__m128i const*)(b + i)))) ^ 0xffff;
+    if (mask != 0) {
+      auto const k = i + std::countr_zero(mask);
+      return (int)a[k] - (int)b[k];
+    }
+  }
+
+  for (; i < n; ++i) {
+    if (a[i] != b[i]) return (int)a[i] - (int)b[i];
+  }
+  return 0;
+}
+
+int strcmpSse2(char const* lhs, char const* rhs) {
+  auto a = (uint8_t const*)lhs;
+  auto b = (uint8_t const*)rhs;
+
+  auto const zero = _mm_setzero_si128();
+  for (;;) {
+    if (((uintptr_t)a & (PAGE_SIZE - 1)) <= PAGE_SIZE - 16 && ((uintptr_t)b & (PAGE_SIZE - 1)) <= PAGE_SIZE - 16) {
+      auto const va = _mm_loadu_si128((__m128i const*)a);
+      auto const vb = _mm_loadu_si128((__m128i const*)b);
+
+      auto const diff = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+      auto const end  = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, zero));
+      if ((diff | end) != 0) {
+        auto const k = std::countr_zero(diff | end);
+        return (int)a[k] - (int)b[k];
+      }
+      a += 16;
+      b += 16;
+    } else {
+      // Near a page end, go bytewise
+      if (*a != *b || *a == 0) return (int)*a - (int)*b;
+      ++a;
+      ++b;
+    }
+  }
+}
+
+// ### AVX2
+
+TARGET_AVX2 void copyForwardAvx2(uint8_t* d, uint8_t const* s, size_t n, bool allowNt) {
+  auto const head = _mm256_loadu_si256((__m256i const*)s);
+  auto const tail = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+  auto const dst  = d;
+  auto const dEnd = d + n;
+
+  auto const skip = 32 - ((uintptr_t)d & 31);
+  d += skip;
+  s += skip;
+  n -= skip;
+
+  if (allowNt && n >= NT_THRESHOLD) {
+    for (; n >= 128; n -= 128, d += 128, s += 128) {
+      auto const a = _mm256_loadu_si256((__m256i const*)s);
+      auto const b = _mm256_loadu_si256((__m256i const*)(s + 32));
+      auto const c = _mm256_loadu_si256((__m256i const*)(s + 64));
+      auto const e = _mm256_loadu_si256((__m256i const*)(s + 96));
+      _mm256_stream_si256((__m256i*)d, a);
+      _mm256_stream_si256((__m256i*)(d + 32), b);
+      _mm256_stream_si256((__m256i*)(d + 64), c);
+      _mm256_stream_si256((__m256i*)(d + 96), e);
+    }
+    _mm_sfence();
+  } else {
+    for (; n >= 128; n -= 128, d += 128, s += 128) {
+      auto const a = _mm256_loadu_si256((__m256i const*)s);
+      auto const b = _mm256_loadu_si256((__m256i const*)(s + 32));
+      auto const c = _mm256_loadu_si256((__m256i const*)(s + 64));
+      auto const e = _mm256_loadu_si256((__m256i const*)(s + 96));
+      _mm256_store_si256((__m256i*)d, a);
+      _mm256_store_si256((__m256i*)(d + 32), b);
+      _mm256_store_si256((__m256i*)(d + 64), c);
+      _mm256_store_si256((__m256i*)(d + 96), e);
+    }
+  }
+
+  for (; n >= 32; n -= 32, d += 32, s += 32) {
+    _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((__m256i const*)s));
+  }
+
+  _mm256_storeu_si256((__m256i*)dst, head);
+  _mm256_storeu_si256((__m256i*)(dEnd - 32), tail);
+}
+
+TARGET_AVX2 void copyBackwardAvx2(uint8_t* d, uint8_t const* s, size_t n) {
+  auto const head = _mm256_loadu_si256((__m256i const*)s);
+  auto const tail = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+  auto const dst  = d;
+  auto const dEnd = d + n;
+
+  auto const skip = (uintptr_t)dEnd & 31;
+  auto       pd   = dEnd - skip;
+  auto       ps   = s + n - skip;
+  n -= skip;
+
+  for (; n >= 128; n -= 128) {
+    pd -= 128;
+    ps -= 128;
+    auto const a = _mm256_loadu_si256((__m256i const*)ps);
+    auto const b = _mm256_loadu_si256((__m256i const*)(ps + 32));
+    auto const c = _mm256_loadu_si256((__m256i const*)(ps + 64));
+    auto const e = _mm256_loadu_si256((__m256i const*)(ps + 96));
+    _mm256_store_si256((__m256i*)pd, a);
+    _mm256_store_si256((__m256i*)(pd + 32), b);
+    _mm256_store_si256((__m256i*)(pd + 64), c);
+    _mm256_store_si256((__m256i*)(pd + 96), e);
+  }
+
+  for (; n >= 32; n -= 32) {
+    pd -= 32;
+    ps -= 32;
+    _mm256_store_si256((__m256i*)pd, _mm256_loadu_si256((__m256i const*)ps));
+  }
+
+  _mm256_storeu_si256((__m256i*)dst, head);
+  _mm256_storeu_si256((__m256i*)(dEnd - 32), tail);
+}
+
+/**
+ * @brief Copies n <= 128 with all loads first
+ *
+ */
+TARGET_AVX2 inline void copyUpTo128Avx2(uint8_t* d, uint8_t const* s, size_t n) {
+  if (n <= 32) return copySmall(d, s, n);
+
+  if (n <= 64) {
+    auto const a = _mm256_loadu_si256((__m256i const*)s);
+    auto const b = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+    _mm256_storeu_si256((__m256i*)d, a);
+    _mm256_storeu_si256((__m256i*)(d + n - 32), b);
+    return;
+  }
+
+  auto const a = _mm256_loadu_si256((__m256i const*)s);
+  auto const b = _mm256_loadu_si256((__m256i const*)(s + 32));
+  auto const c = _mm256_loadu_si256((__m256i const*)(s + n - 64));
+  auto const e = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+  _mm256_storeu_si256((__m256i*)d, a);
+  _mm256_storeu_si256((__m256i*)(d + 32), b);
+  _mm256_storeu_si256((__m256i*)(d + n - 64), c);
+  _mm256_storeu_si256((__m256i*)(d + n - 32), e);
+}
+
+TARGET_AVX2 void* memcpyAvx2(void* dst, void const* src, size_t n) {
+  auto d = (uint8_t*)dst;
+  auto s = (uint8_t const*)src;
+
+  if (n <= 128) {
+    copyUpTo128Avx2(d, s, n);
+  } else {
+    copyForwardAvx2(d, s, n, true);
+  }
+  return dst;
+}
+
+TARGET_AVX2 void* memmoveAvx2(void* dst, void const* src, size_t n) {
+  auto d = (uint8_t*)dst;
+  auto s = (uint8_t const*)src;
+
+  if (n <= 128) {
+    copyUpTo128Avx2(d, s, n);
+  } else if ((uintptr_t)d - (uintptr_t)s >= n) {
+    // dst before src or no overlap
+    copyForwardAvx2(d, s, n, (uintptr_t)s - (uintptr_t)d >= n);
+  } else {
+    copyBackwardAvx2(d, s, n);
+  }
+  return dst;
+}
+
+TARGET_AVX2 void* memsetAvx2(void* dst, int c, size_t n) {
+  auto d = (uint8_t*)dst;
+  if (n <= 32) {
+    setSmall(d, (uint8_t)c, n);
+    return dst;
+  }
+
+  auto const v    = _mm256_set1_epi8((char)c);
+  auto const dEnd = d + n;
+  _mm256_storeu_si256((__m256i*)d, v);
+  _mm256_storeu_si256((__m256i*)(dEnd - 32), v);
+  if (n <= 64) return dst;
+
+  auto const skip = 32 - ((uintptr_t)d & 31);
+  d += skip;
+  n -= skip;
+
+  if (n >= NT_THRESHOLD) {
+    for (; n >= 128; n -= 128, d += 128) {
+      _mm256_stream_si256((__m256i*)d, v);
+      _mm256_stream_si256((__m256i*)(d + 32), v);
+      _mm256_stream_si256((__m256i*)(d + 64), v);
+      _mm256_stream_si256((__m256i*)(d + 96), v);
+    }
+    _mm_sfence();
+  } else {
+    for (; n >= 128; n -= 128, d += 128) {
+      _mm256_store_si256((__m256i*)d, v);
+      _mm256_store_si256((__m256i*)(d + 32), v);
+      _mm256_store_si256((__m256i*)(d + 64), v);
+      _mm256_store_si256((__m256i*)(d + 96), v);
+    }
+  }
+  for (; n >= 32; n -= 32, d += 32) {
+    _mm256_store_si256((__m256i*)d, v);
+  }
+  return dst;
+}
+
+TARGET_AVX2 size_t strlenAvx2(char const* str) {
+  // Aligned loads never cross a page
+  auto const misalign = (uintptr_t)str & 31;
+  auto       p        = str - misalign;
+  auto const zero     = _mm256_setzero_si256();
+
+  uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const*)p), zero)) >> misalign;
+  if (mask != 0) return std::countr_zero(mask);
+
+  for (;;) {
+    p += 32;
+    mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const*)p), zero));
+    if (mask != 0) return (size_t)(p - str) + std::countr_zero(mask);
+  }
+}
+
+TARGET_AVX2 int memcmpAvx2(void const* lhs, void const* rhs, size_t n) {
+  auto a = (uint8_t const*)lhs;
+  auto b = (uint8_t const*)rhs;
+
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto const eq   = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const*)(a + i)), _mm256_loadu_si256((__m256i const*)(b + i)));
+    auto const mask = ~(uint32_t)_mm256_movemask_epi8(eq);
+    if (mask != 0) {
+      auto const k = i + std::countr_zero(mask);
+      return (int)a[k] - (int)b[k];
+    }
+  }
+  return memcmpSse2(a + i, b + i, n - i);
+}
+
+// ### AVX-512, only the large forward copy differs from AVX2
+
+TARGET_AVX512 void copyForwardAvx512(uint8_t* d, uint8_t const* s, size_t n, bool allowNt) {
+  auto const head = _mm512_loadu_si512(s);
+  auto const tail = _mm512_loadu_si512(s + n - 64);
+  auto const dst  = d;
+  auto const dEnd = d + n;
+
+  auto const skip = 64 - ((uintptr_t)d & 63);
+  d += skip;
+  s += skip;
+  n -= skip;
+
+  if (allowNt && n >= NT_THRESHOLD) {
+    for (; n >= 256; n -= 256, d += 256, s += 256) {
+      auto const a = _mm512_loadu_si512(s);
+      auto const b = _mm512_loadu_si512(s + 64);
+      auto const c = _mm512_loadu_si512(s + 128);
+      auto const e = _mm512_loadu_si512(s + 192);
+      _mm512_stream_si512((__m512i*)d, a);
+      _mm512_stream_si512((__m512i*)(d + 64), b);
+      _mm512_stream_si512((__m512i*)(d + 128), c);
+      _mm512_stream_si512((__m512i*)(d + 192), e);
+    }
+    _mm_sfence();
+  } else {
+    for (; n >= 256; n -= 256, d += 256, s += 256) {
+      auto const a = _mm512_loadu_si512(s);
+      auto const b = _mm512_loadu_si512(s + 64);
+      auto const c = _mm512_loadu_si512(s + 128);
+      auto const e = _mm512_loadu_si512(s + 192);
+      _mm512_store_si512(d, a);
+      _mm512_store_si512(d + 64, b);
+      _mm512_store_si512(d + 128, c);
+      _mm512_store_si512(d + 192, e);
+    }
+  }
+
+  for (; n >= 64; n -= 64, d += 64, s += 64) {
+    _mm512_store_si512(d, _mm512_loadu_si512(s));
+  }
+
+  _mm512_storeu_si512(dst, head);
+  _mm512_storeu_si512(dEnd - 64, tail);
+}
+
+TARGET_AVX512 void* memcpyAvx512(void* dst, void const* src, size_t n) {
+  auto d = (uint8_t*)dst;
+  auto s = (uint8_t const*)src;
+
+  if (n <= 128) {
+    copyUpTo128Avx2(d, s, n);
+  } else if (n < 512) {
+    copyForwardAvx2(d, s, n, false);
+  } else {
+    copyForwardAvx512(d, s, n, true);
+  }
+  return dst;
+}
+
+// ### Dispatch
+
+struct CpuFeatures {
+  bool avx2   = false;
+  bool avx512 = false;
+};
+
+__attribute__((target("xsave"))) CpuFeatures detectCpu() {
+  int regs[4];
+  __cpuid(regs, 0);
+  auto const maxLeaf = regs[0];
+
+  __cpuid(regs, 1);
+  bool const osxsave = (regs[2] & (1 << 27)) != 0;
+  bool const avx     = (regs[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || maxLeaf < 7) return {};
+
+  // OS has to save the ymm (and zmm) state
+  auto const xcr0 = _xgetbv(0);
+  if ((xcr0 & 0x6) != 0x6) return {};
+
+  __cpuidex(regs, 7, 0);
+  bool const avx2    = (regs[1] & (1 << 5)) != 0;
+  bool const avx512f = (regs[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+  return {.avx2 = avx2, .avx512 = avx2 && avx512f};
+}
+
+struct StringFuncs {
+  memcpy_t memcpy  = memcpySse2;
+  memcpy_t memmove = memmoveSse2;
+  memset_t memset  = memsetSse2;
+  strlen_t strlen  = strlenSse2;
+  memcmp_t memcmp  = memcmpSse2;
+  strcmp_t strcmp  = strcmpSse2;
+};
+
+StringFuncs selectFuncs() {
+  LOG_USE_MODULE(libcString);
+
+  auto const cpu = detectCpu();
+
+  StringFuncs funcs;
+  if (cpu.avx2) {
+    funcs.memcpy  = memcpyAvx2;
+    funcs.memmove = memmoveAvx2;
+    funcs.memset  = memsetAvx2;
+    funcs.strlen  = strlenAvx2;
+    funcs.memcmp  = memcmpAvx2;
+  }
+  if (cpu.avx512) {
+    funcs.memcpy = memcpyAvx512;
+  }
+
+  LOG_INFO(L"string functions| avx2:%S avx512:%S", util::getBoolStr(cpu.avx2), util::getBoolStr(cpu.avx512));
+  return funcs;
+}
+
+StringFuncs const g_funcs = selectFuncs();
+} // namespace
+
+extern "C" {
+
+EXPORT SYSV_ABI void* __NID(memset)(void* s, int c, size_t n) {
+  return g_funcs.memset(s, c, n);
+}
+
+EXPORT SYSV_ABI void* __NID(memcpy)(void* d, void* s, size_t n) {
+  return g_funcs.memcpy(d, s, n);
+}
+
+EXPORT SYSV_ABI void* __NID(memmove)(void* dst, void const* src, size_t n) {
+  return g_funcs.memmove(dst, src, n);
+}
+
+EXPORT SYSV_ABI size_t __NID(strlen)(char const* str) {
+  return g_funcs.strlen(str);
+}
+
+EXPORT SYSV_ABI int __NID(memcmp)(void const* lhs, void const* rhs, size_t n) {
+  return g_funcs.memcmp(lhs, rhs, n);
+}
+
+EXPORT SYSV_ABI int __NID(strcmp)(char const* lhs, char const* rhs) {
+  return g_funcs.strcmp(lhs, rhs);
+}
+}
@@ -0,0 +1,278 @@
+#include "tlsf.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+bool Tlsf::init(void* base, size_t size) {
+  auto const start = util::alignUp((uint64_t)base, ALIGN_SIZE);
+  auto const end   = util::alignDown((uint64_t)base + size, ALIGN_SIZE);
+  if (end <= start || end - start < 2 * HEADER_SIZE + BLOCK_SIZE_MIN) return false;
+
+  m_base = (uint8_t*)start;
+  m_size = end - start;
+
+  // One free block spanning the pool, followed by a used zero-sized sentinel
+  auto first      = (Block*)m_base;
+  first->prevPhys = nullptr;
+  first->size     = std::min(m_size - 2 * HEADER_SIZE, BLOCK_SIZE_MAX - ALIGN_SIZE);
+
+  auto sentinel      = nextPhys(first);
+  sentinel->prevPhys = first;
+  sentinel->size     = 0;
+
+  insertFree(first);
+
+  m_stats          = {};
+  m_stats.capacity = blockSize(first);
+  return true;
+}
+
+size_t Tlsf::adjustSize(size_t size) {
+  if (size >= BLOCK_SIZE_MAX) return 0;
+  return std::max((size_t)util::alignUp(size, ALIGN_SIZE), BLOCK_SIZE_MIN);
+}
+
+void Tlsf::mapping(size_t size, int* fl, int* sl) {
+  if (size < SMALL_BLOCK_SIZE) {
+    *fl = 0;
+    *sl = (int)(size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT));
+  } else {
+    int const msb = std::bit_width(size) - 1;
+
+    *sl = (int)(size >> (msb - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+    *fl = msb - (FL_INDEX_SHIFT - 1);
+  }
+}
+
+void Tlsf::mappingSearch(size_t size, int* fl, int* sl) {
+  // Round up to the next list, every block there is large enough
+  if (size >= SMALL_BLOCK_SIZE) {
+    size += (size_t(1) << (std::bit_width(size) - 1 - SL_INDEX_COUNT_LOG2)) - 1;
+  }
+  mapping(size, fl, sl);
+}
+
+void Tlsf::insertFree(Block* block) {
+  int fl, sl;
+  mapping(blockSize(block), &fl, &sl);
+
+  auto& head = m_blocks[fl][sl];
+
+  block->size |= 1;
+
+  block->nextFree = head;
+  block->prevFree = nullptr;
+  if (head != nullptr) head->prevFree = block;
+  head = block;
+
+  m_flBitmap |= 1u << fl;
+  m_slBitmap[fl] |= 1u << sl;
+}
+
+void Tlsf::removeFree(Block* block) {
+  int fl, sl;
+  mapping(blockSize(block), &fl, &sl);
+
+  if (block->nextFree != nullptr) block->nextFree->prevFree = block->prevFree;
+  if (block->prevFree != nullptr) {
+    block->prevFree->nextFree = block->nextFree;
+  } else {
+    m_blocks[fl][sl] = block->nextFree;
+    if (block->nextFree == nullptr) {
+      m_slBitmap[fl] &= ~(1u << sl);
+      if (m_slBitmap[fl] == 0) m_flBitmap &= ~(1u << fl);
+    }
+  }
+
+  block->size &= ~size_t(1);
+}
+
+Tlsf::Block* Tlsf::findFree(size_t size) {
+  int fl, sl;
+  mappingSearch(size, &fl, &sl);
+  if (fl >= FL_INDEX_COUNT) return nullptr;
+
+  uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+  if (slMap == 0) {
+    uint32_t const flMap = (fl + 1 < 32) ? m_flBitmap & (~0u << (fl + 1)) : 0;
+    if (flMap == 0) return nullptr;
+
+    fl    = std::countr_zero(flMap);
+    slMap = m_slBitmap[fl];
+  }
+  sl = std::countr_zero(slMap);
+
+  auto block = m_blocks[fl][sl];
+  removeFree(block);
+  return block;
+}
+
+Tlsf::Block* Tlsf::split(Block* block, size_t size) {
+  auto const total = blockSize(block);
+  if (total < size + HEADER_SIZE + BLOCK_SIZE_MIN) return nullptr;
+
+  auto rest      = (Block*)((uint8_t*)toPtr(block) + size);
+  rest->prevPhys = block;
+  rest->size     = total - size - HEADER_SIZE;
+  block->size    = size | (block->size & 1);
+
+  nextPhys(rest)->prevPhys = rest;
+  return rest;
+}
+
+Tlsf::Block* Tlsf::mergePrev(Block* block) {
+  auto prev = block->prevPhys;
+  if (prev == nullptr || !isFree(prev)) return block;
+
+  removeFree(prev);
+  prev->size += HEADER_SIZE + blockSize(block);
+
+  nextPhys(prev)->prevPhys = prev;
+  return prev;
+}
+
+Tlsf::Block* Tlsf::mergeNext(Block* block) {
+  auto next = nextPhys(block);
+  if (!isFree(next)) return block;
+
+  removeFree(next);
+  block->size += HEADER_SIZE + blockSize(next);
+
+  nextPhys(block)->prevPhys = block;
+  return block;
+}
+
+void* Tlsf::markUsed(Block* block, size_t size) {
+  if (auto rest = split(block, size); rest != nullptr) {
+    insertFree(mergeNext(rest));
+  }
+
+  m_stats.inUse += blockSize(block);
+  ++m_stats.numAllocated;
+  m_stats.maxInUse = std::max(m_stats.maxInUse, m_stats.inUse);
+  return toPtr(block);
+}
+
+bool Tlsf::resizeInPlace(Block* block, size_t size) {
+  auto const cur = blockSize(block);
+  if (size > cur) {
+    auto next = nextPhys(block);
+    if (!isFree(next) || cur + HEADER_SIZE + blockSize(next) < size) return false;
+    mergeNext(block);
+  }
+
+  if (auto rest = split(block, size); rest != nullptr) {
+    insertFree(mergeNext(rest));
+  }
+
+  m_stats.inUse    = m_stats.inUse - cur + blockSize(block);
+  m_stats.maxInUse = std::max(m_stats.maxInUse, m_stats.inUse);
+  return true;
+}
+
+void* Tlsf::malloc(size_t size) {
+  auto const adjusted = adjustSize(size);
+  if (adjusted == 0) return nullptr;
+
+  auto block = findFree(adjusted);
+  if (block == nullptr) return nullptr;
+
+  return markUsed(block, adjusted);
+}
+
+void* Tlsf::memalign(size_t alignment, size_t size) {
+  if (alignment <= ALIGN_SIZE) return malloc(size);
+  if (!std::has_single_bit(alignment)) return nullptr;
+
+  auto const adjusted = adjustSize(size);
+  if (adjusted == 0 || alignment >= BLOCK_SIZE_MAX) return nullptr;
+
+  // A leading gap has to be big enough to become a free block on its own
+  size_t const gapMin = HEADER_SIZE + BLOCK_SIZE_MIN;
+
+  auto const request = adjustSize(adjusted + alignment + gapMin);
+  if (request == 0) return nullptr;
+
+  auto block = findFree(request);
+  if (block == nullptr) return nullptr;
+
+  auto const ptr     = (uint64_t)toPtr(block);
+  auto       aligned = util::alignUp(ptr, alignment);
+  if (aligned != ptr && aligned - ptr < gapMin) {
+    aligned = util::alignUp(ptr + gapMin, alignment);
+  }
+
+  if (auto const gap = aligned - ptr; gap != 0) {
+    auto alignedBlock      = fromPtr((void*)aligned);
+    alignedBlock->prevPhys = block;
+    alignedBlock->size     = blockSize(block) - gap;
+    block->size            = gap - HEADER_SIZE;
+
+    nextPhys(alignedBlock)->prevPhys = alignedBlock;
+
+    insertFree(block); // prev is used, free blocks are always coalesced
+    block = alignedBlock;
+  }
+
+  return markUsed(block, adjusted);
+}
+
+void* Tlsf::realloc(void* ptr, size_t size) {
+  if (ptr == nullptr) return malloc(size);
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+
+  auto const adjusted = adjustSize(size);
+  if (adjusted == 0) return nullptr;
+
+  auto block = fromPtr(ptr);
+  if (resizeInPlace(block, adjusted)) return ptr;
+
+  auto dst = malloc(size);
+  if (dst == nullptr) return nullptr;
+
+  std::memcpy(dst, ptr, std::min(blockSize(block), adjusted));
+  free(ptr);
+  return dst;
+}
+
+void* Tlsf::reallocalign(void* ptr, size_t alignment, size_t size) {
+  if (ptr == nullptr) return memalign(alignment, size);
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+  if (alignment <= ALIGN_SIZE) return realloc(ptr, size);
+
+  auto const adjusted = adjustSize(size);
+  if (adjusted == 0) return nullptr;
+
+  auto block = fromPtr(ptr);
+  if (((uint64_t)ptr & (alignment - 1)) == 0 && resizeInPlace(block, adjusted)) return ptr;
+
+  auto dst = memalign(alignment, size);
+  if (dst == nullptr) return nullptr;
+
+  std::memcpy(dst, ptr, std::min(blockSize(block), adjusted));
+  free(ptr);
+  return dst;
+}
+
+void Tlsf::free(void* ptr) {
+  if (ptr == nullptr) return;
+
+  auto block = fromPtr(ptr);
+
+  m_stats.inUse -= blockSize(block);
+  --m_stats.numAllocated;
+
+  insertFree(mergeNext(mergePrev(block)));
+}
+
+size_t Tlsf::usableSize(void const* ptr) {
+  if (ptr == nullptr) return 0;
+  return blockSize(fromPtr(ptr));
+}
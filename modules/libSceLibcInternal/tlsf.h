@@ -0,0 +1,110 @@
+#pragma once
+#include "utility/utility.h"
+
+#include <array>
+#include <stdint.h>
+
+/**
+ * @brief Two-Level Segregated Fit allocator on a fixed memory block. O(1) alloc and free.
+ * Not thread safe, locking is done by the owner.
+ *
+ */
+class Tlsf {
+  CLASS_NO_COPY(Tlsf);
+  CLASS_NO_MOVE(Tlsf);
+
+  public:
+  static constexpr size_t ALIGN_SIZE = 16;
+
+  struct Stats {
+    size_t capacity;     /// usable bytes of the pool
+    size_t inUse;        /// payload bytes of all used blocks
+    size_t maxInUse;     /// high-water mark of inUse
+    size_t numAllocated; /// live allocations
+  };
+
+  Tlsf() = default;
+
+  /**
+   * @brief Uses [base, base + size) as the pool
+   *
+   * @return false if the block is too small
+   */
+  bool init(void* base, size_t size);
+
+  void* malloc(size_t size);
+  void* memalign(size_t alignment, size_t size);
+  void* realloc(void* ptr, size_t size);
+  void* reallocalign(void* ptr, size_t alignment, size_t size);
+  void  free(void* ptr);
+
+  /**
+   * @brief Size of the payload, at least the requested size
+   *
+   */
+  static size_t usableSize(void const* ptr);
+
+  bool contains(void const* ptr) const { return (uint8_t const*)ptr >= m_base && (uint8_t const*)ptr < m_base + m_size; }
+
+  Stats const& getStats() const { return m_stats; }
+
+  private:
+  static constexpr int SL_INDEX_COUNT_LOG2 = 5;
+  static constexpr int ALIGN_SIZE_LOG2     = 4;
+  static constexpr int FL_INDEX_MAX        = 38; // max block size 256 GB
+  static constexpr int SL_INDEX_COUNT      = 1 << SL_INDEX_COUNT_LOG2;
+  static constexpr int FL_INDEX_SHIFT      = SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2;
+  static constexpr int FL_INDEX_COUNT      = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+
+  static constexpr size_t SMALL_BLOCK_SIZE = size_t(1) << FL_INDEX_SHIFT;
+
+  struct Block {
+    Block* prevPhys; /// nullptr for the first block
+    size_t size;     /// payload size, bit 0: free
+
+    // Only valid while free, overlaps the payload
+    Block* nextFree;
+    Block* prevFree;
+  };
+
+  static constexpr size_t HEADER_SIZE    = offsetof(Block, nextFree);
+  static constexpr size_t BLOCK_SIZE_MIN = sizeof(Block) - HEADER_SIZE;
+  static constexpr size_t BLOCK_SIZE_MAX = size_t(1) << FL_INDEX_MAX;
+
+  static_assert(HEADER_SIZE % ALIGN_SIZE == 0);
+  static_assert(SMALL_BLOCK_SIZE / SL_INDEX_COUNT == ALIGN_SIZE);
+
+  uint8_t* m_base = nullptr;
+  size_t   m_size = 0;
+
+  uint32_t                                                       m_flBitmap = 0;
+  std::array<uint32_t, FL_INDEX_COUNT>                           m_slBitmap {};
+  std::array<std::array<Block*, SL_INDEX_COUNT>, FL_INDEX_COUNT> m_blocks {};
+
+  Stats m_stats {};
+
+  static size_t blockSize(Block const* block) { return block->size & ~size_t(1); }
+
+  static bool isFree(Block const* block) { return (block->size & 1) != 0; }
+
+  static void* toPtr(Block const* block) { return (uint8_t*)block + HEADER_SIZE; }
+
+  static Block* fromPtr(void const* ptr) { return (Block*)((uint8_t const*)ptr - HEADER_SIZE); }
+
+  static Block* nextPhys(Block const* block) { return (Block*)((uint8_t*)toPtr(block) + blockSize(block)); }
+
+  static size_t adjustSize(size_t size);
+  static void   mapping(size_t size, int* fl, int* sl);
+  static void   mappingSearch(size_t size, int* fl, int* sl);
+
+  void insertFree(Block* block);
+  void removeFree(Block* block);
+
+  Block* findFree(size_t size);
+  Block* split(Block* block, size_t size);
+  Block* mergePrev(Block* block);
+  Block* mergeNext(Block* block);
+
+  void* markUsed(Block* block, size_t size);
+  bool  resizeInPlace(Block* block, size_t size);
+};
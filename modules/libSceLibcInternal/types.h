@@ -1,2 +1,26 @@
 #pragma once
 #include "codes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SceLibcMallocManagedSize {
+  uint16_t size; /// sizeof(SceLibcMallocManagedSize)
+  uint16_t version;
+  uint32_t reserved1;
+  size_t   maxSystemSize;
+  size_t   currentSystemSize;
+  size_t   maxInuseSize;
+  size_t   currentInuseSize;
+};
+
+/**
+ * @brief va_list of the guest (System V x86-64), functions get a pointer to it
+ *
+ */
+struct SysvVaList {
+  uint32_t  gp_offset;         /// next general purpose register in reg_save_area, 48: all used
+  uint32_t  fp_offset;         /// next xmm register in reg_save_area, 176: all used
+  uint64_t* overflow_arg_area; /// arguments passed on the stack
+  uint8_t*  reg_save_area;
+};
@@ -1,4 +1,6 @@
 #pragma once
 #include <stdint.h>
 
-namespace Err {} // namespace Err
\ No newline at end of file
+namespace Err {
+constexpr int32_t NOT_SUPPORTED = -2136997883; /* 0x80A00005 */
+} // namespace Err
@@ -1,32 +1,79 @@
 #include "common.h"
+#include "core/fileManager/fileManager.h"
+#include "core/videoout/screenShot.h"
 #include "logging.h"
 #include "types.h"
 
+#include <algorithm>
+#include <mutex>
+#include <string>
+
 LOG_DEFINE_MODULE(libSceScreenShot);
 
-namespace {} // namespace
+namespace {
+// Without captures by the presenter the settings have no effect
+bool isSupported() {
+  if (accessScreenShot().isSupported()) return true;
+
+  LOG_USE_MODULE(libSceScreenShot);
+  static std::once_flag warned;
+  std::call_once(warned, [] { LOG_WARN(L"screenshots aren't supported by the presenter"); });
+  return false;
+}
+
+int32_t setOverlay(const char* filePath, int32_t x, int32_t y, SceScreenShotOrigin origin) {
+  LOG_USE_MODULE(libSceScreenShot);
+  if (!isSupported()) return Err::NOT_SUPPORTED;
+
+  ScreenShotOverlay overlay {.x = x, .y = y};
+  if (filePath != nullptr && filePath[0] != '\0') {
+    auto mapped = accessFileManager().getMappedPath(filePath);
+    if (!mapped) {
+      LOG_ERR(L"overlay %S not mapped", filePath);
+      return Ok;
+    }
+    overlay.path = mapped.value();
+  }
+
+  auto const index = std::clamp((int)origin, 1, 9) - 1;
+  overlay.alignX   = (uint8_t)(index / 3);
+  overlay.alignY   = (uint8_t)(index % 3);
+
+  LOG_INFO(L"overlay %S x:%d y:%d origin:%d", overlay.path.string().c_str(), x, y, (int)origin);
+  accessScreenShot().setOverlay(overlay);
+  return Ok;
+}
+} // namespace
 
 extern "C" {
 
 EXPORT const char* MODULE_NAME = "libSceScreenShot";
 
 EXPORT SYSV_ABI int32_t sceScreenShotSetParam(const SceScreenShotParam* param) {
+  if (!isSupported()) return Err::NOT_SUPPORTED;
+  if (param == nullptr) return Ok;
+
+  auto toString = [](const char* str) { return str != nullptr ? std::string(str) : std::string(); };
+  accessScreenShot().setParam(toString(param->photoTitle), toString(param->gameTitle), toString(param->gameComment));
   return Ok;
 }
 
 EXPORT SYSV_ABI int32_t sceScreenShotSetOverlayImage(const char* filePath, int32_t offsetX, int32_t offsetY) {
-  return Ok;
+  return setOverlay(filePath, offsetX, offsetY, SceScreenShotOrigin::kLeftTop);
 }
 
 EXPORT SYSV_ABI int32_t sceScreenShotSetOverlayImageWithOrigin(const char* filePath, int32_t marginX, int32_t marginY, SceScreenShotOrigin origin) {
-  return Ok;
+  return setOverlay(filePath, marginX, marginY, origin);
 }
 
 EXPORT SYSV_ABI int32_t sceScreenShotDisable(void) {
+  accessScreenShot().setEnabled(false);
   return Ok;
 }
 
 EXPORT SYSV_ABI int32_t sceScreenShotEnable(void) {
+  if (!isSupported()) return Err::NOT_SUPPORTED;
+  accessScreenShot().setEnabled(true);
   return Ok;
 }
 }
\ No newline at end of file
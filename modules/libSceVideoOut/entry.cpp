@@ -84,8 +84,10 @@ EXPORT SYSV_ABI int32_t sceVideoOutSubmitFlip(int32_t handle, int32_t bufferInde
   if (bufferIndex < 0 || bufferIndex > 15) {
     return Err::VIDEO_OUT_ERROR_INVALID_INDEX;
   }
-  accessVideoOut().submitFlip(handle, bufferIndex, flipArg);
-  return Ok;
+  if (flipMode < (uint32_t)SceVideoOutFlipMode::VSYNC || flipMode > (uint32_t)SceVideoOutFlipMode::WINDOW_2) {
+    return Err::VIDEO_OUT_ERROR_INVALID_FLIP_MODE;
+  }
+  return accessVideoOut().submitFlip(handle, bufferIndex, flipMode, flipArg);
 }
 
 EXPORT SYSV_ABI int32_t sceVideoOutGetFlipStatus(int32_t handle, SceVideoOutFlipStatus* status) {
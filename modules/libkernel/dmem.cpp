@@ -3,29 +3,49 @@
 #include "assert.h"
 #include "common.h"
 #include "core/dmem/dmem.h"
+#include "core/hleStats/hleStats.h"
+#include "core/imports/exports/procParam.h"
 #include "core/imports/imports_gpuMemory.h"
+#include "core/imports/imports_runtime.h"
 #include "core/memory/memory.h"
 #include "logging.h"
 #include "modules_include/common.h"
 #include "types.h"
 
+#include <mutex>
+
 LOG_DEFINE_MODULE(dmem)
 
-namespace {} // namespace
+namespace {
+/**
+ * @brief The title may configure its flexible memory size in procParam -> SceKernelMemParam, keeps the default otherwise
+ *
+ */
+IFlexibleMemory& initFlexibleMemory() {
+  static std::once_flag initFlag;
+  std::call_once(initFlag, [] {
+    LOG_USE_MODULE(dmem);
 
-extern "C" {
+    auto const procParam = (ProcParam const*)accessRuntimeExport()->mainModuleInfo().procParamAddr;
+    if (procParam == nullptr || procParam->header.size < offsetof(ProcParam, _sceKernelMemParam) + sizeof(procParam->_sceKernelMemParam)) return;
 
-EXPORT SYSV_ABI size_t sceKernelGetDirectMemorySize() {
-  LOG_USE_MODULE(dmem);
+    auto const memParam = procParam->_sceKernelMemParam;
+    if (memParam == nullptr || memParam->sceKernelFlexibleMemorySize == nullptr) return;
 
-  auto size = accessPysicalMemory().size();
-  LOG_DEBUG(L"%S size:0x%08llx", __FUNCTION__, size);
-  return size;
+    auto const size = *memParam->sceKernelFlexibleMemorySize;
+    if (size == 0) return;
+
+    LOG_INFO(L"flexible memory size:0x%08llx (procParam)", size);
+    accessFlexibleMemory().setConfiguredSize(size);
+  });
+  return accessFlexibleMemory();
 }
 
-EXPORT SYSV_ABI int32_t sceKernelMapNamedFlexibleMemory(void** addrInOut, size_t len, int prot, int flags, const char* name) {
+int32_t mapFlexibleMemory(void** addrInOut, size_t len, int prot, uint64_t caller) {
+  if (len == 0) return getErr(ErrCode::_EINVAL);
+
   auto const inAddr  = reinterpret_cast<uint64_t>(*addrInOut);
-  auto const outAddr = accessFlexibleMemory().alloc(inAddr, len, prot);
+  auto const outAddr = initFlexibleMemory().alloc(inAddr, len, prot, caller);
   *addrInOut         = reinterpret_cast<void*>(outAddr);
 
   if (outAddr == 0) {
@@ -34,13 +54,28 @@ EXPORT SYSV_ABI int32_t sceKernelMapNamedFlexibleMemory(void** addrInOut, size_t
 
   return Ok;
 }
+} // namespace
+
+extern "C" {
+
+EXPORT SYSV_ABI size_t sceKernelGetDirectMemorySize() {
+  LOG_USE_MODULE(dmem);
+
+  auto size = accessPysicalMemory().size();
+  LOG_DEBUG(L"%S size:0x%08llx", __FUNCTION__, size);
+  return size;
+}
+
+EXPORT SYSV_ABI int32_t sceKernelMapNamedFlexibleMemory(void** addrInOut, size_t len, int prot, int flags, const char* name) {
+  return mapFlexibleMemory(addrInOut, len, prot, hleStats::getCallerAddress((uint64_t)__builtin_return_address(0)));
+}
 
 EXPORT SYSV_ABI int32_t sceKernelMapFlexibleMemory(void** addrInOut, size_t len, int prot, int flags) {
-  return sceKernelMapNamedFlexibleMemory(addrInOut, len, prot, flags, "");
+  return mapFlexibleMemory(addrInOut, len, prot, hleStats::getCallerAddress((uint64_t)__builtin_return_address(0)));
 }
 
 EXPORT SYSV_ABI int32_t sceKernelReleaseFlexibleMemory(void* addr, size_t len) {
-  accessFlexibleMemory().release((uint64_t)addr, len);
+  initFlexibleMemory().release((uint64_t)addr, len);
   return Ok;
 }
 
@@ -343,12 +378,12 @@ EXPORT SYSV_ABI int32_t sceKernelMemoryPoolReserve(uint64_t addrIn, uint64_t len
 }
 
 EXPORT SYSV_ABI int32_t sceKernelAvailableFlexibleMemorySize(size_t* sizeOut) {
-  *sizeOut = accessFlexibleMemory().available();
+  *sizeOut = initFlexibleMemory().available();
   return Ok;
 }
 
 EXPORT SYSV_ABI int32_t sceKernelConfiguredFlexibleMemorySize(size_t* sizeOut) {
-  *sizeOut = accessFlexibleMemory().size();
+  *sizeOut = initFlexibleMemory().size();
   return Ok;
 }
 
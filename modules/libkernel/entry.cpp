@@ -1,9 +1,12 @@
 #include "common.h"
 #include "core/fileManager/fileManager.h"
+#include "core/hleStats/hleStats.h"
 #include "core/imports/exports/procParam.h"
 #include "core/imports/exports/runtimeExport.h"
 #include "core/imports/imports_runtime.h"
 #include "core/kernel/errors.h"
+#include "core/kernel/resourceUsage.h"
+#include "core/memory/heap.h"
 #include "core/memory/memory.h"
 #include "core/timer/timer.h"
 #include "logging.h"
@@ -275,9 +278,15 @@ EXPORT SYSV_ABI void _sceKernelSetThreadAtexitCount(get_thread_atexit_count_func
 }
 
 EXPORT SYSV_ABI void _sceKernelRtldSetApplicationHeapAPI(void* api[]) {
-  auto& heap_malloc         = api[0];
-  auto& heap_free           = api[1];
-  auto& heap_posix_memalign = api[6];
+  heap::setApplicationHeapAPI({
+      .malloc         = api[0],
+      .free           = api[1],
+      .calloc         = api[2],
+      .realloc        = api[3],
+      .memalign       = api[4],
+      .reallocalign   = api[5],
+      .posix_memalign = api[6],
+  });
 }
 
 EXPORT SYSV_ABI void sceKernelDebugRaiseException(int reason, int id) {
@@ -366,7 +375,7 @@ EXPORT SYSV_ABI int sceKernelGetModuleList(int* modules, size_t size, size_t* si
 }
 
 EXPORT SYSV_ABI int sceKernelDlsym(int moduleId, const char* symbol, uint64_t* pAddr) {
-  *pAddr = (uint64_t)accessRuntimeExport()->getSymbol(moduleId, symbol, false);
+  *pAddr = (uint64_t)hleStats::instrument(symbol, accessRuntimeExport()->getSymbol(moduleId, symbol, false));
   LOG_USE_MODULE(libkernel);
   LOG_DEBUG(L"dlsym[%d] 0x%08llx %S", moduleId, *pAddr, symbol);
   if (*pAddr == 0) return getErr(ErrCode::_EFAULT);
@@ -374,7 +383,27 @@ EXPORT SYSV_ABI int sceKernelDlsym(int moduleId, const char* symbol, uint64_t* p
 }
 
 EXPORT SYSV_ABI int __NID(getrusage)(rusageWho who, rusage_t* usage) {
+  if (usage == nullptr) return getErr(ErrCode::_EFAULT);
+
+  Kernel::ResourceUsage::Usage host {};
+  switch (who) {
+    case rusageWho::Self: host = Kernel::ResourceUsage::getProcess(); break;
+    case rusageWho::Thread: host = Kernel::ResourceUsage::getThread(); break;
+    case rusageWho::Children: break; // no child processes
+    default: return getErr(ErrCode::_EINVAL);
+  }
+
   *usage = rusage_t();
+
+  usage->ru_utime   = {.tv_sec = host.userTimeUs / 1000000, .tv_usec = host.userTimeUs % 1000000};
+  usage->ru_stime   = {.tv_sec = host.systemTimeUs / 1000000, .tv_usec = host.systemTimeUs % 1000000};
+  usage->ru_maxrss  = (int64_t)host.maxRssKb;
+  usage->ru_minflt  = (int64_t)host.minorFaults;
+  usage->ru_majflt  = (int64_t)host.majorFaults;
+  usage->ru_inblock = (int64_t)host.inBlock;
+  usage->ru_oublock = (int64_t)host.outBlock;
+  usage->ru_nvcsw   = (int64_t)host.voluntarySwitches;
+  usage->ru_nivcsw  = (int64_t)host.involuntarySwitches;
   return Ok;
 }
 }
\ No newline at end of file
@@ -76,18 +76,18 @@ enum class rusageWho : int {
 struct rusage_t {
   SceKernelTimeval ru_utime    = {0, 0};
   SceKernelTimeval ru_stime    = {0, 0};
-  uint32_t         ru_maxrss   = 0;
-  uint32_t         ru_ixrss    = 0;
-  uint32_t         ru_idrss    = 0;
-  uint32_t         ru_isrss    = 0;
-  uint32_t         ru_minflt   = 0;
-  uint32_t         ru_majflt   = 0;
-  uint32_t         ru_nswap    = 0;
-  uint32_t         ru_inblock  = 0;
-  uint32_t         ru_oublock  = 0;
-  uint32_t         ru_msgsnd   = 0;
-  uint32_t         ru_msgrcv   = 0;
-  uint32_t         ru_nsignals = 0;
-  uint32_t         ru_nvcsw    = 0;
-  uint32_t         ru_nivcsw   = 0;
+  int64_t          ru_maxrss   = 0;
+  int64_t          ru_ixrss    = 0;
+  int64_t          ru_idrss    = 0;
+  int64_t          ru_isrss    = 0;
+  int64_t          ru_minflt   = 0;
+  int64_t          ru_majflt   = 0;
+  int64_t          ru_nswap    = 0;
+  int64_t          ru_inblock  = 0;
+  int64_t          ru_oublock  = 0;
+  int64_t          ru_msgsnd   = 0;
+  int64_t          ru_msgrcv   = 0;
+  int64_t          ru_nsignals = 0;
+  int64_t          ru_nvcsw    = 0;
+  int64_t          ru_nivcsw   = 0;
 };
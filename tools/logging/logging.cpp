@@ -4,10 +4,20 @@
 
 #include <P7_Telemetry.h>
 #include <P7_Trace.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
+#include <windows.h>
 
 namespace __Log {
 
@@ -26,50 +36,513 @@ std::unordered_map<std::wstring, int>& getThreads() {
   return mThreads;
 }
 
-std::mutex& getMutex() {
-  static std::mutex mMutex;
-  return mMutex;
+namespace {
+constexpr size_t RING_SIZE      = 128 * 1024; // per thread
+constexpr size_t MAX_SLOTS      = 64;
+constexpr size_t MAX_STRING_LEN = 1024; // longer string arguments are cut
+
+// Arguments are stored as the 8 byte slots of the Windows x64 va_list
+static_assert(std::is_same_v<va_list, char*>);
+
+/**
+ * @brief Which argument slots of a format are doubles or strings
+ *
+ */
+struct FormatDesc {
+  uint32_t numSlots   = 0;
+  bool     tooMany    = false;
+  uint64_t doubleMask = 0;
+  uint64_t wideMask   = 0; // wchar_t*
+  uint64_t narrowMask = 0; // char*
+  uint64_t starMask   = 0; // strings whose precision is the previous slot (%.*s)
+
+  std::array<uint32_t, MAX_SLOTS> maxLen; // strings: characters read at most
+};
+
+FormatDesc parseFormat(wchar_t const* format) {
+  FormatDesc desc;
+
+  auto addSlot = [&desc](uint64_t* mask) {
+    if (desc.numSlots == MAX_SLOTS) {
+      desc.tooMany = true;
+      return;
+    }
+    if (mask != nullptr) *mask |= 1ull << desc.numSlots;
+    ++desc.numSlots;
+  };
+
+  for (auto p = format; *p != L'\0'; ++p) {
+    if (*p != L'%') continue;
+    ++p;
+    if (*p == L'%') continue;
+
+    while (*p == L'-' || *p == L'+' || *p == L' ' || *p == L'#' || *p == L'0')
+      ++p;
+
+    if (*p == L'*') {
+      addSlot(nullptr);
+      ++p;
+    }
+    while (*p >= L'0' && *p <= L'9')
+      ++p;
+
+    bool   starPrecision = false;
+    size_t precision     = MAX_STRING_LEN;
+    if (*p == L'.') {
+      ++p;
+      if (*p == L'*') {
+        addSlot(nullptr);
+        starPrecision = true;
+        ++p;
+      } else {
+        precision = 0;
+      }
+      while (*p >= L'0' && *p <= L'9') {
+        precision = std::min(precision * 10 + (*p - L'0'), MAX_STRING_LEN);
+        ++p;
+      }
+    }
+
+    wchar_t length = 0;
+    while (*p == L'h' || *p == L'l' || *p == L'L' || *p == L'w' || *p == L'j' || *p == L'z' || *p == L't' || *p == L'q' || *p == L'I' ||
+           (length == L'I' && (*p == L'3' || *p == L'2' || *p == L'6' || *p == L'4'))) {
+      if (length != L'I' || (*p != L'3' && *p != L'2' && *p != L'6' && *p != L'4')) length = *p;
+      ++p;
+    }
+
+    auto addString = [&](uint64_t* mask) {
+      auto const slot = desc.numSlots;
+      addSlot(mask);
+      if (desc.tooMany) return;
+
+      desc.maxLen[slot] = (uint32_t)precision;
+      if (starPrecision) desc.starMask |= 1ull << slot;
+    };
+
+    switch (*p) {
+      case L'\0': return desc;
+      // Windows semantics: %s is wide, %S narrow
+      case L's': addString(length == L'h' ? &desc.narrowMask : &desc.wideMask); break;
+      case L'S': addString(length == L'l' || length == L'w' ? &desc.wideMask : &desc.narrowMask); break;
+      case L'e':
+      case L'E':
+      case L'f':
+      case L'F':
+      case L'g':
+      case L'G':
+      case L'a':
+      case L'A': addSlot(&desc.doubleMask); break;
+      default: addSlot(nullptr); break;
+    }
+  }
+  return desc;
+}
+
+FormatDesc const& getFormatDesc(wchar_t const* format) {
+  thread_local std::unordered_map<wchar_t const*, FormatDesc> cache;
+
+  auto it = cache.find(format);
+  if (it == cache.end()) it = cache.emplace(format, parseFormat(format)).first;
+  return it->second;
+}
+
+/**
+ * @brief A log call, followed by the argument slots and the copied strings
+ *
+ */
+struct RecordHeader {
+  uint32_t       size; /// incl. header and padding, 0: padding till the end of the ring
+  eTrace_Level   level;
+  uint16_t       line;
+  uint32_t       numSlots;
+  uint64_t       stringMask; /// slots holding an offset to a string inside the record
+  void*          module;
+  char const*    file;
+  char const*    function;
+  wchar_t const* format;
+};
+
+constexpr uint32_t alignRecord(size_t size) {
+  return (uint32_t)((size + 7) & ~size_t(7));
+}
+
+/**
+ * @brief Single producer (the owning thread), single consumer (the drain)
+ *
+ */
+class ThreadRing {
+  std::unique_ptr<uint8_t[]> m_data = std::make_unique<uint8_t[]>(RING_SIZE);
+
+  alignas(64) std::atomic<uint64_t> m_head = 0;
+  uint64_t m_cachedTail                    = 0; // producer's view of m_tail
+
+  alignas(64) std::atomic<uint64_t> m_tail = 0;
+
+  public:
+  uint32_t const        threadId;
+  std::atomic<uint64_t> dropped  = 0;
+  uint64_t              reported = 0; // drops already logged, consumer only
+  std::atomic_bool      exited   = false;
+
+  explicit ThreadRing(uint32_t id): threadId(id) {}
+
+  /**
+   * @brief Space for one record, nullptr if full. Finished with commit()
+   *
+   */
+  uint8_t* reserve(uint32_t size) {
+    auto const head   = m_head.load(std::memory_order_relaxed);
+    auto const offset = head % RING_SIZE;
+
+    // Records don't wrap, the rest of the ring is skipped
+    auto const skip = RING_SIZE - offset < size ? RING_SIZE - offset : 0;
+    if (head + skip + size - m_cachedTail > RING_SIZE) {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head + skip + size - m_cachedTail > RING_SIZE) return nullptr;
+    }
+
+    if (skip > 0) {
+      if (skip >= sizeof(uint32_t)) *(uint32_t*)(m_data.get() + offset) = 0;
+      m_head.store(head + skip, std::memory_order_release);
+      return m_data.get();
+    }
+    return m_data.get() + offset;
+  }
+
+  void commit(uint32_t size) { m_head.store(m_head.load(std::memory_order_relaxed) + size, std::memory_order_release); }
+
+  /**
+   * @brief Hands all committed records to func
+   *
+   * @return number of records
+   */
+  template <typename Func>
+  size_t consume(Func&& func) {
+    auto const head = m_head.load(std::memory_order_acquire);
+    auto       tail = m_tail.load(std::memory_order_relaxed);
+
+    size_t count = 0;
+    while (tail < head) {
+      auto const offset = tail % RING_SIZE;
+      auto const rest   = RING_SIZE - offset;
+
+      auto record = (RecordHeader const*)(m_data.get() + offset);
+      if (rest < sizeof(RecordHeader) || record->size == 0) {
+        tail += rest;
+        continue;
+      }
+
+      func(*record);
+      tail += record->size;
+      ++count;
+      m_tail.store(tail, std::memory_order_release);
+    }
+    m_tail.store(tail, std::memory_order_release);
+    return count;
+  }
+};
+
+/**
+ * @brief Registered modules by name. The level of a module is cached next to its P7 handle
+ *
+ */
+class ModuleRegistry {
+  std::mutex                                                m_mutex;
+  std::unordered_map<std::wstring, std::unique_ptr<Module>> m_modules;
+
+  public:
+  Module* add(wchar_t const* name);
+  void    setLevel(wchar_t const* name, eTrace_Level level);
+
+  /**
+   * @brief Takes over levels changed through P7 (Baical)
+   *
+   */
+  void syncLevels();
+};
+
+ModuleRegistry& accessModules() {
+  static auto inst = new ModuleRegistry; // never destroyed, the drain thread is detached
+  return *inst;
 }
 
-void* __registerLoggingModule(std::wstring&& name) {
-  auto trace = getTrace();
+Module* ModuleRegistry::add(wchar_t const* name) {
+  std::unique_lock const lock(m_mutex);
+
+  auto& module = m_modules[name];
+  if (module) return module.get(); // same name in several files
+
+  IP7_Trace::hModule handle;
+  (*getTrace())->Register_Module(name, &handle);
+
+  module         = std::make_unique<Module>();
+  module->handle = handle;
+  module->level  = static_cast<uint8_t>((*getTrace())->Get_Verbosity(handle));
+  return module.get();
+}
+
+void ModuleRegistry::setLevel(wchar_t const* name, eTrace_Level level) {
+  std::unique_lock const lock(m_mutex);
+
+  for (auto& [moduleName, module]: m_modules) {
+    if (name != nullptr && moduleName != name) continue;
+
+    (*getTrace())->Set_Verbosity(module->handle, static_cast<eP7Trace_Level>(level));
+    module->level = static_cast<uint8_t>(level);
+  }
+}
+
+void ModuleRegistry::syncLevels() {
+  std::unique_lock const lock(m_mutex);
+
+  for (auto& [moduleName, module]: m_modules) {
+    module->level.store(static_cast<uint8_t>((*getTrace())->Get_Verbosity(module->handle)), std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Log calls only copy their arguments into a per thread ring, a background thread hands them to P7
+ *
+ */
+class AsyncLog {
+  std::mutex               m_mutexRings;
+  std::vector<ThreadRing*> m_rings;
+
+  std::mutex m_mutexDrain; // one consumer at a time
+
+  std::once_flag m_startFlag;
+
+  // Formats with a thread id prefix, keyed by the original format (drain only)
+  std::unordered_map<wchar_t const*, std::wstring> m_formats;
+
+  ThreadRing* getRing();
+
+  void emit(ThreadRing const& ring, RecordHeader const& record);
+  void drainAll();
+  void run();
+
+  public:
+  void push(eTrace_Level level, void* module, unsigned short line, const char* file, const char* function, const wchar_t* format, va_list args);
+
+  /**
+   * @brief Writes all pending records from the calling thread
+   *
+   */
+  void flush() { drainAll(); }
+
+  void releaseRing(ThreadRing* ring) { ring->exited = true; }
+};
+
+AsyncLog& accessAsyncLog() {
+  static auto inst = new AsyncLog; // never destroyed, the drain thread is detached
+  return *inst;
+}
+
+// Marks the ring for removal when the thread exits, the drain deletes it
+struct ThreadRingOwner {
+  ThreadRing* ring = nullptr;
+
+  ~ThreadRingOwner() {
+    if (ring != nullptr) accessAsyncLog().releaseRing(ring);
+    ring = nullptr;
+  }
+};
+
+ThreadRing* AsyncLog::getRing() {
+  thread_local ThreadRingOwner owner;
+  if (owner.ring == nullptr) {
+    owner.ring = new ThreadRing(GetCurrentThreadId());
+
+    std::unique_lock const lock(m_mutexRings);
+    m_rings.push_back(owner.ring);
+  }
+  return owner.ring;
+}
+
+void AsyncLog::push(eTrace_Level level, void* module, unsigned short line, const char* file, const char* function, const wchar_t* format, va_list args) {
+  std::call_once(m_startFlag, [this] { std::thread([this] { run(); }).detach(); });
+
+  auto const& desc = getFormatDesc(format);
+  auto        ring = getRing();
+
+  if (desc.tooMany) {
+    ++ring->dropped;
+    return;
+  }
+
+  std::array<uint64_t, MAX_SLOTS> slots;
+  std::array<uint32_t, MAX_SLOTS> stringSizes;
+
+  size_t size = sizeof(RecordHeader) + desc.numSlots * sizeof(uint64_t);
+  for (uint32_t n = 0; n < desc.numSlots; ++n) {
+    auto const bit = 1ull << n;
+    if ((desc.doubleMask & bit) != 0) {
+      auto const value = va_arg(args, double);
+      std::memcpy(&slots[n], &value, sizeof(double));
+      continue;
+    }
+
+    slots[n] = va_arg(args, uint64_t);
+    if (slots[n] == 0 || ((desc.wideMask | desc.narrowMask) & bit) == 0) continue;
+
+    // Strings with a precision needn't be terminated, read no further
+    size_t maxLen = desc.maxLen[n];
+    if ((desc.starMask & bit) != 0) {
+      auto const precision = (int32_t)slots[n - 1];
+      if (precision >= 0) maxLen = std::min((size_t)precision, MAX_STRING_LEN);
+    }
+
+    if ((desc.wideMask & bit) != 0) {
+      stringSizes[n] = (uint32_t)((wcsnlen((wchar_t const*)slots[n], maxLen) + 1) * sizeof(wchar_t));
+    } else {
+      stringSizes[n] = (uint32_t)(strnlen((char const*)slots[n], maxLen) + 1);
+    }
+    size += alignRecord(stringSizes[n]);
+  }
+
+  auto const recordSize = alignRecord(size);
+
+  auto data = ring->reserve(recordSize);
+  if (data == nullptr) {
+    ++ring->dropped;
+    return;
+  }
+
+  auto record = new (data) RecordHeader {
+      .size       = recordSize,
+      .level      = level,
+      .line       = line,
+      .numSlots   = desc.numSlots,
+      .stringMask = 0,
+      .module     = module,
+      .file       = file,
+      .function   = function,
+      .format     = format,
+  };
+
+  auto   dstSlots = (uint64_t*)(data + sizeof(RecordHeader));
+  size_t offset   = sizeof(RecordHeader) + desc.numSlots * sizeof(uint64_t);
+  for (uint32_t n = 0; n < desc.numSlots; ++n) {
+    auto const bit = 1ull << n;
+    if (slots[n] == 0 || ((desc.wideMask | desc.narrowMask) & bit) == 0) {
+      dstSlots[n] = slots[n];
+      continue;
+    }
+
+    // Copy without the terminator, it may be cut
+    auto const stringSize = stringSizes[n];
+    auto const charSize   = (desc.wideMask & bit) != 0 ? sizeof(wchar_t) : 1;
+    std::memcpy(data + offset, (void const*)slots[n], stringSize - charSize);
+    std::memset(data + offset + stringSize - charSize, 0, charSize);
+
+    record->stringMask |= bit;
+    dstSlots[n] = offset;
+    offset += alignRecord(stringSize); // keeps wide strings aligned
+  }
+
+  ring->commit(recordSize);
+}
+
+void AsyncLog::emit(ThreadRing const& ring, RecordHeader const& record) {
+  auto& prefixed = m_formats[record.format];
+  if (prefixed.empty()) prefixed = std::wstring(L"[%u] ") + record.format;
+
+  // Thread id + argument slots, string offsets become pointers into the record
+  std::array<uint64_t, 1 + MAX_SLOTS> slots;
+  slots[0] = ring.threadId;
+
+  auto const srcSlots = (uint64_t const*)((uint8_t const*)&record + sizeof(RecordHeader));
+  for (uint32_t n = 0; n < record.numSlots; ++n) {
+    slots[1 + n] = (record.stringMask & (1ull << n)) != 0 ? (uint64_t)&record + srcSlots[n] : srcSlots[n];
+  }
+
+  auto    format = prefixed.c_str();
+  va_list args   = (va_list)slots.data();
+  (*getTrace())
+      ->Trace_Embedded(0, static_cast<eP7Trace_Level>(static_cast<typename std::underlying_type<__Log::eTrace_Level>::type>(record.level)), record.module,
+                       record.line, record.file, record.function, &format, &args);
+}
+
+void AsyncLog::drainAll() {
+  std::unique_lock const lockDrain(m_mutexDrain);
+
+  std::vector<ThreadRing*> rings;
   {
-    const std::unique_lock lock(getMutex());
-    if (*getClient() == nullptr) {
-      *getClient() = P7_Create_Client(TM("/P7.Pool=1024"));
-      *trace       = P7_Create_Trace(*getClient(), __APPNAME);
+    std::unique_lock const lock(m_mutexRings);
+    rings = m_rings;
+  }
+
+  for (auto ring: rings) {
+    bool const exited = ring->exited; // read before consuming: nothing follows afterwards
+
+    ring->consume([this, ring](RecordHeader const& record) { emit(*ring, record); });
+
+    if (auto const dropped = ring->dropped.load(std::memory_order_relaxed); dropped != ring->reported) {
+      (*getTrace())->Trace(0, EP7TRACE_LEVEL_WARNING, nullptr, (tUINT16)__LINE__, __FILE__, __FUNCTION__, L"[%u] log ring full, %llu messages dropped",
+                           ring->threadId, dropped - ring->reported);
+      ring->reported = dropped;
+    }
+
+    if (exited) {
+      {
+        std::unique_lock const lock(m_mutexRings);
+        std::erase(m_rings, ring);
+      }
+      delete ring;
     }
   }
-  IP7_Trace::hModule pModule;
-  (*trace)->Register_Module(name.data(), &pModule);
-  return pModule;
+}
+
+void AsyncLog::run() {
+  SetThreadDescription(GetCurrentThread(), L"LogDrain");
+
+  for (uint32_t n = 1;; ++n) {
+    drainAll();
+    if ((n % 256) == 0) accessModules().syncLevels(); // ~0.5s
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+}
+} // namespace
+
+Module* __registerLoggingModule(wchar_t const* name) {
+  [[maybe_unused]] static bool const created = [] {
+    *getClient() = P7_Create_Client(TM("/P7.Pool=1024"));
+    *getTrace()  = P7_Create_Trace(*getClient(), __APPNAME);
+    return true;
+  }();
+  return accessModules().add(name);
 }
 
 void deinit() {
+  accessAsyncLog().flush();
   P7_Client_Flush(*getClient());
 }
 
-uint8_t isIgnored(void* module, eTrace_Level level) {
-  return static_cast<uint8_t>((*getTrace())->Get_Verbosity(module)) <= static_cast<typename std::underlying_type<__Log::eTrace_Level>::type>(level);
+void setLevel(wchar_t const* name, eTrace_Level level) {
+  accessModules().setLevel(name, level);
 }
 
-void __log(eTrace_Level level, void* hmodule, unsigned short i_wLine, const char* i_pFile, const char* i_pFunction, const wchar_t* i_pFormat, ...) {
+uint8_t isIgnored(Module* module, eTrace_Level level) {
+  return !isEnabled(module, level);
+}
+
+void __log(eTrace_Level level, Module* module, unsigned short i_wLine, const char* i_pFile, const char* i_pFunction, const wchar_t* i_pFormat, ...) {
   // EXIT_IF(mTrace == nullptr);
   va_list args = nullptr;
   va_start(args, i_pFormat);
 
   if (static_cast<typename std::underlying_type<__Log::eTrace_Level>::type>(level) >=
       static_cast<typename std::underlying_type<__Log::eTrace_Level>::type>(eTrace_Level::err)) {
-    vwprintf(i_pFormat, args);
+    va_list argsConsole = args;
+    vwprintf(i_pFormat, argsConsole);
     printf("\n");
   }
 
-  (*getTrace())
-      ->Trace_Embedded(0, static_cast<eP7Trace_Level>(static_cast<typename std::underlying_type<__Log::eTrace_Level>::type>(level)), hmodule, i_wLine, i_pFile,
-                       i_pFunction, &i_pFormat, &args);
+  accessAsyncLog().push(level, module != nullptr ? module->handle : nullptr, i_wLine, i_pFile, i_pFunction, i_pFormat, args);
   va_end(args);
 
   if (level == eTrace_Level::crit) {
+    accessAsyncLog().flush();
     P7_Exceptional_Flush();
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     // while (!::IsDebuggerPresent())
@@ -77,4 +550,4 @@ void __log(eTrace_Level level, void* hmodule, unsigned short i_wLine, const char
     exit(1);
   }
 }
-} // namespace __Log
\ No newline at end of file
+} // namespace __Log
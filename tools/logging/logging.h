@@ -10,13 +10,17 @@
 #define __APICALL __declspec(dllimport)
 #endif
 
+#include <atomic>
+#include <stdint.h>
 #include <string>
 
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0 // eTrace_Level, lower levels are compiled out (crit is always kept)
+#endif
+
 namespace __Log {
 constexpr wchar_t const* __APPNAME = L"psOff";
 
-__APICALL void* __registerLoggingModule(std::wstring&& name); // For internal usage
-
 enum class eTrace_Level : uint8_t {
   trace = 0,
   debug,
@@ -26,7 +30,41 @@ enum class eTrace_Level : uint8_t {
   crit,
 };
 
-__APICALL void __log(eTrace_Level level, void* hmodule, unsigned short i_wLine, const char* i_pFile, const char* i_pFunction, const wchar_t* i_pFormat, ...);
+/**
+ * @brief Registered logging module. level is checked before the arguments are evaluated
+ *
+ */
+struct Module {
+  std::atomic<uint8_t> level;  // lowest enabled eTrace_Level
+  void*                handle; // P7 module
+};
+
+__APICALL Module* __registerLoggingModule(wchar_t const* name); // For internal usage
+
+/**
+ * @brief Defined per module and file. Registers the module on first use, afterwards it's a single atomic load
+ *
+ */
+class ModuleRef {
+  wchar_t const*       m_name;
+  std::atomic<Module*> m_module = nullptr;
+
+  Module* resolve() {
+    auto const module = __registerLoggingModule(m_name); // same name -> same module, racing threads agree
+    m_module.store(module, std::memory_order_release);
+    return module;
+  }
+
+  public:
+  constexpr ModuleRef(wchar_t const* name): m_name(name) {}
+
+  Module* get() {
+    if (auto const module = m_module.load(std::memory_order_acquire); module != nullptr) return module;
+    return resolve();
+  }
+};
+
+__APICALL void __log(eTrace_Level level, Module* module, unsigned short i_wLine, const char* i_pFile, const char* i_pFunction, const wchar_t* i_pFormat, ...);
 
 /**
  * @brief Call at end to flush messages
@@ -34,7 +72,19 @@ __APICALL void __log(eTrace_Level level, void* hmodule, unsigned short i_wLine,
  */
 __APICALL void deinit();
 
-__APICALL uint8_t isIgnored(void* module, eTrace_Level level);
+/**
+ * @brief Changes the level of a module at runtime
+ *
+ * @param name module name as passed to LOG_DEFINE_MODULE, nullptr: all modules
+ * @param level messages below are dropped
+ */
+__APICALL void setLevel(wchar_t const* name, eTrace_Level level);
+
+__APICALL uint8_t isIgnored(Module* module, eTrace_Level level);
+
+inline bool isEnabled(Module const* module, eTrace_Level level) {
+  return static_cast<uint8_t>(level) >= module->level.load(std::memory_order_relaxed);
+}
 } // namespace __Log
 
 /**
@@ -43,23 +93,32 @@ __APICALL uint8_t isIgnored(void* module, eTrace_Level level);
  */
 #define LOG_DEFINE_MODULE(name)                                                                                                                                \
   namespace {                                                                                                                                                  \
-  void* __TRACE_MODULE__DEFINED__##name = __Log::__registerLoggingModule(L#name);                                                                              \
+  constinit __Log::ModuleRef __TRACE_MODULE__DEFINED__##name(L#name);                                                                                          \
   }
 
 /**
  * @brief Call before logging
  *
  */
-#define LOG_USE_MODULE(name) [[maybe_unused]] void* __TRACE_MODULE = __TRACE_MODULE__DEFINED__##name
-#define LOG_GET_MODULE(name) __TRACE_MODULE__DEFINED__##name
-
-// Logging
-#define LOG_TRACE(...)       __Log::__log(__Log::eTrace_Level::trace, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
-#define LOG_DEBUG(...)       __Log::__log(__Log::eTrace_Level::debug, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
-#define LOG_INFO(...)        __Log::__log(__Log::eTrace_Level::info, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
-#define LOG_WARN(...)        __Log::__log(__Log::eTrace_Level::warn, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
-#define LOG_ERR(...)         __Log::__log(__Log::eTrace_Level::err, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
-#define LOG_CRIT(...)        __Log::__log(__Log::eTrace_Level::crit, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
+#define LOG_USE_MODULE(name) [[maybe_unused]] __Log::Module* __TRACE_MODULE = __TRACE_MODULE__DEFINED__##name.get()
+#define LOG_GET_MODULE(name) __TRACE_MODULE__DEFINED__##name.get()
+
+// Arguments are only evaluated if the level is enabled
+#define __LOG_GATED(level, ...)                                                                                                                                \
+  do {                                                                                                                                                         \
+    if constexpr (static_cast<uint8_t>(level) >= LOG_MIN_LEVEL) {                                                                                              \
+      if (__Log::isEnabled(__TRACE_MODULE, level))                                                                                                             \
+        __Log::__log(level, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__);                                                    \
+    }                                                                                                                                                          \
+  } while (0)
+
+// Logging. Messages are formatted on a background thread: the format has to be a string literal, string arguments are copied
+#define LOG_TRACE(...) __LOG_GATED(__Log::eTrace_Level::trace, __VA_ARGS__)
+#define LOG_DEBUG(...) __LOG_GATED(__Log::eTrace_Level::debug, __VA_ARGS__)
+#define LOG_INFO(...)  __LOG_GATED(__Log::eTrace_Level::info, __VA_ARGS__)
+#define LOG_WARN(...)  __LOG_GATED(__Log::eTrace_Level::warn, __VA_ARGS__)
+#define LOG_ERR(...)   __LOG_GATED(__Log::eTrace_Level::err, __VA_ARGS__)
+#define LOG_CRIT(...)  __Log::__log(__Log::eTrace_Level::crit, __TRACE_MODULE, (unsigned short)__LINE__, __FILE__, __FUNCTION__, __VA_ARGS__)
 // -
 
 #undef __APICALL
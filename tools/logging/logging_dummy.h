@@ -23,6 +23,9 @@ void __log(bool doExit, const wchar_t* i_pFormat, ...);
  *
  */
 constexpr void deinit() {}
+
+constexpr void setLevel(wchar_t const* name, eTrace_Level level) {}
+
 /**
  * @brief Register thread (for better logging)
  *
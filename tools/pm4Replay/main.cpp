@@ -0,0 +1,263 @@
+#include "core/imports/exports/graphics.h"
+#include "core/imports/exports/pm4_custom.h"
+#include "core/imports/exports/pm4_parser.h"
+#include "core/pm4Capture/pm4Capture_types.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#include <windows.h>
+
+namespace {
+constexpr uint64_t ALLOC_GRANULARITY = 64 * 1024;
+
+constexpr std::array<std::pair<uint32_t, char const*>, 33> TYPE3_NAMES = {{
+    {Pm4::OP_NOP, "NOP"},
+    {0x11, "SET_BASE"},
+    {0x12, "CLEAR_STATE"},
+    {0x13, "INDEX_BUFFER_SIZE"},
+    {0x15, "DISPATCH_DIRECT"},
+    {0x16, "DISPATCH_INDIRECT"},
+    {0x20, "SET_PREDICATION"},
+    {0x24, "DRAW_INDIRECT"},
+    {0x25, "DRAW_INDEX_INDIRECT"},
+    {0x26, "INDEX_BASE"},
+    {0x27, "DRAW_INDEX_2"},
+    {0x28, "CONTEXT_CONTROL"},
+    {0x2A, "INDEX_TYPE"},
+    {0x2D, "DRAW_INDEX_AUTO"},
+    {0x2F, "NUM_INSTANCES"},
+    {0x33, "INDIRECT_BUFFER_CONST"},
+    {0x37, "WRITE_DATA"},
+    {0x3C, "WAIT_REG_MEM"},
+    {0x3F, "INDIRECT_BUFFER"},
+    {0x42, "PFP_SYNC_ME"},
+    {0x43, "SURFACE_SYNC"},
+    {0x46, "EVENT_WRITE"},
+    {0x47, "EVENT_WRITE_EOP"},
+    {0x48, "EVENT_WRITE_EOS"},
+    {0x49, "RELEASE_MEM"},
+    {0x50, "DMA_DATA"},
+    {0x58, "ACQUIRE_MEM"},
+    {0x69, "SET_CONTEXT_REG"},
+    {0x76, "SET_SH_REG"},
+    {0x79, "SET_UCONFIG_REG"},
+    {0x80, "LOAD_CONST_RAM"},
+    {0x81, "WRITE_CONST_RAM"},
+    {0x83, "DUMP_CONST_RAM"},
+}};
+
+constexpr std::array<char const*, Pm4::R_NUM_COMMANDS> CUSTOM_NAMES = { // index: Pm4::R_*
+    "",
+    "VS",
+    "PS",
+    "DRAW_INDEX",
+    "DRAW_INDEX_AUTO",
+    "DRAW_RESET",
+    "WAIT_FLIP_DONE",
+    "CS",
+    "DISPATCH_DIRECT",
+    "DISPATCH_RESET",
+    "DISPATCH_WAIT_MEM",
+    "PUSH_MARKER",
+    "POP_MARKER",
+    "VS_EMBEDDED",
+    "PS_EMBEDDED",
+    "VS_UPDATE",
+    "PS_UPDATE",
+    "VGT_CONTROL",
+};
+
+char const* getType3Name(uint32_t opcode) {
+  auto it = std::find_if(TYPE3_NAMES.begin(), TYPE3_NAMES.end(), [opcode](auto const& item) { return item.first == opcode; });
+  return it != TYPE3_NAMES.end() ? it->second : "?";
+}
+
+/**
+ * @brief Counts packets of every submit, the default sink
+ *
+ */
+class StatsGraphics: public IGraphics {
+  public:
+  uint64_t numSubmits   = 0;
+  uint64_t numFlips     = 0;
+  uint64_t numDwords    = 0;
+  uint64_t numTruncated = 0; // buffers ending inside a packet
+
+  std::array<uint64_t, 4>      packetsPerType {};
+  std::map<uint32_t, uint64_t> type3Packets;  // opcode -> count
+  std::map<uint32_t, uint64_t> customPackets; // Pm4::R_* -> count
+
+  void walk(uint32_t const* cmds, uint32_t numBytes) {
+    numDwords += numBytes / sizeof(uint32_t);
+
+    auto const result = Pm4::parse<false>(cmds, numBytes / sizeof(uint32_t), [this](Pm4::Packet const& packet) {
+      ++packetsPerType[(size_t)packet.type];
+      if (packet.type == Pm4::PacketType::Type3) ++type3Packets[packet.op];
+      if (packet.type == Pm4::PacketType::Custom) ++customPackets[packet.op];
+      return true;
+    });
+    if (result == Pm4::ParseResult::Truncated) ++numTruncated;
+  }
+
+  void print() const {
+    printf("submits:%llu flips:%llu dwords:%llu truncated:%llu\n", numSubmits, numFlips, numDwords, numTruncated);
+    printf("packets| type0:%llu type1(custom):%llu type2:%llu type3:%llu\n", packetsPerType[0], packetsPerType[1], packetsPerType[2], packetsPerType[3]);
+
+    auto printSorted = [](std::map<uint32_t, uint64_t> const& packets, auto getName) {
+      std::vector<std::pair<uint32_t, uint64_t>> sorted(packets.begin(), packets.end());
+      std::sort(sorted.begin(), sorted.end(), [](auto const& lhs, auto const& rhs) { return lhs.second > rhs.second; });
+      for (auto const& [id, count]: sorted) {
+        printf("  0x%02x %-24s %12llu\n", id, getName(id), count);
+      }
+    };
+
+    printf("type3:\n");
+    printSorted(type3Packets, getType3Name);
+    printf("custom:\n");
+    printSorted(customPackets, [](uint32_t id) { return id < CUSTOM_NAMES.size() ? CUSTOM_NAMES[id] : "?"; });
+  }
+
+  int addEvent(Kernel::EventQueue::KernelEqueueEvent& event, Kernel::EventQueue::IKernelEqueue_t eq) final { return 0; }
+
+  void removeEvent(Kernel::EventQueue::IKernelEqueue_t eq, int const ident) final {}
+
+  void registerCommandBuffer(void* cmdBufferClass) final {}
+
+  void submitCmdBuffer(uint32_t count, uint32_t const* drawBuffers[], uint32_t const numDrawDw[], uint32_t const* constBuffers[], uint32_t const numConstDw[],
+                       int const handle, int const index, int const flipMode, int64_t const flipArg, bool flip) final {
+    ++numSubmits;
+    if (flip) ++numFlips;
+    for (uint32_t n = 0; n < count; ++n) {
+      walk(drawBuffers[n], numDrawDw[n]);
+      walk(constBuffers[n], numConstDw[n]);
+    }
+  }
+
+  void waitSubmitDone() final {}
+
+  void submited() final {}
+
+  void submitDone() final {}
+
+  bool isRunning() const final { return true; }
+};
+
+/**
+ * @brief Places captured memory at its original address, packets contain absolute addresses.
+ * Falls back to a copy if the address is taken in this process.
+ *
+ */
+class GuestMemory {
+  std::set<uint64_t>                      m_chunks; // committed by us
+  std::vector<std::unique_ptr<uint8_t[]>> m_relocated;
+
+  bool reserve(uint64_t addr, uint64_t size) {
+    for (auto chunk = addr & ~(ALLOC_GRANULARITY - 1); chunk < addr + size; chunk += ALLOC_GRANULARITY) {
+      if (m_chunks.contains(chunk)) continue;
+      if (VirtualAlloc((void*)chunk, ALLOC_GRANULARITY, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE) == nullptr) return false;
+      m_chunks.insert(chunk);
+    }
+    return true;
+  }
+
+  public:
+  uint64_t numRelocated = 0;
+
+  uint8_t* place(uint64_t addr, uint64_t size) {
+    if (size == 0) return nullptr;
+    if (addr != 0 && reserve(addr, size)) return (uint8_t*)addr;
+
+    ++numRelocated;
+    return m_relocated.emplace_back(std::make_unique<uint8_t[]>(size)).get();
+  }
+};
+
+/**
+ * @brief Feeds a capture into sink, submit by submit
+ *
+ * @return false if the file is no capture or truncated
+ */
+bool replay(std::ifstream& file, IGraphics& sink, GuestMemory& memory, double& submitTimeMs) {
+  using namespace pm4Capture;
+
+  FileHeader header;
+  if (!file.read((char*)&header, sizeof(header)) || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+    printf("Not a pm4 capture (version %u)\n", FILE_VERSION);
+    return false;
+  }
+
+  RecordHeader record;
+  while (file.read((char*)&record, sizeof(record))) {
+    switch (record.type) {
+      case RecordType::Memory: {
+        MemoryRecord range;
+        if (!file.read((char*)&range, sizeof(range))) return false;
+        if (!file.read((char*)memory.place(range.addr, range.size), range.size)) return false;
+      } break;
+
+      case RecordType::Submit: {
+        SubmitRecord submit;
+        if (!file.read((char*)&submit, sizeof(submit))) return false;
+
+        std::vector<BufferInfo> infos(submit.count);
+        if (!file.read((char*)infos.data(), infos.size() * sizeof(BufferInfo))) return false;
+
+        std::vector<uint32_t const*> dcbs(submit.count), ccbs(submit.count);
+        std::vector<uint32_t>        dcbSizes(submit.count), ccbSizes(submit.count);
+        for (uint32_t n = 0; n < submit.count; ++n) {
+          auto dcb = memory.place(infos[n].dcbAddr, infos[n].dcbSize);
+          if (!file.read((char*)dcb, infos[n].dcbSize)) return false;
+          auto ccb = memory.place(infos[n].ccbAddr, infos[n].ccbSize);
+          if (!file.read((char*)ccb, infos[n].ccbSize)) return false;
+
+          dcbs[n]     = (uint32_t const*)dcb;
+          ccbs[n]     = (uint32_t const*)ccb;
+          dcbSizes[n] = infos[n].dcbSize;
+          ccbSizes[n] = infos[n].ccbSize;
+        }
+
+        auto const start = std::chrono::high_resolution_clock::now();
+        sink.submitCmdBuffer(submit.count, dcbs.data(), dcbSizes.data(), ccbs.data(), ccbSizes.data(), submit.handle, submit.index, submit.flipMode,
+                             submit.flipArg, submit.flip != 0);
+        submitTimeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+      } break;
+
+      default: file.seekg(record.size, std::ios::cur); break; // newer record type
+    }
+  }
+  return file.eof();
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: pm4Replay <capture file>\n");
+    return -1;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  if (file.fail()) {
+    printf("Couldn't read %s\n", argv[1]);
+    return -1;
+  }
+
+  StatsGraphics sink;
+  GuestMemory   memory;
+  double        submitTimeMs = 0;
+
+  bool const complete = replay(file, sink, memory, submitTimeMs);
+  sink.print();
+  printf("submit time:%.3f ms relocated ranges:%llu\n", submitTimeMs, memory.numRelocated);
+
+  if (!complete) {
+    printf("Capture is truncated\n");
+    return -2;
+  }
+  return 0;
+}